@@ -14,21 +14,46 @@
  * rather the processed data is divided into threads.
  *
  * CLI:
- *   g++ -std=c++2c -O3 -flto filename.cpp -o output && ./output nm log
+ *   g++ -std=c++2c -O3 -flto filename.cpp -o output && ./output nm log [samples=<log2>] [nocache] [pool=<file>] [perf] [notune] [retune]
  *
- * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp
+ *   samples=<log2> : samples per key bit (default 2^18 per usable CPU but one, whatever the autotuner picks)
+ *   nocache        : neither read nor update the result cache
+ *   pool=<file>    : stream forward halves from a sample pool (samplepool.cpp) instead of computing
+ *                    them; every key bit then sees the same pool records
+ *   notune         : skip the autotuner (threads = hardware - 1, scalar kernel, one chunk per thread)
+ *   retune         : calibrate again instead of reading the cached decision
+ *   perf           : count cycles, instructions, branch and cache misses of the workers with
+ *                    perf_event_open and report IPC, clock and misses per sample per key word
+ *
+ *   -DPNB_PHASE_TIMING : instrumentation build; matchcount charges the TSC cycles of each phase
+ *                        (setup, forward, feed-forward, key flip + subtract, backward, parity)
+ *                        per thread, and the end-of-run timer message gets the breakdown
+ *
+ * Autotune: before the search, autotune::tune() measures the scalar and the 8/16-lane backward
+ * kernels (matchsamples<L>) and the usable thread counts for a few hundred ms, and picks the
+ * fastest combination and a chunk size; the threads of a key bit then take chunks from a
+ * shared counter. The decision is cached per machine under cache/ and printed in showInfo,
+ * together with the predicted runtime. All kernels give the same counts for the same samples.
+ *
+ * Result cache: per-bit match/sample counts are kept in cache/pnbsearch_<hash>.ckpt, the hash
+ * covering everything that changes what a sample measures (see search_fingerprint()). A rerun
+ * only computes the samples missing to reach the requested count and merges them in.
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp, samplepool.hpp
  */
 
-#include "header/salsa.hpp" // salsa round functions
+#include "header/samplepool.hpp" // salsa round functions + forward/backward sample kernel + sample pool
 #include <algorithm>
 #include <cctype>
 #include <cmath>               // pow function
 #include <cstring>             // string
 #include <ctime>               // time
+#include <exception>
 #include <filesystem>
 #include <fstream> // storing output in a file
 #include <future>  // multithreading
 #include <iomanip> // decimal numbers upto certain places
+#include <memory>
 #include <thread>  // multithreading
 
 using namespace std;
@@ -36,20 +61,118 @@ using namespace std;
 config::CipherInfo basic_config;
 config::DLInfo diff_config;
 config::SamplesInfo samples_config;
+salsa::IVConditions iv_conditions; // used when diff_config.chosen_iv_flag is set
 pnbinfo::PNBdetails pnb_config;
 
 using BiasEntry = pair<u16, double>;
 
-double matchcount(int key_bit, int key_word);
+double matchcount(u16 worker, int key_bit, int key_word, u64 samples, u64 pool_first);
+double produce(u16 group, u16 producer, u64 samples);
+double consume(u16 worker, u16 group, u16 consumer, int key_bit, int key_word);
+template <size_t L, class Source>
+u64 matchforward(const pnbkernel::RoundPlan &plan, u16 global_idx, Source &&source);
+template <size_t L>
+u64 matchsamples(const pnbkernel::RoundPlan &plan, u16 global_idx, u64 samples, u64 pool_first);
 inline bool skip_this(u16 idx, const vector<u16> &skip_bits);
 
 static atomic<u64> progress{0};
+static atomic<u64> next_chunk{0};  // chunk counter of the key bit being searched
+static SampleCounters sample_counters; // samples done per worker, for the spinner
+
+// largest chunk without the autotuner, so the spinner sees samples while a bit is searched
+constexpr u64 PROGRESS_CHUNK = 1ULL << 14;
+
+// set by the autotuner; chunk 0 = an even share per thread (at most PROGRESS_CHUNK), lanes 1 = scalar backward
+struct SearchTuning
+{
+    u64 chunk = 0;
+    size_t lanes = 1;
+};
+static SearchTuning search_tuning;
+static std::unique_ptr<samplepool::Pool> sample_pool; // set by pool=<file>
+static std::unique_ptr<perfcounters::Counters> perf_counters; // set by perf
+static vector<perfcounters::Stage> perf_stages;           // one per key word
+static std::unique_ptr<energy::Rapl> rapl;                 // package / DRAM energy, when readable
+static std::unique_ptr<energy::Meter> energy_meter;        // polls rapl so counter wraps are never missed
+static vector<energy::Stage> energy_stages;                // one per key word
+static std::unique_ptr<progressstream::Stream> progress_stream; // set by progress=<file or FIFO>
+static pnbinfo::BiasConvergence convergence;                    // set by converge
+
+// new samples of the key bit being searched, cut at its convergence checkpoints
+struct BitSegments
+{
+    vector<u64> ends;                       // ascending offsets past the cached samples; the last is the bit's need
+    vector<size_t> checkpoint;              // convergence checkpoint each segment ends at
+    vector<std::atomic<u64>> matches;       // matches inside each segment
+    vector<std::atomic<u64>> left;          // samples of each segment not finished yet
+    vector<std::atomic<u32>> done_ms;       // when each segment was finished, from `start`
+    std::chrono::steady_clock::time_point start;
+};
+static BitSegments bit_segments; // empty ends: no convergence recording
+
+// pipeline=P:C: producers draw initial states (keys / IVs) into SPSC rings and consumers run
+// the rounds. Each group has P producers, C consumers and one ring per (producer, consumer).
+constexpr size_t PIPELINE_BATCH = 64; // initial states per ring slot
+
+struct alignas(64) StateBatch
+{
+    u64 first = 0; // offset of the first state among the new samples of the bit
+    u32 count = 0;
+    u32 x0[PIPELINE_BATCH][STATEWORD_COUNT];
+};
+
+using StateRing = spsc::Ring<StateBatch, arena::Allocator<StateBatch>>; // slots on huge pages
+
+struct SearchPipeline
+{
+    size_t producers = 0; // per group; 0: off
+    size_t consumers = 0; // per group
+    size_t groups = 0;
+    size_t depth = 0;     // slots per ring
+    vector<std::unique_ptr<StateRing>> rings;        // [group][producer][consumer]
+    std::unique_ptr<std::atomic<size_t>[]> finished;        // producers of each group done with the bit
+    std::atomic<bool> aborted{false};                      // a producer or consumer threw: everyone stops
+
+    bool enabled() const { return producers > 0; }
+
+    StateRing &ring(size_t group, size_t producer, size_t consumer)
+    {
+        return *rings[(group * producers + producer) * consumers + consumer];
+    }
+
+    // after an aborted bit, once every thread is joined: drops the batches nobody consumed
+    void drain()
+    {
+        for (auto &r : rings)
+            while (r->front())
+                r->pop();
+    }
+};
+static SearchPipeline pipeline;
+
+struct SearchOptions
+{
+    bool show_segments = false;
+    string pool_file;
+    string progress_file;
+    int log2_samples = 0; // 0: 2^18 per untuned thread (or the whole pool)
+    bool use_cache = true;
+    bool perf = false;
+    bool tune = true;
+    bool retune = false;
+    bool converge = false;
+    size_t pipe_producers = 0; // pipeline=P:C, 0: off
+    size_t pipe_consumers = 0;
+    size_t ring_depth = 64; // ring=<slots>
+};
 
 struct RunInfo
 {
     u16 key_count = 0;
     u64 total_work = 0;
+    u64 target_samples = 0; // per key bit
     vector<u16> skip_bits;
+    autotune::Decision tuned; // rate 0: not tuned
 };
 
 struct SearchResults
@@ -58,7 +181,7 @@ struct SearchResults
     vector<BiasEntry> nonpnbs;
 };
 
-static void parse_cli(int argc, char *argv[], bool &show_segments)
+static void parse_cli(int argc, char *argv[], SearchOptions &opt)
 {
     if (argc >= 2)
     {
@@ -83,6 +206,17 @@ static void parse_cli(int argc, char *argv[], bool &show_segments)
         for (int i = 2; i < argc; ++i)
         {
             std::string flag = argv[i];
+            if (flag.rfind("pool=", 0) == 0)
+            {
+                opt.pool_file = flag.substr(5);
+                continue;
+            }
+            if (flag.rfind("progress=", 0) == 0)
+            {
+                opt.progress_file = flag.substr(9);
+                continue;
+            }
+
             std::transform(flag.begin(), flag.end(), flag.begin(),
                            [](unsigned char c)
                            { return static_cast<char>(std::tolower(c)); });
@@ -90,16 +224,77 @@ static void parse_cli(int argc, char *argv[], bool &show_segments)
             if (flag == "log" || flag == "1")
                 basic_config.logfile_flag = true;
             else if (flag == "seg" || flag == "segment" || flag == "segments")
-                show_segments = true;
+                opt.show_segments = true;
+            else if (flag == "nocache")
+                opt.use_cache = false;
+            else if (flag == "perf")
+                opt.perf = true;
+            else if (flag == "notune")
+                opt.tune = false;
+            else if (flag == "retune")
+                opt.retune = true;
+            else if (flag == "converge")
+                opt.converge = true;
+            else if (flag.rfind("pipeline=", 0) == 0)
+            {
+                const size_t colon = flag.find(':');
+                try
+                {
+                    opt.pipe_producers = std::stoul(flag.substr(9, colon - 9));
+                    opt.pipe_consumers = (colon == string::npos) ? 0 : std::stoul(flag.substr(colon + 1));
+                }
+                catch (...)
+                {
+                    opt.pipe_producers = 0;
+                }
+                if (opt.pipe_producers == 0 || opt.pipe_consumers == 0)
+                {
+                    std::cerr << "pipeline must be <producers>:<consumers>, both positive. Pipeline off.\n";
+                    opt.pipe_producers = opt.pipe_consumers = 0;
+                }
+            }
+            else if (flag.rfind("ring=", 0) == 0)
+            {
+                try
+                {
+                    opt.ring_depth = std::stoul(flag.substr(5));
+                }
+                catch (...)
+                {
+                    opt.ring_depth = 0;
+                }
+                if (opt.ring_depth < 2 || opt.ring_depth > 4096)
+                {
+                    std::cerr << "ring must be in [2,4096]. Using 64.\n";
+                    opt.ring_depth = 64;
+                }
+            }
+            else if (flag.rfind("samples=", 0) == 0)
+            {
+                try
+                {
+                    opt.log2_samples = std::stoi(flag.substr(8));
+                    if (opt.log2_samples < 8 || opt.log2_samples > 40)
+                    {
+                        std::cerr << "samples must be in [8,40]. Using the default.\n";
+                        opt.log2_samples = 0;
+                    }
+                }
+                catch (...)
+                {
+                    std::cerr << "Invalid samples input. Using the default.\n";
+                    opt.log2_samples = 0;
+                }
+            }
         }
     }
 }
 
-static RunInfo init_config_and_banner(std::stringstream &dmsg)
+static RunInfo init_config_and_banner(const SearchOptions &opt, std::stringstream &dmsg)
 {
     RunInfo info;
 
-    basic_config.cipher_name = "salsa";
+    basic_config.cipher_name = "salsa"; // or "chacha" (header/arx.hpp), e.g. R7, dist 3, id {13, 13}, mask {11, 0}
     basic_config.mode = "PNBsearch"; // input something useful without gap
     basic_config.word_size_bits = 32;
     basic_config.key_size = 256;
@@ -110,9 +305,61 @@ static RunInfo init_config_and_banner(std::stringstream &dmsg)
     diff_config.id = {{7, 31}};
     diff_config.mask = {{4, 7}};
 
-    samples_config.samples_per_thread = 1ULL << 18;
-    samples_config.samples_per_batch =
-        samples_config.samples_per_thread * samples_config.max_num_threads;
+    // chosen IV: conditions on the state after the first half-round (see salsa::IVConditions)
+    // diff_config.chosen_iv_flag = true;
+    // iv_conditions.fix(9, 31, 0);      // x9'[31] = 0
+    // iv_conditions.equal(13, 0, 4, 7); // x13'[0] = x4'[7]
+
+    // one draw, so unsatisfiable conditions stop the run here and not inside a worker
+    if (diff_config.chosen_iv_flag)
+    {
+        u32 x0[STATEWORD_COUNT];
+        pnbkernel::generateInitialState(pnbkernel::makeRoundPlan(basic_config, diff_config, &iv_conditions), x0);
+    }
+
+    // the default budget comes from the untuned thread count (availableCpus() - 1), so the tuned
+    // count only schedules the work and never changes the precision of a bias
+    info.target_samples = opt.log2_samples ? (1ULL << opt.log2_samples)
+                                           : (1ULL << 18) * samples_config.max_num_threads;
+
+    // ---------------- autotune: threads, chunk and backward kernel for this machine -----------------
+    if (opt.tune)
+    {
+        const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config, &iv_conditions);
+        auto kernel = [&plan](auto lanes)
+        {
+            return [&plan](u64 n)
+            { return matchsamples<decltype(lanes)::value>(plan, 0, n, 0); };
+        };
+        const vector<autotune::Kernel> kernels = {{"scalar", kernel(std::integral_constant<size_t, 1>{})},
+                                                  {"lanes8", kernel(std::integral_constant<size_t, 8>{})},
+                                                  {"lanes16", kernel(std::integral_constant<size_t, 16>{})}};
+        std::ostringstream workload;
+        workload << "pnbsearch kernel" << pnbkernel::KERNEL_VERSION << " " << basic_config.cipher_name << "-"
+                 << basic_config.key_size << " R" << basic_config.total_rounds << " D" << diff_config.distinguishing_round
+                 << (diff_config.chosen_iv_flag ? " chosen-iv" : "");
+
+        // the pool is opened below, so the calibration always generates its samples
+        info.tuned = autotune::tune(workload.str(), kernels, "cache", !opt.retune);
+        info.tuned.apply(samples_config);
+        search_tuning.chunk = info.tuned.chunk;
+        search_tuning.lanes = (info.tuned.kernel_name == "lanes16") ? 16 : (info.tuned.kernel_name == "lanes8") ? 8 : 1;
+    }
+
+
+    // a pool bounds the samples: key bits read its records from the start
+    if (!opt.pool_file.empty())
+    {
+        sample_pool = std::make_unique<samplepool::Pool>(opt.pool_file);
+        const string diff = samplepool::mismatch(sample_pool->header(), pnbkernel::makeRoundPlan(basic_config, diff_config, &iv_conditions));
+        if (!diff.empty())
+            throw std::runtime_error("sample pool " + opt.pool_file + " was generated for another " + diff);
+        info.target_samples = opt.log2_samples ? std::min<u64>(info.target_samples, sample_pool->size()) : sample_pool->size();
+    }
+
+    samples_config.samples_per_thread =
+        (info.target_samples + samples_config.max_num_threads - 1) / samples_config.max_num_threads;
+    samples_config.samples_per_batch = info.target_samples;
 
     info.key_count =
         (basic_config.key_size == 128) ? KEYWORD_COUNT - 4 : KEYWORD_COUNT;
@@ -123,6 +370,10 @@ static RunInfo init_config_and_banner(std::stringstream &dmsg)
     // samples_config.num_batches = static_cast<std::size_t>(key_count) * WORD_SIZE;
 
     display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    if (diff_config.chosen_iv_flag)
+        display::printField(dmsg, "IV conditions", iv_conditions.fingerprint());
+    if (sample_pool)
+        display::printField(dmsg, "Sample pool", sample_pool->path() + " (" + display::formatCountPow2Pow10(sample_pool->size()) + " records)");
     pnbinfo::showPNBConfig(pnb_config, dmsg);
 
     info.skip_bits = {
@@ -134,7 +385,166 @@ static RunInfo init_config_and_banner(std::stringstream &dmsg)
     return info;
 }
 
-static SearchResults run_search(const RunInfo &info)
+// everything that changes what a sample measures; cached counts are only merged on a match
+static string search_fingerprint(const RunInfo &info)
+{
+    std::ostringstream fp;
+    fp << "kernel" << pnbkernel::KERNEL_VERSION << " "
+       << basic_config.cipher_name << "-" << basic_config.key_size
+       << " R" << basic_config.total_rounds << " D" << diff_config.distinguishing_round
+       << " " << basic_config.comment << " id";
+    for (const auto &[w, b] : diff_config.id)
+        fp << ":" << w << "," << b;
+    fp << " mask";
+    for (const auto &[w, b] : diff_config.mask)
+        fp << ":" << w << "," << b;
+    fp << " skip";
+    for (u16 b : info.skip_bits)
+        fp << ":" << b;
+    if (diff_config.chosen_iv_flag)
+        fp << " iv:" << iv_conditions.fingerprint();
+    // pooled counts cover a prefix of the pool, so the pool itself is part of the key
+    if (sample_pool)
+        fp << " pool:" << std::hex
+           << checkpoint::fnv1a64(string(reinterpret_cast<const char *>(&sample_pool->header()), sizeof(samplepool::Header)));
+    return fp.str();
+}
+
+static string cache_path(const string &fingerprint, const string &folder)
+{
+    std::ostringstream name;
+    name << folder << "/pnbsearch_" << std::hex << checkpoint::fnv1a64(fingerprint) << ".ckpt";
+    return name.str();
+}
+
+// counts of an earlier run with the same fingerprint, or an empty record
+static checkpoint::Record open_cache(const RunInfo &info, const string &cache_file, std::ostream &dmsg)
+{
+    checkpoint::Record cache;
+    const string fingerprint = search_fingerprint(info);
+
+    if (checkpoint::load(cache_file, cache) && cache.fingerprint == fingerprint)
+    {
+        u64 cached = ~0ULL;
+        for (u16 b{0}; b < info.key_count * WORD_SIZE; ++b)
+            if (!skip_this(b, info.skip_bits))
+                cached = std::min(cached, cache.get("n" + std::to_string(b)));
+        display::printField(dmsg, "Result cache", cache_file);
+        display::printField(dmsg, "Cached samples per bit (min)", display::formatCountPow2Pow10(cached));
+        dmsg << basic_config.star_sep;
+    }
+    else
+        cache.values.clear();
+
+    cache.fingerprint = fingerprint;
+    return cache;
+}
+
+// samples still to compute over all key bits
+static u64 missing_samples(const RunInfo &info, const checkpoint::Record &cache)
+{
+    u64 missing = 0;
+    for (u16 b{0}; b < info.key_count * WORD_SIZE; ++b)
+        if (!skip_this(b, info.skip_bits))
+            missing += info.target_samples - std::min(info.target_samples, cache.get("n" + std::to_string(b)));
+    return missing;
+}
+
+// samples a worker (or producer) takes from next_chunk at a time
+static u64 work_chunk(u64 samples)
+{
+    return search_tuning.chunk
+               ? search_tuning.chunk
+               : std::min(PROGRESS_CHUNK, (samples + samples_config.max_num_threads - 1) / samples_config.max_num_threads);
+}
+
+// end of the convergence segment holding new sample `pos`
+static u64 segment_end(u64 pos)
+{
+    return *std::upper_bound(bit_segments.ends.begin(), bit_segments.ends.end(), pos);
+}
+
+// adds `matches` among new samples [pos, pos + n) to their segment; the range lies in one segment
+static void count_segment(u64 pos, u64 n, u64 matches)
+{
+    BitSegments &seg = bit_segments;
+    const size_t i = std::upper_bound(seg.ends.begin(), seg.ends.end(), pos) - seg.ends.begin();
+    seg.matches[i].fetch_add(matches, std::memory_order_relaxed);
+    if (seg.left[i].fetch_sub(n, std::memory_order_acq_rel) == n)
+        seg.done_ms[i].store(static_cast<u32>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                  std::chrono::steady_clock::now() - seg.start)
+                                                  .count()),
+                             std::memory_order_relaxed);
+}
+
+// one ring per (producer, consumer) of every group; groups fill the worker threads
+static void open_pipeline(const SearchOptions &opt, std::ostream &dmsg)
+{
+    if (sample_pool)
+    {
+        display::printField(dmsg, "Pipeline", string("off (the pool supplies the forward halves)"));
+        return;
+    }
+
+    pipeline.producers = opt.pipe_producers;
+    pipeline.consumers = opt.pipe_consumers;
+    pipeline.groups = std::max<size_t>(1, samples_config.max_num_threads / (pipeline.producers + pipeline.consumers));
+    pipeline.rings.clear();
+    for (size_t r{0}; r < pipeline.groups * pipeline.producers * pipeline.consumers; ++r)
+        pipeline.rings.push_back(std::make_unique<StateRing>(opt.ring_depth));
+    pipeline.depth = pipeline.rings.front()->depth();
+    pipeline.finished = std::make_unique<std::atomic<size_t>[]>(pipeline.groups);
+
+    std::ostringstream info;
+    info << pipeline.producers << ":" << pipeline.consumers << " x " << pipeline.groups << " groups = "
+         << pipeline.groups * pipeline.producers << " producers + " << pipeline.groups * pipeline.consumers
+         << " consumers, " << pipeline.rings.size() << " rings of " << pipeline.depth << " x " << PIPELINE_BATCH
+         << " states (" << pipeline.depth * sizeof(StateBatch) / 1024 << " KiB each)";
+    display::printField(dmsg, "Pipeline", info.str());
+}
+
+// cuts the new samples [0, need) of a bit with `cached` samples at the checkpoints above `cached`
+static void prepare_segments(u64 cached, u64 need)
+{
+    BitSegments &seg = bit_segments;
+    seg.ends.clear();
+    seg.checkpoint.clear();
+    for (size_t k{0}; k < convergence.checkpoints.size(); ++k)
+        if (convergence.checkpoints[k] > cached && convergence.checkpoints[k] - cached <= need)
+        {
+            seg.ends.push_back(convergence.checkpoints[k] - cached);
+            seg.checkpoint.push_back(k);
+        }
+
+    seg.matches = vector<std::atomic<u64>>(seg.ends.size());
+    seg.left = vector<std::atomic<u64>>(seg.ends.size());
+    seg.done_ms = vector<std::atomic<u32>>(seg.ends.size());
+    for (size_t i{0}; i < seg.ends.size(); ++i)
+        seg.left[i].store(seg.ends[i] - (i ? seg.ends[i - 1] : 0), std::memory_order_relaxed);
+    seg.start = std::chrono::steady_clock::now();
+}
+
+// cumulative matches at every checkpoint the bit reached in this run (or exactly from the cache)
+static void record_convergence(u16 global_idx, u64 cached_samples, u64 cached_matches)
+{
+    for (size_t k{0}; k < convergence.checkpoints.size(); ++k)
+        if (convergence.checkpoints[k] == cached_samples)
+            convergence.matches[convergence.at(global_idx, k)] = cached_matches;
+
+    u64 cumulative = cached_matches;
+    u32 reached_ms = 0;
+    for (size_t i{0}; i < bit_segments.ends.size(); ++i)
+    {
+        cumulative += bit_segments.matches[i].load(std::memory_order_relaxed);
+        reached_ms = std::max(reached_ms, bit_segments.done_ms[i].load(std::memory_order_relaxed));
+        const size_t at = convergence.at(global_idx, bit_segments.checkpoint[i]);
+        convergence.matches[at] = cumulative;
+        convergence.ms[at] = reached_ms;
+    }
+    bit_segments.ends.clear();
+}
+
+static SearchResults run_search(const RunInfo &info, const string &cache_file, checkpoint::Record &cache)
 {
     SearchResults results;
     results.pnbs.reserve(256);
@@ -152,9 +562,11 @@ static SearchResults run_search(const RunInfo &info)
     future_results.reserve(samples_config.max_num_threads);
 
     progress.store(0, std::memory_order_relaxed);
+    sample_counters.resize(pipeline.enabled() ? pipeline.groups * pipeline.consumers : samples_config.max_num_threads);
 
     #ifdef SPINNER_WITH_ETA_AVAILABLE
     SpinnerWithETA spinner("Searching PNBs ...", &progress, info.total_work);
+    spinner.trackSamples(&sample_counters, missing_samples(info, cache), "bits");
     // cout << "\n";
     spinner.start();
     #endif
@@ -162,6 +574,10 @@ static SearchResults run_search(const RunInfo &info)
     // ---------------- key-word / key-bit loop -----------------
     for (size_t key_word{0}; key_word < info.key_count; ++key_word)
     {
+        perfcounters::Stage stage{"key word " + std::to_string(key_word), 0, {}};
+        const perfcounters::Reading stage_start = perf_counters ? perf_counters->read() : perfcounters::Reading{};
+        const energy::Joules energy_start = energy_meter->total();
+
         for (size_t key_bit{0}; key_bit < WORD_SIZE; key_bit++)
         {
             u16 global_idx = static_cast<u16>(key_word * WORD_SIZE + key_bit);
@@ -169,34 +585,127 @@ static SearchResults run_search(const RunInfo &info)
             if (skip_this(global_idx, info.skip_bits))
                 continue; // completely ignored and nothing is printed
 
-            sum = 0.0;
-            future_results.clear();
-
-            // ---------------- launch threads for this (key_word, key_bit) -----------------
-            for (u16 thread_number{0}; thread_number < samples_config.max_num_threads; ++thread_number)
-                future_results.emplace_back(async(launch::async, matchcount, static_cast<int>(key_bit), static_cast<int>(key_word)));
+            // ---------------- cached counts of this bit -----------------
+            const string m_key = "m" + std::to_string(global_idx);
+            const string n_key = "n" + std::to_string(global_idx);
+            u64 matches = cache.get(m_key);
+            u64 samples = cache.get(n_key);
+            const u64 cached_samples = samples;
+            const auto bit_start = std::chrono::steady_clock::now();
 
-            try
+            // ---------------- top up to the target, new samples only -----------------
+            if (samples < info.target_samples)
             {
-                for (auto &f : future_results)
-                    sum += f.get();
-            }
-            catch (const exception &e)
-            {
-                cerr << "Thread error: " << e.what() << "\n";
+                const u64 need = info.target_samples - samples;
+                const u64 threads = samples_config.max_num_threads;
+
+                sum = 0.0;
+                future_results.clear();
+
+                // ---------------- launch threads for this (key_word, key_bit) -----------------
+                // pooled: records [samples, target) are still unused by this bit
+                next_chunk.store(0, std::memory_order_relaxed);
+                if (convergence.enabled())
+                    prepare_segments(samples, need);
+                if (pipeline.enabled())
+                {
+                    // producers return 0, consumers their matches
+                    pipeline.aborted.store(false, std::memory_order_relaxed);
+                    for (u16 g{0}; g < pipeline.groups; ++g)
+                    {
+                        pipeline.finished[g].store(0, std::memory_order_relaxed);
+                        for (u16 p{0}; p < pipeline.producers; ++p)
+                            future_results.emplace_back(async(launch::async, produce, g, p, need));
+                        for (u16 c{0}; c < pipeline.consumers; ++c)
+                            future_results.emplace_back(async(launch::async, consume, static_cast<u16>(g * pipeline.consumers + c),
+                                                              g, c, static_cast<int>(key_bit), static_cast<int>(key_word)));
+                    }
+                }
+                else
+                    for (u16 thread_number{0}; thread_number < threads; ++thread_number)
+                        future_results.emplace_back(async(launch::async, matchcount, thread_number, static_cast<int>(key_bit),
+                                                          static_cast<int>(key_word), need, samples));
+
+                try
+                {
+                    // join every thread before rethrowing: a pending future would block the next launch
+                    std::exception_ptr failure;
+                    for (auto &f : future_results)
+                        try
+                        {
+                            sum += f.get();
+                        }
+                        catch (...)
+                        {
+                            if (!failure)
+                                failure = std::current_exception();
+                        }
+                    if (failure)
+                    {
+                        if (pipeline.enabled())
+                            pipeline.drain();
+                        std::rethrow_exception(failure);
+                    }
+
+                    if (convergence.enabled())
+                        record_convergence(global_idx, samples, matches);
+                    matches += static_cast<u64>(sum);
+                    samples += need;
+                    stage.samples += need;
+                    if (!cache_file.empty())
+                    {
+                        cache.set(m_key, matches);
+                        cache.set(n_key, samples);
+                        if (!checkpoint::save(cache_file, cache))
+                            std::cerr << "ERROR: Could not write result cache: " << cache_file << "\n";
+                    }
+                }
+                catch (const exception &e)
+                {
+                    cerr << "Thread error: " << e.what() << "\n";
+                }
             }
+            else if (convergence.enabled())
+                record_convergence(global_idx, samples, matches);
 
-            // samples_per_batch = samples_per_thread * max_num_threads
-            bias = (2.0 * sum / static_cast<double>(samples_config.samples_per_batch)) - 1.0;
+            bias = stats::biasFromCount(matches, samples);
 
-            if (std::fabs(bias) >= pnb_config.neutrality_measure && std::fabs(bias) > 0.0)
+            const bool pnb = std::fabs(bias) >= pnb_config.neutrality_measure && std::fabs(bias) > 0.0;
+            if (pnb)
                 temp_pnb.push_back({global_idx, bias});
             else
                 temp_non_pnb.push_back({global_idx, bias});
 
-            progress.fetch_add(1, std::memory_order_relaxed);
+            const u64 bits_done = progress.fetch_add(1, std::memory_order_relaxed) + 1;
+
+            if (progress_stream)
+            {
+                const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - bit_start).count();
+                const u64 computed = samples - cached_samples;
+                progress_stream->emit(progressstream::Object()
+                                          .add("event", "bit")
+                                          .add("bit", global_idx)
+                                          .add("word", key_word)
+                                          .add("bias", bias)
+                                          .add("pnb", pnb)
+                                          .add("matches", matches)
+                                          .add("samples", samples)
+                                          .add("computed", computed)
+                                          .add("seconds", seconds)
+                                          .add("samples_per_s", computed ? static_cast<double>(computed) / seconds : 0.0)
+                                          .add("bits_done", bits_done)
+                                          .add("bits_total", info.total_work));
+            }
         }
 
+        if (perf_counters)
+        {
+            stage.delta = perf_counters->read() - stage_start;
+            perf_stages.push_back(stage);
+        }
+        if (rapl->available())
+            energy_stages.push_back({stage.name, stage.samples, energy_meter->total() - energy_start});
+
         for (auto &l : temp_pnb)
             results.pnbs.push_back(l);
 
@@ -322,10 +831,12 @@ static void write_log_if_enabled(const vector<BiasEntry> &all_pnbs,
 // ---------------- main function -----------------
 int main(int argc, char *argv[])
 {
-    bool show_segments = false;
-    parse_cli(argc, argv, show_segments);
+    SearchOptions opt;
+    parse_cli(argc, argv, opt);
 
     Timer timer;
+    rapl = std::make_unique<energy::Rapl>();
+    energy_meter = std::make_unique<energy::Meter>(*rapl);
 
     stringstream dmsg; //  log buffer
     string folder = "otheraum";
@@ -333,17 +844,176 @@ int main(int argc, char *argv[])
     dmsg << timer.start_message();
 
     // ---------------- config -----------------
-    RunInfo info = init_config_and_banner(dmsg);
+    RunInfo info;
+    try
+    {
+        info = init_config_and_banner(opt, dmsg);
+    }
+    catch (const exception &e)
+    {
+        cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    // ---------------- result cache (empty path: disabled) -----------------
+    const string cache_file = opt.use_cache ? cache_path(search_fingerprint(info), "cache") : string();
+    checkpoint::Record cache;
+    if (!cache_file.empty())
+        cache = open_cache(info, cache_file, dmsg);
+
+    // ---------------- perf counters, inherited by the workers started from here on -----------------
+    if (opt.perf)
+    {
+        perf_counters = std::make_unique<perfcounters::Counters>();
+        const string missing = perf_counters->unavailable();
+        display::printField(dmsg, "Perf counters", missing.empty() ? string("all events") : "unavailable: " + missing);
+        dmsg << basic_config.star_sep;
+    }
+
+    // ---------------- energy counters, read around every key word and for the whole run -----------------
+    {
+        string domains;
+        for (const energy::Domain &d : rapl->domains())
+            domains += (domains.empty() ? "" : ", ") + d.name;
+        display::printField(dmsg, "Energy counters", rapl->available() ? "RAPL " + domains : "unavailable: " + rapl->status());
+        dmsg << basic_config.star_sep;
+    }
+
+    // ---------------- producer / consumer pipeline (pipeline=P:C) -----------------
+    if (opt.pipe_producers)
+    {
+        open_pipeline(opt, dmsg);
+        dmsg << basic_config.star_sep;
+    }
+
+    // ---------------- bias convergence checkpoints (converge) -----------------
+    if (opt.converge)
+    {
+        convergence.init(info.target_samples, static_cast<size_t>(info.key_count) * WORD_SIZE);
+        std::ostringstream cps;
+        cps << display::formatCountPow2Pow10(convergence.checkpoints.front()) << " .. "
+            << display::formatCountPow2Pow10(convergence.checkpoints.back()) << " (" << convergence.checkpoints.size()
+            << " checkpoints)";
+        display::printField(dmsg, "Convergence checkpoints", cps.str());
+        dmsg << basic_config.star_sep;
+    }
+
+    // ---------------- JSON-lines progress stream (progress=<file or FIFO>) -----------------
+    if (!opt.progress_file.empty())
+    {
+        progress_stream = std::make_unique<progressstream::Stream>(opt.progress_file);
+        display::printField(dmsg, "Progress stream", progress_stream->enabled() ? progress_stream->status()
+                                                                                : "unavailable: " + progress_stream->status());
+        dmsg << basic_config.star_sep;
+        progress_stream->emit(progressstream::Object()
+                                  .add("event", "start")
+                                  .add("cipher", basic_config.cipher_name)
+                                  .add("key_size", basic_config.key_size)
+                                  .add("rounds", basic_config.total_rounds)
+                                  .add("neutrality", pnb_config.neutrality_measure)
+                                  .add("threads", samples_config.max_num_threads)
+                                  .add("samples_per_bit", info.target_samples)
+                                  .add("samples_to_compute", missing_samples(info, cache))
+                                  .add("bits_total", info.total_work));
+    }
+
+    // ---------------- predicted runtime of the samples still missing -----------------
+    if (info.tuned.rate > 0.0)
+    {
+        const u64 missing = missing_samples(info, cache);
+        display::printField(dmsg, "Samples to compute", display::formatCountPow2Pow10(missing));
+        display::printField(dmsg, "Predicted runtime",
+                            display::formatMSduration(static_cast<u32>(1000.0 * info.tuned.predictSeconds(missing))) +
+                                (sample_pool ? " (generated samples; a pool is usually faster)" : ""));
+        dmsg << basic_config.star_sep;
+    }
 
     cout << dmsg.str() << std::flush;
     // ---------------- config end -----------------
 
-    SearchResults results = run_search(info);
+    SearchResults results = run_search(info, cache_file, cache);
 
     std::vector<u16> pnbs_sorted_by_index = build_sorted_indices(results.pnbs);
     std::vector<u16> nonpnbs_sorted_by_index = build_sorted_indices(results.nonpnbs);
 
-    print_console_summary(pnbs_sorted_by_index, nonpnbs_sorted_by_index, show_segments);
+    print_console_summary(pnbs_sorted_by_index, nonpnbs_sorted_by_index, opt.show_segments);
+
+    if (perf_counters)
+    {
+        const string perf_report = perfcounters::report(perf_stages);
+        cout << perf_report << basic_config.col_sep;
+        dmsg << perf_report;
+    }
+
+    const string arena_report = arena::global().report();
+    if (!arena_report.empty())
+    {
+        cout << arena_report << basic_config.col_sep;
+        dmsg << arena_report;
+    }
+
+    // ---------------- bias convergence: summary on the console, one table per key bit in the log -----------------
+    if (convergence.enabled())
+    {
+        vector<u16> bits;
+        for (u16 b{0}; b < info.key_count * WORD_SIZE; ++b)
+            if (!skip_this(b, info.skip_bits))
+                bits.push_back(b);
+
+        stringstream summary;
+        pnbinfo::print_bias_convergence_summary(convergence, bits, pnb_config.neutrality_measure, summary);
+        cout << summary.str() << basic_config.col_sep;
+        dmsg << summary.str();
+        pnbinfo::print_bias_convergence(convergence, bits, pnb_config.neutrality_measure, &basic_config, dmsg);
+    }
+
+    // ---------------- energy: per key word, the search (sum of the key words) and the whole run -----------------
+    {
+        stringstream energy_report;
+        energy_report << energy::report(energy_stages, *rapl);
+        if (rapl->available())
+        {
+            energy::Joules search;
+            u64 computed = 0;
+            for (const energy::Stage &s : energy_stages)
+            {
+                search += s.joules;
+                computed += s.samples;
+            }
+            // the meter started with main(), so the run includes setup, calibration and cache I/O
+            const energy::Joules run = energy_meter->total();
+
+            auto joules = [](const energy::Joules &e)
+            {
+                std::ostringstream j;
+                j << std::fixed << std::setprecision(1) << e.package + e.dram << " J (package " << e.package
+                  << ", DRAM " << e.dram << ") in " << std::setprecision(2) << e.seconds << " s";
+                return j.str();
+            };
+            const double total = search.package + search.dram;
+            std::ostringstream spj;
+            if (total > 0)
+                spj << std::scientific << std::setprecision(3) << computed / total;
+            else
+                spj << "- (no energy counted)";
+            display::printField(energy_report, "Energy of the search", joules(search));
+            display::printField(energy_report, "Energy per run", joules(run));
+            display::printField(energy_report, "Samples per joule", spj.str() + " (search)");
+        }
+        cout << energy_report.str() << basic_config.col_sep;
+        dmsg << energy_report.str();
+    }
+
+    if (progress_stream)
+        progress_stream->emit(progressstream::Object()
+                                  .add("event", "end")
+                                  .add("pnbs", pnbs_sorted_by_index.size())
+                                  .add("seconds", static_cast<double>(timer.elapsed_ms()) / 1000.0));
+    if (progress_stream && progress_stream->dropped() > 0)
+    {
+        display::printField(cout, "Progress lines dropped", std::to_string(progress_stream->dropped()) + " (FIFO full)");
+        display::printField(dmsg, "Progress lines dropped", std::to_string(progress_stream->dropped()) + " (FIFO full)");
+    }
 
     write_log_if_enabled(results.pnbs,
                          results.nonpnbs,
@@ -358,196 +1028,274 @@ int main(int argc, char *argv[])
 }
 
 // ---------------- worker: match count for one (key_word, key_bit) -----------------
-double matchcount(int key_bit, int key_word)
+// samples: forward halves of this bit; pool_first: its first pool record (ignored without a
+// pool). The threads of one bit take chunks of work_chunk() samples from next_chunk;
+// `worker` is the thread's slot in sample_counters.
+double matchcount(u16 worker, int key_bit, int key_word, u64 samples, u64 pool_first)
 {
-    salsa::InitKey init_key;
-    u64 thread_match_count{0};
-
-    u32 x0[STATEWORD_COUNT], strdx0[STATEWORD_COUNT], key[KEYWORD_COUNT],
-        dx0[STATEWORD_COUNT], dstrdx0[STATEWORD_COUNT],
-        DiffState[STATEWORD_COUNT], sumstate[STATEWORD_COUNT],
-        minusstate[STATEWORD_COUNT], dsumstate[STATEWORD_COUNT],
-        dminusstate[STATEWORD_COUNT];
-
-    u8 fwd_parity, bwd_parity;
-
-    const int rounded_total_rounds = basic_config.roundedTotalRounds();
-    const int rounded_fwd_rounds = diff_config.roundedFwdRounds();
-    const bool rounded_total_rounds_are_odd = (rounded_total_rounds % 2 != 0);
-    const bool rounded_fwd_rounds_are_odd = (rounded_fwd_rounds % 2 != 0);
-    const bool fwd_rounds_are_fractional = diff_config.fwdRoundsAreFractional();
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config, &iv_conditions);
+    const u16 global_idx = static_cast<u16>(key_word * WORD_SIZE + key_bit);
+    const u64 chunk = work_chunk(samples);
 
-    int fwd_post_round =
-        fwd_rounds_are_fractional ? rounded_fwd_rounds + 2 : rounded_fwd_rounds + 1;
-    int bwd_round =
-        fwd_rounds_are_fractional ? rounded_fwd_rounds + 1 : rounded_fwd_rounds;
-
-    size_t spt = samples_config.samples_per_thread;
+    auto run = [&](u64 first, u64 n) -> u64
+    {
+        switch (search_tuning.lanes)
+        {
+        case 16:
+            return matchsamples<16>(plan, global_idx, n, pool_first + first);
+        case 8:
+            return matchsamples<8>(plan, global_idx, n, pool_first + first);
+        default:
+            return matchsamples<1>(plan, global_idx, n, pool_first + first);
+        }
+    };
 
-    for (size_t loop{0}; loop < spt; ++loop)
+    u64 thread_match_count{0};
+    for (;;)
     {
-        fwd_parity = 0;
-        bwd_parity = 0;
+        const u64 first = next_chunk.fetch_add(1, std::memory_order_relaxed) * chunk;
+        if (first >= samples)
+            break;
+        const u64 n = std::min(chunk, samples - first);
 
-        // ---------------- salsa setup -----------------
-        salsa::init_iv_const(x0);
-        if (basic_config.key_size == 128)
-            init_key.key_128bit(key);
+        if (bit_segments.ends.empty())
+            thread_match_count += run(first, n);
         else
-            init_key.key_256bit(key);
-
-        salsa::insert_key(x0, key);
+        {
+            // converge: split the chunk at the checkpoints so every segment gets its own count
+            for (u64 pos = first; pos < first + n;)
+            {
+                const u64 stop = std::min(first + n, segment_end(pos));
+                const u64 m = run(pos, stop - pos);
+                thread_match_count += m;
+                count_segment(pos, stop - pos, m);
+                pos = stop;
+            }
+        }
+        sample_counters.add(worker, n);
+    }
+    PNB_PHASE_FLUSH();
 
-        ops::copyState(strdx0, x0);
-        ops::copyState(dx0, x0);
+    return static_cast<double>(thread_match_count);
+}
 
-        // ---------------- inject diff -----------------
-        for (const auto &d : diff_config.id)
-            TOGGLE_BIT(dx0[d.first], d.second);
-        ops::copyState(dstrdx0, dx0);
+// ---------------- pipeline producer: random initial states into the rings of its group -----------------
+// Takes chunks from next_chunk like matchcount() and hands them out in batches, trying the
+// group's consumers in turn so a slow consumer does not hold the producer up. A batch never
+// crosses a convergence checkpoint. Stops early once pipeline.aborted is set; if it throws
+// itself, it sets the flag first so its consumers do not wait for it forever.
+double produce(u16 group, u16 producer, u64 samples)
+{
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config, &iv_conditions);
+    const u64 chunk = work_chunk(samples);
+    size_t next = 0; // consumer to try first
 
-        // ---------------- forward round -----------------
-        for (int i{1}; i <= rounded_fwd_rounds; ++i)
-        {
-            frward.RoundFunction(x0, i);
-            frward.RoundFunction(dx0, i);
-        }
-        if (fwd_rounds_are_fractional)
+    try
+    {
+        while (!pipeline.aborted.load(std::memory_order_relaxed))
         {
-            if (rounded_fwd_rounds_are_odd)
-            {
-                frward.Half_1_EvenRF(x0);
-                frward.Half_1_EvenRF(dx0);
-            }
-            else
+            const u64 first = next_chunk.fetch_add(1, std::memory_order_relaxed) * chunk;
+            if (first >= samples)
+                break;
+            const u64 end = std::min(first + chunk, samples);
+
+            for (u64 pos = first; pos < end;)
             {
-                frward.Half_1_OddRF(x0);
-                frward.Half_1_OddRF(dx0);
+                u64 stop = std::min(end, pos + PIPELINE_BATCH);
+                if (!bit_segments.ends.empty())
+                    stop = std::min(stop, segment_end(pos));
+
+                StateBatch *batch = nullptr;
+                size_t c = next;
+                for (size_t tries{0}; !batch; ++tries)
+                {
+                    c = (next + tries) % pipeline.consumers;
+                    batch = pipeline.ring(group, producer, c).claim();
+                    if (!batch && tries % pipeline.consumers == pipeline.consumers - 1)
+                    {
+                        // every ring of the group is full; a consumer that threw never drains its ring
+                        if (pipeline.aborted.load(std::memory_order_relaxed))
+                            return 0.0;
+                        std::this_thread::yield();
+                    }
+                }
+
+                batch->first = pos;
+                batch->count = static_cast<u32>(stop - pos);
+                for (u32 i{0}; i < batch->count; ++i)
+                    pnbkernel::generateInitialState(plan, batch->x0[i]);
+                pipeline.ring(group, producer, c).publish();
+
+                next = (c + 1) % pipeline.consumers;
+                pos = stop;
             }
         }
+    }
+    catch (...)
+    {
+        pipeline.aborted.store(true, std::memory_order_relaxed);
+        throw;
+    }
 
-        // ---------------- XOR state -----------------
-        ops::xorState(x0, dx0, DiffState);
+    pipeline.finished[group].fetch_add(1, std::memory_order_release);
+    return 0.0;
+}
 
-        // ---------------- store forward parity -----------------
-        for (const auto &d : diff_config.mask)
-            fwd_parity ^= GET_BIT(DiffState[d.first], d.second);
+// ---------------- pipeline consumer: forward + backward rounds of the batches of its group -----------------
+// Returns once every producer of the group is finished and its rings are empty, or once
+// pipeline.aborted is set. If it throws, it sets the flag first so the producers stop
+// waiting for its rings to drain.
+double consume(u16 worker, u16 group, u16 consumer, int key_bit, int key_word)
+{
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config, &iv_conditions);
+    const u16 global_idx = static_cast<u16>(key_word * WORD_SIZE + key_bit);
 
-        // ---------------- forward round -----------------
-        if (fwd_rounds_are_fractional)
+    auto run = [&](const StateBatch &batch) -> u64
+    {
+        auto source = [&](auto &&backward)
         {
-            if (rounded_fwd_rounds_are_odd)
+            pnbkernel::ForwardSample sample;
+            for (u32 i{0}; i < batch.count; ++i)
             {
-                frward.Half_2_EvenRF(x0);
-                frward.Half_2_EvenRF(dx0);
+                PNB_PHASE_START(); // the initial state was drawn by a producer
+                pnbkernel::forwardFromState(plan, batch.x0[i], sample);
+                backward(sample);
             }
-            else
-            {
-                frward.Half_2_OddRF(x0);
-                frward.Half_2_OddRF(dx0);
-            }
-        }
-
-        for (int i{fwd_post_round}; i <= rounded_total_rounds; ++i)
+        };
+        switch (search_tuning.lanes)
         {
-            frward.RoundFunction(x0, i);
-            frward.RoundFunction(dx0, i);
+        case 16:
+            return matchforward<16>(plan, global_idx, source);
+        case 8:
+            return matchforward<8>(plan, global_idx, source);
+        default:
+            return matchforward<1>(plan, global_idx, source);
         }
+    };
 
-        if (basic_config.totalRoundsAreFractional())
+    u64 thread_match_count{0};
+    size_t next = 0; // producer to look at first
+    try
+    {
+        while (!pipeline.aborted.load(std::memory_order_relaxed))
         {
-            if (rounded_total_rounds_are_odd)
+            // read before looking at the rings: everything published before it is visible then
+            const bool producers_done =
+                pipeline.finished[group].load(std::memory_order_acquire) == pipeline.producers;
+
+            const StateBatch *batch = nullptr;
+            size_t p = next;
+            for (size_t i{0}; i < pipeline.producers && !batch; ++i)
             {
-                frward.Half_1_EvenRF(x0);
-                frward.Half_1_EvenRF(dx0);
+                p = (next + i) % pipeline.producers;
+                batch = pipeline.ring(group, p, consumer).front();
             }
-            else
+            if (!batch)
             {
-                frward.Half_1_OddRF(x0);
-                frward.Half_1_OddRF(dx0);
+                if (producers_done)
+                    break;
+                std::this_thread::yield();
+                continue;
             }
-        }
 
-        qr.EVENARX_13(x0);
-        qr.EVENARX_13(dx0);
+            const u64 m = run(*batch);
+            thread_match_count += m;
+            if (!bit_segments.ends.empty())
+                count_segment(batch->first, batch->count, m);
+            sample_counters.add(worker, batch->count);
+            pipeline.ring(group, p, consumer).pop();
+            next = (p + 1) % pipeline.producers;
+        }
+    }
+    catch (...)
+    {
+        pipeline.aborted.store(true, std::memory_order_relaxed);
+        throw;
+    }
+    PNB_PHASE_FLUSH();
 
-        qr.UEVENARX_18(x0);
-        qr.UEVENARX_18(dx0);
+    return static_cast<double>(thread_match_count);
+}
 
-        // ---------------- forward round end -----------------
+// ---------------- kernel: matches among the forward halves of `source`, L backward passes per batch -----------------
+// source(backward) calls backward(sample) once per forward half. L = 1 is the scalar
+// backwardParity(); otherwise L samples are inverted together, one per lane
+// (pnbkernel::backwardParitySamples), and a tail of fewer than L samples goes scalar.
+template <size_t L, class Source>
+u64 matchforward(const pnbkernel::RoundPlan &plan, u16 global_idx, Source &&source)
+{
+    u64 match_count{0};
 
-        // ---------------- Z = X + X^R -----------------
-        ops::addState(x0, strdx0, sumstate);
-        ops::addState(dx0, dstrdx0, dsumstate);
+    pnbkernel::ForwardSample batch[L];
+    u32 guesses[L][KEYWORD_COUNT];
+    size_t filled = 0;
 
+    auto backward = [&](const pnbkernel::ForwardSample &s)
+    {
         // ---------------- flip key bit -----------------
-        TOGGLE_BIT(key[key_word], key_bit);
-        if (basic_config.key_size == 128)
-            TOGGLE_BIT(key[key_word + 4], key_bit);
-
-        // ---------------- make new X and X' with altered key bits -----------------
-        salsa::insert_key(strdx0, key);
-        salsa::insert_key(dstrdx0, key);
-
-        // ---------------- Z = X - X^R -----------------
-        ops::subtractState(sumstate, strdx0, minusstate);
-        ops::subtractState(dsumstate, dstrdx0, dminusstate);
-
-        // ---------------- backward round -----------------
-        qr.UEVENARX_18(minusstate);
-        qr.UEVENARX_18(dminusstate);
+        PNB_PHASE_START(); // pooled records are not timed
+        ops::copyState(guesses[filled], s.key, 0, KEYWORD_COUNT);
+        pnbkernel::toggleKeyBit(guesses[filled], global_idx, plan.key_128);
 
-        qr.EVENARX_13(minusstate);
-        qr.EVENARX_13(dminusstate);
-
-
-        if (basic_config.totalRoundsAreFractional())
+        // ---------------- Z - X^R + backward round + parity check -----------------
+        if constexpr (L == 1)
         {
-            if (rounded_total_rounds_are_odd)
-            {
-                bckward.Half_2_EvenRF(minusstate);
-                bckward.Half_2_EvenRF(dminusstate);
-            }
-            else
-            {
-                bckward.Half_2_OddRF(minusstate);
-                bckward.Half_2_OddRF(dminusstate);
-            }
+            if (s.fwd_parity == pnbkernel::backwardParity(plan, s, guesses[0]))
+                match_count++;
+            PNB_PHASE_SAMPLE();
         }
-        for (int i{rounded_total_rounds}; i > bwd_round; i--)
-        {
-            bckward.RoundFunction(minusstate, i);
-            bckward.RoundFunction(dminusstate, i);
-        }
-
-        if (fwd_rounds_are_fractional)
+        else
         {
-            if (rounded_fwd_rounds_are_odd)
+            // charged now: the next sample's forward half restarts the phase clock
+            batch[filled++] = s;
+            PNB_PHASE(KeyFlip);
+            if (filled < L)
+                return;
+            filled = 0;
+
+            u64 fwd = 0;
+            for (size_t l{0}; l < L; ++l)
             {
-                bckward.Half_1_EvenRF(minusstate);
-                bckward.Half_1_EvenRF(dminusstate);
-            }
-            else
-            {
-                bckward.Half_1_OddRF(minusstate);
-                bckward.Half_1_OddRF(dminusstate);
+                fwd |= static_cast<u64>(batch[l].fwd_parity) << l;
+                PNB_PHASE_SAMPLE();
             }
+            const u64 lane_mask = (L == 64) ? ~0ULL : ((1ULL << L) - 1);
+            match_count += std::popcount(~(fwd ^ pnbkernel::backwardParitySamples<L>(plan, batch, guesses)) & lane_mask);
         }
-        // ---------------- backward round end -----------------
-
-        // ---------------- XOR state -----------------
-        ops::xorState(minusstate, dminusstate, DiffState);
+    };
 
-        // ---------------- store backward parity -----------------
-        for (const auto &d : diff_config.mask)
-            bwd_parity ^= GET_BIT(DiffState[d.first], d.second);
+    source(backward);
 
-        // ---------------- parity check -----------------
-        if (fwd_parity == bwd_parity)
-            thread_match_count++;
+    // ---------------- tail of an incomplete batch -----------------
+    for (size_t l{0}; l < filled; ++l)
+    {
+        PNB_PHASE_START();
+        if (batch[l].fwd_parity == pnbkernel::backwardParity(plan, batch[l], guesses[l]))
+            match_count++;
+        PNB_PHASE_SAMPLE();
     }
 
-    return static_cast<double>(thread_match_count);
+    return match_count;
+}
+
+// ---------------- kernel: matches among `samples` samples (generated, or pool records from pool_first) -----------------
+template <size_t L>
+u64 matchsamples(const pnbkernel::RoundPlan &plan, u16 global_idx, u64 samples, u64 pool_first)
+{
+    return matchforward<L>(plan, global_idx, [&](auto &&backward)
+                           {
+        if (sample_pool)
+            sample_pool->forEach(pool_first, samples, backward);
+        else
+        {
+            pnbkernel::ForwardSample sample;
+            for (u64 loop{0}; loop < samples; ++loop)
+            {
+                // ---------------- salsa setup + forward round + Z = X + X^R -----------------
+                pnbkernel::generateSample(plan, sample);
+                backward(sample);
+            }
+        } });
 }
 
 // ---------------- skip helper -----------------
@@ -0,0 +1,436 @@
+/*
+ * REFERENCE IMPLEMENTATION OF a per-round diffusion profiler
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * Pushes X and X' = X ^ ID through the rounds and records, after every half-round, histograms
+ * of the Hamming weight of the difference X ^ X': per state word (0..32) and per column / row
+ * of the state matrix (0..128, grouped as in salsa::column / salsa::row, the groups
+ * salsa::computeHammingWeight sums). The mean-weight table shows how far the chosen ID has
+ * diffused by each half-round, which helps to pick distinguishing rounds before running a PNB
+ * search.
+ *
+ * Samples run LANES at a time in pnbkernel::LaneState (one word of all lanes contiguous), so
+ * the round function and the popcounts are vector loops; with -march=native on a CPU with
+ * AVX512-VPOPCNTDQ the weights of 16 lanes are one instruction (pnbkernel::laneDiffWeights).
+ * The column / row sums of the first batch are cross-checked against
+ * salsa::computeHammingWeight.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native diffusionprofile.cpp -o diffusion
+ *   ./diffusion [log2_samples] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + lane-batched state
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+
+constexpr size_t LANES = 16;                  // samples per batch
+constexpr size_t GROUP_COUNT = 8;             // 4 columns, then 4 rows
+constexpr size_t WORD_BINS = WORD_SIZE + 1;   // word weight 0..32
+constexpr size_t GROUP_BINS = 4 * WORD_SIZE + 1; // column / row weight 0..128
+
+static atomic<u64> progress{0};
+
+struct ProfileOptions
+{
+    int log2_samples = 20;
+};
+
+// histograms for half-rounds 0 (the ID itself) .. halves
+struct ProfileCounts
+{
+    int halves = 0;
+    vector<u64> words;  // [(h * 16 + word) * WORD_BINS + hw]
+    vector<u64> groups; // [(h * 8 + group) * GROUP_BINS + hw]
+
+    void init(int h)
+    {
+        halves = h;
+        words.assign(static_cast<size_t>(h + 1) * STATEWORD_COUNT * WORD_BINS, 0);
+        groups.assign(static_cast<size_t>(h + 1) * GROUP_COUNT * GROUP_BINS, 0);
+    }
+};
+
+ProfileCounts profilecount(int halves, u64 batches);
+
+static void parse_cli(int argc, char *argv[], ProfileOptions &opt)
+{
+    if (argc >= 2)
+    {
+        try
+        {
+            opt.log2_samples = std::stoi(argv[1]);
+            if (opt.log2_samples < 8 || opt.log2_samples > 36)
+            {
+                std::cerr << "log2_samples must be in [8,36]. Using default 20.\n";
+                opt.log2_samples = 20;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_samples input. Using default 20.\n";
+            opt.log2_samples = 20;
+        }
+    }
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        if (flag == "log" || flag == "1")
+            basic_config.logfile_flag = true;
+    }
+}
+
+static void init_config_and_banner(const ProfileOptions &opt, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "DiffusionProfile"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.total_rounds = 8;
+
+    diff_config.id = {{7, 31}};
+
+    // whole batches of LANES samples per thread
+    samples_config.samples_per_batch = 1ULL << opt.log2_samples;
+    samples_config.samples_per_thread =
+        (samples_config.samples_per_batch + samples_config.max_num_threads - 1) / samples_config.max_num_threads;
+    samples_config.samples_per_thread = (samples_config.samples_per_thread + LANES - 1) / LANES * LANES;
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+    display::printField(dmsg, "Popcount", "AVX512-VPOPCNTDQ");
+#else
+    display::printField(dmsg, "Popcount", "std::popcount");
+#endif
+    dmsg << basic_config.star_sep;
+}
+
+static ProfileCounts run_profile(int halves)
+{
+    ProfileCounts total;
+    total.init(halves);
+
+    const u64 batches = samples_config.samples_per_thread / LANES;
+    progress.store(0, std::memory_order_relaxed);
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    SpinnerWithETA spinner("Profiling diffusion ...", &progress,
+                           samples_config.samples_per_thread * samples_config.max_num_threads);
+    spinner.start();
+    #endif
+
+    vector<std::future<ProfileCounts>> future_results;
+    future_results.reserve(samples_config.max_num_threads);
+
+    for (u16 thread_number{0}; thread_number < samples_config.max_num_threads; ++thread_number)
+        future_results.emplace_back(async(launch::async, profilecount, halves, batches));
+
+    try
+    {
+        for (auto &f : future_results)
+        {
+            ProfileCounts c = f.get();
+            for (size_t i{0}; i < total.words.size(); ++i)
+                total.words[i] += c.words[i];
+            for (size_t i{0}; i < total.groups.size(); ++i)
+                total.groups[i] += c.groups[i];
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "Thread error: " << e.what() << "\n";
+        total.halves = -1;
+    }
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    spinner.stop();
+    #endif
+
+    return total;
+}
+
+static double hist_mean(const u64 *hist, size_t bins)
+{
+    u64 n = 0;
+    double sum = 0.0;
+    for (size_t w{0}; w < bins; ++w)
+    {
+        n += hist[w];
+        sum += static_cast<double>(hist[w]) * w;
+    }
+    return n ? sum / n : 0.0;
+}
+
+static string group_name(size_t g)
+{
+    const char name[3] = {g < 4 ? 'c' : 'r', static_cast<char>('0' + g % 4), '\0'};
+    return name;
+}
+
+// mean word weights per half-round on the console, mean column / row weights in the log
+static void print_tables(const ProfileCounts &c, std::ostream &summary, std::ostream &tables)
+{
+    summary << basic_config.dash_sep;
+    summary << "Mean Hamming weight of X ^ X' per word (32 = saturated at 16 on average)\n";
+    summary << "  h  round ";
+    for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+    {
+        char label[4];
+        std::snprintf(label, sizeof(label), "x%zu", i);
+        summary << std::setw(5) << label;
+    }
+    summary << "   state\n";
+
+    int diffused_at = -1;
+    summary << std::fixed << std::setprecision(1);
+    for (int h{0}; h <= c.halves; ++h)
+    {
+        double state = 0.0;
+        bool diffused = true;
+        summary << std::right << std::setw(3) << h << std::setw(7) << h / 2.0 << " ";
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            const double m = hist_mean(&c.words[(h * STATEWORD_COUNT + i) * WORD_BINS], WORD_BINS);
+            state += m;
+            diffused = diffused && std::fabs(m - WORD_SIZE / 2.0) < 0.5;
+            summary << std::setw(5) << m;
+        }
+        summary << std::setw(8) << state << "\n" << std::left;
+        if (diffused && diffused_at < 0)
+            diffused_at = h;
+    }
+    summary << basic_config.dash_sep;
+    if (diffused_at >= 0)
+        summary << "Every word is within 0.5 of weight 16 from half-round " << diffused_at
+                << " (round " << diffused_at / 2.0 << ") on.\n";
+    else
+        summary << "Some word is still more than 0.5 away from weight 16 after the last half-round.\n";
+    summary << basic_config.dash_sep;
+
+    tables << basic_config.eq_dash_sep;
+    tables << "Mean Hamming weight of X ^ X' per column (c) / row (r)\n";
+    tables << "  h  round ";
+    for (size_t g{0}; g < GROUP_COUNT; ++g)
+        tables << std::setw(7) << group_name(g);
+    tables << "\n";
+    tables << std::fixed << std::setprecision(2);
+    for (int h{0}; h <= c.halves; ++h)
+    {
+        tables << std::right << std::setw(3) << h << std::setw(7) << h / 2.0 << " ";
+        for (size_t g{0}; g < GROUP_COUNT; ++g)
+            tables << std::setw(7) << hist_mean(&c.groups[(h * GROUP_COUNT + g) * GROUP_BINS], GROUP_BINS);
+        tables << "\n" << std::left;
+    }
+}
+
+// half, round, word / group, mean, then one count column per weight
+static bool write_csv(const string &path, const ProfileCounts &c, bool groups)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    const size_t units = groups ? GROUP_COUNT : STATEWORD_COUNT;
+    const size_t bins = groups ? GROUP_BINS : WORD_BINS;
+    const vector<u64> &hist = groups ? c.groups : c.words;
+
+    out << "half,round," << (groups ? "group" : "word") << ",mean";
+    for (size_t w{0}; w < bins; ++w)
+        out << ",hw" << w;
+    out << "\n";
+
+    out << std::setprecision(6);
+    for (int h{0}; h <= c.halves; ++h)
+        for (size_t u{0}; u < units; ++u)
+        {
+            const u64 *row = &hist[(h * units + u) * bins];
+            out << h << "," << h / 2.0 << "," << (groups ? group_name(u) : std::to_string(u)) << ","
+                << hist_mean(row, bins);
+            for (size_t w{0}; w < bins; ++w)
+                out << "," << row[w];
+            out << "\n";
+        }
+    return static_cast<bool>(out);
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    ProfileOptions opt;
+    parse_cli(argc, argv, opt);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "diffusion";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    init_config_and_banner(opt, dmsg);
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    const int halves = static_cast<int>(std::lround(basic_config.total_rounds * 2.0));
+    ProfileCounts counts = run_profile(halves);
+    if (counts.halves < 0)
+        return 1;
+
+    stringstream report, tables;
+    print_tables(counts, report, tables);
+
+    // ---------------- save histograms -----------------
+    string base = pnbinfo::makeLogFilename(basic_config, diff_config, nullptr, folder);
+    base = base.substr(0, base.size() - 4); // drop ".txt"
+
+    for (bool groups : {false, true})
+    {
+        const string csv = base + (groups ? "_groups.csv" : "_words.csv");
+        if (write_csv(csv, counts, groups))
+            report << (groups ? "Column / row" : "Per-word") << " histograms saved to: " << csv << "\n";
+        else
+            std::cerr << "ERROR: Could not write " << csv << "\n";
+    }
+
+    cout << "\n" << report.str();
+    dmsg << report.str();
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << tables.str();
+        dmsg << timer.end_message();
+
+        std::string filename = base + ".txt";
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: histograms of `batches` x LANES samples -----------------
+ProfileCounts profilecount(int halves, u64 batches)
+{
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+
+    ProfileCounts c;
+    c.init(halves);
+
+    salsa::InitKey init_key;
+    u32 x0[STATEWORD_COUNT], key[KEYWORD_COUNT];
+    pnbkernel::LaneState<LANES> x, dx;
+    alignas(64) u32 hw[STATEWORD_COUNT][LANES];
+
+    auto record = [&](int h)
+    {
+        pnbkernel::laneDiffWeights(x, dx, hw);
+
+        u64 *words = &c.words[h * STATEWORD_COUNT * WORD_BINS];
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            for (size_t l{0}; l < LANES; ++l)
+                words[i * WORD_BINS + hw[i][l]]++;
+
+        u64 *groups = &c.groups[h * GROUP_COUNT * GROUP_BINS];
+        for (size_t g{0}; g < GROUP_COUNT; ++g)
+        {
+            const u16 *idx = (g < 4) ? salsa::column[g] : salsa::row[g - 4];
+            for (size_t l{0}; l < LANES; ++l)
+                groups[g * GROUP_BINS + hw[idx[0]][l] + hw[idx[1]][l] + hw[idx[2]][l] + hw[idx[3]][l]]++;
+        }
+    };
+
+    // lane 0 against the scalar HW_Config path, once per thread
+    auto cross_check = [&]()
+    {
+        u32 diff[STATEWORD_COUNT];
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            diff[i] = x.w[i][0] ^ dx.w[i][0];
+        for (u16 g{0}; g < 4; ++g)
+        {
+            salsa::HW_Config<u32> col_cfg{diff, salsa::column, nullptr, nullptr, g, 0, 0};
+            salsa::HW_Config<u32> row_cfg{diff, nullptr, nullptr, salsa::row, 0, 0, g};
+            const u32 col = hw[salsa::column[g][0]][0] + hw[salsa::column[g][1]][0] +
+                            hw[salsa::column[g][2]][0] + hw[salsa::column[g][3]][0];
+            const u32 row = hw[salsa::row[g][0]][0] + hw[salsa::row[g][1]][0] +
+                            hw[salsa::row[g][2]][0] + hw[salsa::row[g][3]][0];
+            if (static_cast<int>(col) != salsa::computeHammingWeight(col_cfg) ||
+                static_cast<int>(row) != salsa::computeHammingWeight(row_cfg))
+                throw std::runtime_error("diffusion profile: lane weights disagree with computeHammingWeight");
+        }
+    };
+
+    for (u64 batch{0}; batch < batches; ++batch)
+    {
+        // ---------------- salsa setup, one sample per lane -----------------
+        for (size_t l{0}; l < LANES; ++l)
+        {
+            salsa::init_iv_const(x0);
+            if (plan.key_128)
+                init_key.key_128bit(key);
+            else
+                init_key.key_256bit(key);
+            salsa::insert_key(x0, key);
+
+            for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            {
+                x.w[i][l] = x0[i];
+                dx.w[i][l] = x0[i] ^ plan.id_words[i];
+            }
+        }
+
+        // ---------------- weights after every half-round -----------------
+        record(0);
+        for (int h{1}; h <= halves; ++h)
+        {
+            pnbkernel::laneForwardHalf(x, h);
+            pnbkernel::laneForwardHalf(dx, h);
+            record(h);
+        }
+
+        if (batch == 0)
+            cross_check();
+
+        progress.fetch_add(LANES, std::memory_order_relaxed);
+    }
+
+    return c;
+}
@@ -0,0 +1,491 @@
+/*
+ * REFERENCE IMPLEMENTATION OF a fixed-key, multi-IV neutrality measurement
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * altaumstylepnb.cpp draws a fresh key for every sample, so its biases are averages over keys.
+ * An attack faces one key and many IVs. This program draws K keys and M IVs per key, measures
+ * the single-bit neutrality bias of every key bit under each key, and reports how the bias is
+ * spread across keys: mean, standard deviation (next to the sd expected from M samples alone),
+ * 5% / 95% quantiles, the share of keys under which the bit is a PNB, and the keys with the
+ * most PNBs (weak-key tail).
+ *
+ * The key-only steps of the first half-round are computed once per key
+ * (pnbkernel::KeyedFirstHalf). Each thread takes whole keys and counts into a small per-key
+ * array that is turned into biases when the key is done. The per-key biases are merged after
+ * all threads have finished.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native fixedkeybias.cpp -o fixedkey
+ *   ./fixedkey [neutrality] [log2_keys] [log2_ivs] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + forward/backward sample kernel
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+pnbinfo::PNBdetails pnb_config;
+
+constexpr size_t LANES = 16; // key bits per backward batch
+
+static atomic<u64> progress{0};
+
+struct FixedKeyOptions
+{
+    int log2_keys = 8;
+    int log2_ivs = 14;
+};
+
+// per-key results of one thread, key-major
+struct KeyBatch
+{
+    vector<pnbkernel::KeyMask> keys;
+    vector<float> bias; // [key][bit]
+    vector<float> eps_d; // [key]
+};
+
+// spread of one key bit's bias across keys
+struct BitSpread
+{
+    double mean = 0.0, sd = 0.0, sampling_sd = 0.0;
+    double q05 = 0.0, q95 = 0.0, lo = 0.0, hi = 0.0;
+    double pnb_rate = 0.0; // share of keys with |bias| >= neutrality
+};
+
+KeyBatch keybias(u64 keys, u64 ivs, u16 key_bits);
+
+static void parse_cli(int argc, char *argv[], FixedKeyOptions &opt)
+{
+    if (argc >= 2)
+    {
+        try
+        {
+            pnb_config.neutrality_measure = std::stod(argv[1]);
+            if (pnb_config.neutrality_measure < 0.0 || pnb_config.neutrality_measure > 1.0)
+            {
+                std::cerr << "Neutrality must be in [0,1]. Using default 0.35.\n";
+                pnb_config.neutrality_measure = 0.35;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid neutrality input. Using default 0.35.\n";
+            pnb_config.neutrality_measure = 0.35;
+        }
+    }
+
+    if (argc >= 3)
+    {
+        try
+        {
+            opt.log2_keys = std::stoi(argv[2]);
+            if (opt.log2_keys < 1 || opt.log2_keys > 16)
+            {
+                std::cerr << "log2_keys must be in [1,16]. Using default 8.\n";
+                opt.log2_keys = 8;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_keys input. Using default 8.\n";
+            opt.log2_keys = 8;
+        }
+    }
+
+    if (argc >= 4)
+    {
+        try
+        {
+            opt.log2_ivs = std::stoi(argv[3]);
+            if (opt.log2_ivs < 6 || opt.log2_ivs > 30)
+            {
+                std::cerr << "log2_ivs must be in [6,30]. Using default 14.\n";
+                opt.log2_ivs = 14;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_ivs input. Using default 14.\n";
+            opt.log2_ivs = 14;
+        }
+    }
+
+    for (int i = 4; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        if (flag == "log" || flag == "1")
+            basic_config.logfile_flag = true;
+    }
+}
+
+static void init_config_and_banner(const FixedKeyOptions &opt, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "FixedKeyBias"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.comment = "last round modified";
+    basic_config.total_rounds = 7.5;
+
+    diff_config.distinguishing_round = 5;
+    diff_config.id = {{7, 31}};
+    diff_config.mask = {{4, 7}};
+
+    // one batch per key, M IVs each
+    samples_config.num_batches = 1ULL << opt.log2_keys;
+    samples_config.samples_per_batch = 1ULL << opt.log2_ivs;
+    samples_config.samples_per_thread = samples_config.samples_per_batch *
+        ((samples_config.num_batches + samples_config.max_num_threads - 1) / samples_config.max_num_threads);
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    pnbinfo::showPNBConfig(pnb_config, dmsg);
+    display::printField(dmsg, "Keys", display::formatCountPow2Pow10(1ULL << opt.log2_keys));
+    display::printField(dmsg, "IVs per key", display::formatCountPow2Pow10(1ULL << opt.log2_ivs));
+    dmsg << basic_config.star_sep;
+}
+
+static KeyBatch run_keys(const FixedKeyOptions &opt, u16 key_bits)
+{
+    const u64 keys = 1ULL << opt.log2_keys;
+    const u64 ivs = 1ULL << opt.log2_ivs;
+    const u64 kpt = samples_config.samples_per_thread / ivs; // whole keys per thread
+
+    progress.store(0, std::memory_order_relaxed);
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    SpinnerWithETA spinner("Measuring per-key biases ...", &progress, keys * ivs);
+    spinner.start();
+    #endif
+
+    vector<std::future<KeyBatch>> future_results;
+    for (u64 first{0}; first < keys; first += kpt)
+        future_results.emplace_back(async(launch::async, keybias, std::min(kpt, keys - first), ivs, key_bits));
+
+    KeyBatch all;
+    try
+    {
+        for (auto &f : future_results)
+        {
+            KeyBatch b = f.get();
+            all.keys.insert(all.keys.end(), b.keys.begin(), b.keys.end());
+            all.bias.insert(all.bias.end(), b.bias.begin(), b.bias.end());
+            all.eps_d.insert(all.eps_d.end(), b.eps_d.begin(), b.eps_d.end());
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "Thread error: " << e.what() << "\n";
+    }
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    spinner.stop();
+    #endif
+
+    return all;
+}
+
+// q in [0,1] of v (v is reordered)
+static double quantile(vector<double> &v, double q)
+{
+    const size_t k = static_cast<size_t>(std::lround(q * static_cast<double>(v.size() - 1)));
+    std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(k), v.end());
+    return v[k];
+}
+
+static vector<BitSpread> spread_per_bit(const KeyBatch &b, u16 key_bits, u64 ivs)
+{
+    const size_t K = b.keys.size();
+    vector<BitSpread> out(key_bits);
+    vector<double> col(K);
+
+    for (u16 bit{0}; bit < key_bits; ++bit)
+    {
+        BitSpread &s = out[bit];
+        double sum = 0.0, sq = 0.0;
+        u64 pnb_keys = 0;
+        for (size_t k{0}; k < K; ++k)
+        {
+            col[k] = b.bias[k * key_bits + bit];
+            sum += col[k];
+            sq += col[k] * col[k];
+            pnb_keys += (std::fabs(col[k]) >= pnb_config.neutrality_measure && std::fabs(col[k]) > 0.0);
+        }
+        s.mean = sum / K;
+        s.sd = (K > 1) ? std::sqrt(std::max(0.0, (sq - sum * s.mean) / (K - 1))) : 0.0;
+        s.sampling_sd = std::sqrt(std::max(0.0, 1.0 - s.mean * s.mean) / static_cast<double>(ivs));
+        s.pnb_rate = static_cast<double>(pnb_keys) / K;
+        s.lo = *std::min_element(col.begin(), col.end());
+        s.hi = *std::max_element(col.begin(), col.end());
+        s.q05 = quantile(col, 0.05);
+        s.q95 = quantile(col, 0.95);
+    }
+    return out;
+}
+
+static void print_report(const KeyBatch &b, const vector<BitSpread> &spread, u16 key_bits,
+                         std::ostream &summary, std::ostream &table)
+{
+    const size_t K = b.keys.size();
+    const double nm = pnb_config.neutrality_measure;
+
+    // ---------------- PNB sets by mean bias and by stability across keys -----------------
+    vector<u16> mean_pnbs, stable, unstable;
+    for (u16 bit{0}; bit < key_bits; ++bit)
+    {
+        if (std::fabs(spread[bit].mean) >= nm && std::fabs(spread[bit].mean) > 0.0)
+            mean_pnbs.push_back(bit);
+        if (spread[bit].pnb_rate >= 0.95)
+            stable.push_back(bit);
+        else if (spread[bit].pnb_rate > 0.05)
+            unstable.push_back(bit);
+    }
+
+    summary << basic_config.dash_sep;
+    summary << mean_pnbs.size() << " PNBs by mean bias:\n";
+    pnbinfo::print_braced_list(mean_pnbs, summary);
+    summary << stable.size() << " bits are PNBs under >= 95% of the keys:\n";
+    pnbinfo::print_braced_list(stable, summary);
+    summary << unstable.size() << " bits are PNBs under some keys only (5% .. 95%):\n";
+    pnbinfo::print_braced_list(unstable, summary);
+
+    // ---------------- bits whose bias depends most on the key -----------------
+    vector<u16> order(key_bits);
+    for (u16 bit{0}; bit < key_bits; ++bit)
+        order[bit] = bit;
+    auto excess = [&](u16 bit)
+    { return spread[bit].sd * spread[bit].sd - spread[bit].sampling_sd * spread[bit].sampling_sd; };
+    std::sort(order.begin(), order.end(), [&](u16 a, u16 c)
+              { return excess(a) > excess(c); });
+
+    summary << basic_config.dash_sep;
+    summary << "Largest key dependence (sd across keys vs sd expected from the IVs alone):\n";
+    summary << "  bit   mean_bias   sd_keys  sd_sampling     q05       q95    PNB-keys\n";
+    summary << std::fixed;
+    for (size_t r{0}; r < std::min<size_t>(10, order.size()); ++r)
+    {
+        const BitSpread &s = spread[order[r]];
+        summary << std::right << std::setw(5) << order[r] << std::setprecision(5)
+                << std::setw(12) << s.mean << std::setw(10) << s.sd << std::setw(13) << s.sampling_sd
+                << std::setw(10) << s.q05 << std::setw(10) << s.q95
+                << std::setprecision(1) << std::setw(10) << 100.0 * s.pnb_rate << "%\n"
+                << std::left;
+    }
+
+    // ---------------- weak-key tail: keys with the most PNBs -----------------
+    vector<u16> pnbs_per_key(K, 0);
+    for (size_t k{0}; k < K; ++k)
+        for (u16 bit{0}; bit < key_bits; ++bit)
+        {
+            const double e = std::fabs(b.bias[k * key_bits + bit]);
+            pnbs_per_key[k] += (e >= nm && e > 0.0);
+        }
+
+    vector<size_t> by_count(K);
+    for (size_t k{0}; k < K; ++k)
+        by_count[k] = k;
+    std::sort(by_count.begin(), by_count.end(), [&](size_t a, size_t c)
+              { return pnbs_per_key[a] > pnbs_per_key[c]; });
+
+    summary << basic_config.dash_sep;
+    summary << "PNBs per key: min " << pnbs_per_key[by_count.back()]
+            << ", median " << pnbs_per_key[by_count[K / 2]]
+            << ", max " << pnbs_per_key[by_count.front()] << "\n";
+    summary << "Keys with the most PNBs (eps_d, key words 0..7):\n";
+    for (size_t r{0}; r < std::min<size_t>(5, K); ++r)
+    {
+        const size_t k = by_count[r];
+        summary << std::right << std::setw(5) << pnbs_per_key[k] << "  "
+                << std::setprecision(5) << std::setw(9) << b.eps_d[k] << "  " << std::hex << std::setfill('0');
+        for (u32 w : b.keys[k])
+            summary << std::setw(8) << w << " ";
+        summary << std::dec << std::setfill(' ') << std::left << "\n";
+    }
+    summary << basic_config.dash_sep;
+
+    // ---------------- full per-bit table (log) -----------------
+    table << basic_config.eq_dash_sep;
+    table << "Per-bit bias spread over " << K << " keys\n";
+    table << "  bit   mean_bias   sd_keys  sd_sampling       min       q05       q95       max    PNB-keys\n";
+    table << std::fixed;
+    for (u16 bit{0}; bit < key_bits; ++bit)
+    {
+        const BitSpread &s = spread[bit];
+        table << std::right << std::setw(5) << bit << std::setprecision(5)
+              << std::setw(12) << s.mean << std::setw(10) << s.sd << std::setw(13) << s.sampling_sd
+              << std::setw(10) << s.lo << std::setw(10) << s.q05 << std::setw(10) << s.q95 << std::setw(10) << s.hi
+              << std::setprecision(1) << std::setw(10) << 100.0 * s.pnb_rate << "%\n"
+              << std::left;
+    }
+}
+
+// bit, then the spread columns
+static bool write_csv(const string &path, const vector<BitSpread> &spread)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    out << "bit,mean,sd_keys,sd_sampling,min,q05,q95,max,pnb_rate\n";
+    out << std::setprecision(6);
+    for (size_t bit{0}; bit < spread.size(); ++bit)
+    {
+        const BitSpread &s = spread[bit];
+        out << bit << "," << s.mean << "," << s.sd << "," << s.sampling_sd << "," << s.lo << ","
+            << s.q05 << "," << s.q95 << "," << s.hi << "," << s.pnb_rate << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    FixedKeyOptions opt;
+    parse_cli(argc, argv, opt);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "fixedkey";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    init_config_and_banner(opt, dmsg);
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    const u16 key_bits = static_cast<u16>(basic_config.key_size);
+    KeyBatch batch = run_keys(opt, key_bits);
+    if (batch.keys.empty())
+        return 1;
+
+    const vector<BitSpread> spread = spread_per_bit(batch, key_bits, 1ULL << opt.log2_ivs);
+
+    stringstream report, table;
+    print_report(batch, spread, key_bits, report, table);
+
+    // ---------------- save spread table -----------------
+    string base = pnbinfo::makeLogFilename(basic_config, diff_config, &pnb_config, folder);
+    base = base.substr(0, base.size() - 4); // drop ".txt"
+
+    const string csv = base + "_spread.csv";
+    if (write_csv(csv, spread))
+        report << "Per-bit spread table saved to: " << csv << "\n";
+    else
+        std::cerr << "ERROR: Could not write " << csv << "\n";
+
+    cout << "\n" << report.str();
+    dmsg << report.str();
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << table.str();
+        dmsg << timer.end_message();
+
+        std::string filename = base + ".txt";
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: `keys` fresh keys, `ivs` IVs each -----------------
+KeyBatch keybias(u64 keys, u64 ivs, u16 key_bits)
+{
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+
+    KeyBatch out;
+    out.keys.resize(keys);
+    out.bias.resize(keys * key_bits);
+    out.eps_d.resize(keys);
+
+    salsa::InitKey init_key;
+    pnbkernel::KeyedFirstHalf kf;
+    pnbkernel::ForwardSample sample;
+    u32 iv[SALSA_IV_END - SALSA_IV_START + 1];
+    u32 guesses[LANES][KEYWORD_COUNT];
+    vector<u32> matches(key_bits); // this key only
+
+    for (u64 k{0}; k < keys; ++k)
+    {
+        // ---------------- key setup, key-only steps of half-round 1 -----------------
+        u32 *key = out.keys[k].data();
+        if (plan.key_128)
+            init_key.key_128bit(key);
+        else
+            init_key.key_256bit(key);
+        pnbkernel::makeKeyedFirstHalf(plan, key, kf);
+
+        std::fill(matches.begin(), matches.end(), 0u);
+        u64 d_hits = 0;
+
+        for (u64 n{0}; n < ivs; ++n)
+        {
+            for (u32 &w : iv)
+                w = RandomNumber<u32>();
+            pnbkernel::forwardFromKeyed(plan, kf, iv, sample);
+            d_hits += (sample.fwd_parity == 0);
+
+            // ---------------- every key bit flipped, LANES at a time -----------------
+            for (u16 b0{0}; b0 < key_bits; b0 += LANES)
+            {
+                for (size_t l{0}; l < LANES; ++l)
+                {
+                    ops::copyState(guesses[l], key, 0, KEYWORD_COUNT);
+                    pnbkernel::toggleKeyBit(guesses[l], static_cast<u16>(b0 + l), plan.key_128);
+                }
+
+                const u64 parities = pnbkernel::backwardParityLanes<LANES>(plan, sample, guesses);
+                for (size_t l{0}; l < LANES; ++l)
+                    matches[b0 + l] += (sample.fwd_parity == ((parities >> l) & 1));
+            }
+
+            if ((n & 0xff) == 0xff)
+                progress.fetch_add(0x100, std::memory_order_relaxed);
+        }
+        progress.fetch_add(ivs & 0xff, std::memory_order_relaxed);
+
+        for (u16 bit{0}; bit < key_bits; ++bit)
+            out.bias[k * key_bits + bit] = static_cast<float>(stats::biasFromCount(matches[bit], ivs));
+        out.eps_d[k] = static_cast<float>(stats::biasFromCount(d_hits, ivs));
+    }
+
+    return out;
+}
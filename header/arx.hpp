@@ -0,0 +1,384 @@
+/*
+ * REFERENCE IMPLEMENTATION OF arx header file
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ *
+ * Synopsis:
+ * Compile-time description of the Salsa-family ARX permutations and the round kernels
+ * generated from it. A cipher is a traits type that gives
+ *   - the quarter-round index tables of odd (column) and even rounds,
+ *   - the four ARX steps of a quarter-round (word positions and rotation amounts),
+ *   - the add/xor order of a step (StepKind),
+ *   - where constants, key and IV sit in the initial state,
+ *   - the steps of the modified last round that follow the last full half-round.
+ * Salsa and ChaCha are the two instantiations. Scalar and lane-batched half-rounds,
+ * their inverses and the state setup below are written once against that description,
+ * and every table and rotation is a constant by the time -O3 sees the loops.
+ *
+ * Half-rounds follow the pnbkernel convention: half-round h (1-based) belongs to round
+ * (h + 1) / 2, odd h runs steps 0 and 1 of every quarter-round, even h steps 2 and 3.
+ */
+
+#pragma once
+#include "salsa.hpp"
+#include <array>
+
+namespace arx
+{
+    enum class CipherId : u32
+    {
+        Salsa = 1,
+        ChaCha = 2,
+    };
+
+    // how one step updates the words of a quarter-round
+    enum class StepKind
+    {
+        XorRotSum, // x[out] ^= (x[p] + x[q]) <<< rot                  (Salsa)
+        AddXorRot, // x[p] += x[q]; x[out] = (x[out] ^ x[p]) <<< rot   (ChaCha)
+    };
+
+    // word positions 0..3 inside a quarter-round (a, b, c, d) and the rotation amount
+    struct Step
+    {
+        u8 out, p, q, rot;
+    };
+
+    constexpr size_t IV_WORD_COUNT = 4;
+
+    struct Salsa
+    {
+        static constexpr CipherId ID = CipherId::Salsa;
+        static constexpr const char *NAME = "salsa";
+        static constexpr StepKind KIND = StepKind::XorRotSum;
+
+        // b ^= (a + d) <<< 7, c ^= (b + a) <<< 9, d ^= (c + b) <<< 13, a ^= (d + c) <<< 18
+        static constexpr Step STEPS[4] = {{1, 0, 3, 7}, {2, 1, 0, 9}, {3, 2, 1, 13}, {0, 3, 2, 18}};
+        static constexpr u16 ODD[4][4] = {{0, 4, 8, 12}, {5, 9, 13, 1}, {10, 14, 2, 6}, {15, 3, 7, 11}};  // columns
+        static constexpr u16 EVEN[4][4] = {{0, 1, 2, 3}, {5, 6, 7, 4}, {10, 11, 8, 9}, {15, 12, 13, 14}}; // rows
+
+        // salsa::init_iv_const() constants, key words 1..4 and 11..14, IV words 6..9
+        static constexpr u16 CONST_WORDS[4] = {0, 5, 10, 15};
+        static constexpr u32 CONSTANTS[4] = {0x61707865, 0x3120646e, 0x79622d36, 0x6b206574};
+        static constexpr u16 KEY_WORDS[KEYWORD_COUNT] = {1, 2, 3, 4, 11, 12, 13, 14};
+        static constexpr u16 IV_WORDS[IV_WORD_COUNT] = {6, 7, 8, 9};
+
+        // modified last round: the 13 step of a row round, 18 left out
+        static constexpr std::array<u8, 1> TAIL{2};
+    };
+
+    struct ChaCha
+    {
+        static constexpr CipherId ID = CipherId::ChaCha;
+        static constexpr const char *NAME = "chacha";
+        static constexpr StepKind KIND = StepKind::AddXorRot;
+
+        // a += b, d = (d ^ a) <<< 16; c += d, b = (b ^ c) <<< 12; then 8 and 7 likewise
+        static constexpr Step STEPS[4] = {{3, 0, 1, 16}, {1, 2, 3, 12}, {3, 0, 1, 8}, {1, 2, 3, 7}};
+        static constexpr u16 ODD[4][4] = {{0, 4, 8, 12}, {1, 5, 9, 13}, {2, 6, 10, 14}, {3, 7, 11, 15}};  // columns
+        static constexpr u16 EVEN[4][4] = {{0, 5, 10, 15}, {1, 6, 11, 12}, {2, 7, 8, 13}, {3, 4, 9, 14}}; // diagonals
+
+        // "expand 32-byte k", key words 4..11, counter and nonce words 12..15
+        static constexpr u16 CONST_WORDS[4] = {0, 1, 2, 3};
+        static constexpr u32 CONSTANTS[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+        static constexpr u16 KEY_WORDS[KEYWORD_COUNT] = {4, 5, 6, 7, 8, 9, 10, 11};
+        static constexpr u16 IV_WORDS[IV_WORD_COUNT] = {12, 13, 14, 15};
+
+        // the last round is a full round
+        static constexpr std::array<u8, 0> TAIL{};
+    };
+
+    // CipherInfo::cipher_name -> cipher
+    inline CipherId cipherFromName(const std::string &name)
+    {
+        if (name == Salsa::NAME)
+            return CipherId::Salsa;
+        if (name == ChaCha::NAME)
+            return CipherId::ChaCha;
+        throw std::invalid_argument("arx: unknown cipher \"" + name + "\" (salsa or chacha)");
+    }
+
+    // calls f(Salsa{}) or f(ChaCha{}), so one generic lambda covers both instantiations
+    template <class F>
+    inline decltype(auto) dispatch(CipherId id, F &&f)
+    {
+        if (id == CipherId::ChaCha)
+            return f(ChaCha{});
+        return f(Salsa{});
+    }
+
+    // ---------------- state setup -----------------
+    template <class C>
+    inline void insertKey(u32 *x, const u32 *key)
+    {
+        for (size_t k{0}; k < KEYWORD_COUNT; ++k)
+            x[C::KEY_WORDS[k]] = key[k];
+    }
+
+    // constants + iv + key
+    template <class C>
+    inline void initialState(u32 *x, const u32 *iv, const u32 *key)
+    {
+        for (size_t i{0}; i < 4; ++i)
+            x[C::CONST_WORDS[i]] = C::CONSTANTS[i];
+        for (size_t i{0}; i < IV_WORD_COUNT; ++i)
+            x[C::IV_WORDS[i]] = iv[i];
+        insertKey<C>(x, key);
+    }
+
+    template <class C>
+    inline void extractKey(const u32 *x, u32 *key)
+    {
+        for (size_t k{0}; k < KEYWORD_COUNT; ++k)
+            key[k] = x[C::KEY_WORDS[k]];
+    }
+
+    template <class C>
+    inline void extractIV(const u32 *x, u32 *iv)
+    {
+        for (size_t i{0}; i < IV_WORD_COUNT; ++i)
+            iv[i] = x[C::IV_WORDS[i]];
+    }
+
+    // ---------------- one step on all four quarter-rounds -----------------
+    template <class C, int S, bool ODD_ROUND>
+    inline void stepForward(u32 *x)
+    {
+        constexpr Step st = C::STEPS[S];
+        for (int q{0}; q < 4; ++q)
+        {
+            const u16 *t = ODD_ROUND ? C::ODD[q] : C::EVEN[q];
+            if constexpr (C::KIND == StepKind::XorRotSum)
+                x[t[st.out]] ^= std::rotl(static_cast<u32>(x[t[st.p]] + x[t[st.q]]), st.rot);
+            else
+            {
+                x[t[st.p]] += x[t[st.q]];
+                x[t[st.out]] = std::rotl(x[t[st.out]] ^ x[t[st.p]], st.rot);
+            }
+        }
+    }
+
+    template <class C, int S, bool ODD_ROUND>
+    inline void stepBackward(u32 *x)
+    {
+        constexpr Step st = C::STEPS[S];
+        for (int q{0}; q < 4; ++q)
+        {
+            const u16 *t = ODD_ROUND ? C::ODD[q] : C::EVEN[q];
+            if constexpr (C::KIND == StepKind::XorRotSum)
+                x[t[st.out]] ^= std::rotl(static_cast<u32>(x[t[st.p]] + x[t[st.q]]), st.rot);
+            else
+            {
+                x[t[st.out]] = std::rotr(x[t[st.out]], st.rot) ^ x[t[st.p]];
+                x[t[st.p]] -= x[t[st.q]];
+            }
+        }
+    }
+
+    // Lane-wise versions: w[word][lane]. The rows of a step are distinct words, and saying so
+    // (__restrict) is what lets the lane loops become vector instructions.
+    template <class C, int S, size_t L>
+    inline void laneStepRows(u32 *__restrict out, u32 *__restrict p, const u32 *__restrict q, bool inverse)
+    {
+        constexpr Step st = C::STEPS[S];
+#pragma GCC unroll 1
+        for (size_t l{0}; l < L; ++l)
+        {
+            if constexpr (C::KIND == StepKind::XorRotSum)
+                out[l] ^= std::rotl(static_cast<u32>(p[l] + q[l]), st.rot);
+            else if (!inverse)
+            {
+                p[l] += q[l];
+                out[l] = std::rotl(out[l] ^ p[l], st.rot);
+            }
+            else
+            {
+                out[l] = std::rotr(out[l], st.rot) ^ p[l];
+                p[l] -= q[l];
+            }
+        }
+    }
+
+    template <class C, int S, bool ODD_ROUND, size_t L>
+    inline void laneStepForward(u32 (*w)[L])
+    {
+        constexpr Step st = C::STEPS[S];
+        for (int q{0}; q < 4; ++q)
+        {
+            const u16 *t = ODD_ROUND ? C::ODD[q] : C::EVEN[q];
+            laneStepRows<C, S, L>(w[t[st.out]], w[t[st.p]], w[t[st.q]], false);
+        }
+    }
+
+    template <class C, int S, bool ODD_ROUND, size_t L>
+    inline void laneStepBackward(u32 (*w)[L])
+    {
+        constexpr Step st = C::STEPS[S];
+        for (int q{0}; q < 4; ++q)
+        {
+            const u16 *t = ODD_ROUND ? C::ODD[q] : C::EVEN[q];
+            laneStepRows<C, S, L>(w[t[st.out]], w[t[st.p]], w[t[st.q]], true);
+        }
+    }
+
+    // ---------------- half-rounds -----------------
+    template <class C>
+    inline void forwardHalf(u32 *x, int h)
+    {
+        const bool odd_round = (((h + 1) / 2) & 1);
+        if (h & 1)
+        {
+            if (odd_round)
+            {
+                stepForward<C, 0, true>(x);
+                stepForward<C, 1, true>(x);
+            }
+            else
+            {
+                stepForward<C, 0, false>(x);
+                stepForward<C, 1, false>(x);
+            }
+        }
+        else
+        {
+            if (odd_round)
+            {
+                stepForward<C, 2, true>(x);
+                stepForward<C, 3, true>(x);
+            }
+            else
+            {
+                stepForward<C, 2, false>(x);
+                stepForward<C, 3, false>(x);
+            }
+        }
+    }
+
+    // undoes half-round h
+    template <class C>
+    inline void backwardHalf(u32 *x, int h)
+    {
+        const bool odd_round = (((h + 1) / 2) & 1);
+        if (h & 1)
+        {
+            if (odd_round)
+            {
+                stepBackward<C, 1, true>(x);
+                stepBackward<C, 0, true>(x);
+            }
+            else
+            {
+                stepBackward<C, 1, false>(x);
+                stepBackward<C, 0, false>(x);
+            }
+        }
+        else
+        {
+            if (odd_round)
+            {
+                stepBackward<C, 3, true>(x);
+                stepBackward<C, 2, true>(x);
+            }
+            else
+            {
+                stepBackward<C, 3, false>(x);
+                stepBackward<C, 2, false>(x);
+            }
+        }
+    }
+
+    template <class C, size_t L>
+    inline void laneForwardHalf(u32 (*w)[L], int h)
+    {
+        const bool odd_round = (((h + 1) / 2) & 1);
+        if (h & 1)
+        {
+            if (odd_round)
+            {
+                laneStepForward<C, 0, true, L>(w);
+                laneStepForward<C, 1, true, L>(w);
+            }
+            else
+            {
+                laneStepForward<C, 0, false, L>(w);
+                laneStepForward<C, 1, false, L>(w);
+            }
+        }
+        else
+        {
+            if (odd_round)
+            {
+                laneStepForward<C, 2, true, L>(w);
+                laneStepForward<C, 3, true, L>(w);
+            }
+            else
+            {
+                laneStepForward<C, 2, false, L>(w);
+                laneStepForward<C, 3, false, L>(w);
+            }
+        }
+    }
+
+    template <class C, size_t L>
+    inline void laneBackwardHalf(u32 (*w)[L], int h)
+    {
+        const bool odd_round = (((h + 1) / 2) & 1);
+        if (h & 1)
+        {
+            if (odd_round)
+            {
+                laneStepBackward<C, 1, true, L>(w);
+                laneStepBackward<C, 0, true, L>(w);
+            }
+            else
+            {
+                laneStepBackward<C, 1, false, L>(w);
+                laneStepBackward<C, 0, false, L>(w);
+            }
+        }
+        else
+        {
+            if (odd_round)
+            {
+                laneStepBackward<C, 3, true, L>(w);
+                laneStepBackward<C, 2, true, L>(w);
+            }
+            else
+            {
+                laneStepBackward<C, 3, false, L>(w);
+                laneStepBackward<C, 2, false, L>(w);
+            }
+        }
+    }
+
+    // ---------------- modified last round -----------------
+    // C::TAIL steps of an even round, applied after the last full half-round
+    template <class C>
+    inline void lastRoundTail(u32 *x)
+    {
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { (stepForward<C, C::TAIL[I], false>(x), ...); }(std::make_index_sequence<C::TAIL.size()>{});
+    }
+
+    template <class C>
+    inline void undoLastRoundTail(u32 *x)
+    {
+        constexpr size_t N = C::TAIL.size();
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { (stepBackward<C, C::TAIL[N - 1 - I], false>(x), ...); }(std::make_index_sequence<N>{});
+    }
+
+    template <class C, size_t L>
+    inline void laneUndoLastRoundTail(u32 (*w)[L])
+    {
+        constexpr size_t N = C::TAIL.size();
+        [&]<size_t... I>(std::index_sequence<I...>)
+        { (laneStepBackward<C, C::TAIL[N - 1 - I], false, L>(w), ...); }(std::make_index_sequence<N>{});
+    }
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/**
+ * @brief Process-wide arena for large, long-lived arrays, backed by 2 MB pages.
+ *
+ * Memory is mapped in blocks (BLOCK_BYTES, or more for a larger request), each tried as:
+ *   1. explicit 2 MB huge pages (MAP_HUGETLB; needs vm.nr_hugepages to be set),
+ *   2. 2 MB-aligned anonymous memory with MADV_HUGEPAGE (transparent huge pages),
+ *   3. plain 4 KB pages when THP is disabled.
+ * allocate() is a lock-free bump of the current block (one CAS), so workers can take their
+ * buffers concurrently; only mapping a new block takes a mutex. Nothing is freed one by one:
+ * the whole arena is unmapped at once by release() or at exit, so only use it for arrays
+ * that live until the end of the run. Containers of trivially destructible types may still be
+ * destroyed after release() (Allocator::deallocate does nothing).
+ *
+ * Example:
+ *   arena::vector<u64> counts(256 * 512);       // from arena::global()
+ *   void *buf = arena::global().allocate(bytes, 64);
+ *   std::cout << arena::global().report();
+ */
+namespace arena
+{
+    constexpr std::size_t HUGE_PAGE = 2ULL << 20;
+    constexpr std::size_t BLOCK_BYTES = 64ULL << 20;
+
+    enum class Backing
+    {
+        HugeTLB,     // explicit 2 MB pages
+        Transparent, // THP requested with madvise
+        Small        // 4 KB pages
+    };
+
+    inline const char *backingName(Backing b)
+    {
+        switch (b)
+        {
+        case Backing::HugeTLB:
+            return "2 MB huge pages";
+        case Backing::Transparent:
+            return "transparent huge pages";
+        default:
+            return "4 KB pages";
+        }
+    }
+
+    struct Stats
+    {
+        std::size_t blocks = 0;
+        std::size_t mapped[3] = {}; // bytes per Backing
+        std::size_t used = 0;       // bytes handed out, alignment padding included
+        std::size_t allocations = 0;
+        std::size_t thp_backed = 0; // Transparent bytes the kernel actually backs with huge pages
+    };
+
+    class Arena
+    {
+    public:
+        Arena() = default;
+        ~Arena() { release(); }
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        // `bytes` aligned to `align` (a power of two, at most HUGE_PAGE); throws std::bad_alloc
+        void *allocate(std::size_t bytes, std::size_t align = 64)
+        {
+            bytes = std::max<std::size_t>(bytes, 1);
+            for (;;)
+            {
+                Block *b = current_.load(std::memory_order_acquire);
+                if (b)
+                {
+                    std::size_t used = b->used.load(std::memory_order_relaxed);
+                    for (;;)
+                    {
+                        const std::size_t start = (used + align - 1) & ~(align - 1);
+                        if (start + bytes > b->size)
+                            break;
+                        if (b->used.compare_exchange_weak(used, start + bytes, std::memory_order_relaxed))
+                        {
+                            allocations_.fetch_add(1, std::memory_order_relaxed);
+                            return b->base + start;
+                        }
+                    }
+                }
+                grow(b, bytes + align);
+            }
+        }
+
+        template <class T>
+        T *allocate(std::size_t count)
+        {
+            return static_cast<T *>(allocate(count * sizeof(T), std::max<std::size_t>(alignof(T), 64)));
+        }
+
+        // unmaps every block; pointers from allocate() are invalid afterwards
+        void release()
+        {
+            std::lock_guard<std::mutex> lock(grow_mutex_);
+            current_.store(nullptr, std::memory_order_release);
+#ifdef __linux__
+            for (const auto &b : blocks_)
+                ::munmap(b->map_base, b->map_size);
+#endif
+            blocks_.clear();
+        }
+
+        Stats stats() const
+        {
+            std::lock_guard<std::mutex> lock(grow_mutex_);
+            Stats s;
+            s.blocks = blocks_.size();
+            s.allocations = allocations_.load(std::memory_order_relaxed);
+            for (const auto &b : blocks_)
+            {
+                s.mapped[static_cast<int>(b->backing)] += b->size;
+                s.used += b->used.load(std::memory_order_relaxed);
+            }
+            s.thp_backed = thpBacked();
+            return s;
+        }
+
+        // one line per backing in use; empty when nothing was allocated
+        std::string report() const
+        {
+            const Stats s = stats();
+            if (s.blocks == 0)
+                return {};
+            auto mib = [](std::size_t bytes)
+            {
+                std::ostringstream m;
+                m << std::fixed << std::setprecision(1) << static_cast<double>(bytes) / (1 << 20) << " MiB";
+                return m.str();
+            };
+            std::ostringstream ss;
+            ss << "Arena: " << s.allocations << " allocations, " << mib(s.used) << " used in " << s.blocks
+               << (s.blocks == 1 ? " block" : " blocks") << "\n";
+            for (int k{0}; k < 3; ++k)
+            {
+                if (s.mapped[k] == 0)
+                    continue;
+                ss << "  " << std::left << std::setw(24) << backingName(static_cast<Backing>(k)) << std::right
+                   << std::setw(12) << mib(s.mapped[k]) << " mapped";
+                if (static_cast<Backing>(k) == Backing::Transparent)
+                    ss << ", " << mib(s.thp_backed) << " backed by huge pages";
+                ss << "\n";
+            }
+            return ss.str();
+        }
+
+    private:
+        struct Block
+        {
+            char *base = nullptr; // first usable byte, HUGE_PAGE aligned
+            std::size_t size = 0;
+            std::atomic<std::size_t> used{0};
+            Backing backing = Backing::Small;
+            void *map_base = nullptr; // what munmap() needs
+            std::size_t map_size = 0;
+        };
+
+        std::atomic<Block *> current_{nullptr};
+        std::vector<std::unique_ptr<Block>> blocks_;
+        mutable std::mutex grow_mutex_;
+        std::atomic<std::size_t> allocations_{0};
+
+        // maps a new block unless another thread already replaced `seen`
+        void grow(Block *seen, std::size_t min_bytes)
+        {
+            std::lock_guard<std::mutex> lock(grow_mutex_);
+            if (current_.load(std::memory_order_acquire) != seen)
+                return;
+
+            auto b = std::make_unique<Block>();
+            b->size = std::max(BLOCK_BYTES, (min_bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1));
+            map(*b);
+            current_.store(b.get(), std::memory_order_release);
+            blocks_.push_back(std::move(b));
+        }
+
+        static void map(Block &b)
+        {
+#ifdef __linux__
+            constexpr int PROT = PROT_READ | PROT_WRITE;
+            constexpr int FLAGS = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+            void *p = ::mmap(nullptr, b.size, PROT, FLAGS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+            if (p != MAP_FAILED)
+            {
+                b.base = static_cast<char *>(p);
+                b.map_base = p;
+                b.map_size = b.size;
+                b.backing = Backing::HugeTLB;
+                return;
+            }
+#endif
+            // over-map by one huge page and trim, so the block starts on a 2 MB boundary
+            const std::size_t span = b.size + HUGE_PAGE;
+            void *raw = ::mmap(nullptr, span, PROT, FLAGS, -1, 0);
+            if (raw == MAP_FAILED)
+                throw std::bad_alloc();
+            const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw);
+            const std::uintptr_t aligned = (start + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+            if (aligned > start)
+                ::munmap(raw, aligned - start);
+            if (aligned + b.size < start + span)
+                ::munmap(reinterpret_cast<void *>(aligned + b.size), start + span - aligned - b.size);
+
+            b.base = reinterpret_cast<char *>(aligned);
+            b.map_base = b.base;
+            b.map_size = b.size;
+#ifdef MADV_HUGEPAGE
+            b.backing = (::madvise(b.base, b.size, MADV_HUGEPAGE) == 0) ? Backing::Transparent : Backing::Small;
+#endif
+#else
+            throw std::bad_alloc();
+#endif
+        }
+
+        // AnonHugePages of the THP blocks, from /proc/self/smaps (0 when unreadable)
+        std::size_t thpBacked() const
+        {
+            std::size_t total = 0;
+#ifdef __linux__
+            std::ifstream smaps("/proc/self/smaps");
+            std::string line;
+            bool inside = false;
+            while (std::getline(smaps, line))
+            {
+                const std::size_t dash = line.find('-');
+                if (dash != std::string::npos && dash > 0 && std::isxdigit(static_cast<unsigned char>(line[0])) &&
+                    line.find(' ') > dash)
+                {
+                    const std::uintptr_t lo = std::stoull(line.substr(0, dash), nullptr, 16);
+                    inside = false;
+                    for (const auto &b : blocks_)
+                    {
+                        const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(b->base);
+                        if (b->backing == Backing::Transparent && lo >= base && lo < base + b->size)
+                            inside = true;
+                    }
+                }
+                else if (inside && line.rfind("AnonHugePages:", 0) == 0)
+                    total += std::stoull(line.substr(14)) * 1024;
+            }
+#endif
+            return total;
+        }
+    };
+
+    // the arena of the process, mapped on first use and unmapped at exit
+    inline Arena &global()
+    {
+        static Arena a;
+        return a;
+    }
+
+    // STL allocator over global(); deallocate() does nothing
+    template <class T>
+    struct Allocator
+    {
+        using value_type = T;
+
+        Allocator() = default;
+        template <class U>
+        Allocator(const Allocator<U> &) {}
+
+        T *allocate(std::size_t n) { return global().allocate<T>(n); }
+        void deallocate(T *, std::size_t) {}
+
+        template <class U>
+        bool operator==(const Allocator<U> &) const { return true; }
+        template <class U>
+        bool operator!=(const Allocator<U> &) const { return false; }
+    };
+
+    template <class T>
+    using vector = std::vector<T, Allocator<T>>;
+}
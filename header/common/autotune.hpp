@@ -0,0 +1,277 @@
+#pragma once
+
+#include "checkpoint.hpp"
+#include "config.hpp"
+#include "display.hpp"
+#include "types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Startup calibration of thread count, chunk size and kernel.
+ *
+ * tune() spends about `budget_s` seconds measuring the workload and keeps the fastest setup:
+ *   1. each candidate kernel runs alone on one thread; the fastest samples/s wins;
+ *   2. that kernel runs on every candidate thread count (all usable CPUs, one per physical
+ *      core when SMT is present, and one fewer than all) and the best total samples/s wins,
+ *      fewer threads on a near tie (within 3%);
+ *   3. the chunk (samples a worker takes at a time) is the smallest power of two that keeps
+ *      a thread busy for CHUNK_SECONDS, which keeps the scheduling overhead negligible and the
+ *      tail of every work item short.
+ *
+ * Usable CPUs honour the affinity mask and cgroup quotas (config::availableCpus()). The
+ * decision is cached in <folder>/autotune_<machine hash>.ckpt, keyed by the machine (host, CPU
+ * model, usable CPUs, compiler and SIMD flags) and the caller's workload fingerprint, so a
+ * rerun on the same node skips the calibration.
+ *
+ * Example:
+ *   std::vector<autotune::Kernel> kernels = {{"scalar", run_scalar}, {"lanes16", run_lanes}};
+ *   const autotune::Decision d = autotune::tune(workload, kernels);
+ *   d.apply(samples_config);
+ */
+namespace autotune
+{
+    constexpr double CHUNK_SECONDS = 2e-3;
+
+    // runs `samples` samples on the calling thread and returns anything (keeps the work alive)
+    struct Kernel
+    {
+        std::string name;
+        std::function<u64(u64 samples)> run;
+    };
+
+    struct Topology
+    {
+        unsigned cpus = 1;  // usable logical CPUs
+        unsigned cores = 1; // physical cores among them
+    };
+
+    struct Decision
+    {
+        size_t threads = 1;
+        u64 chunk = 1;
+        size_t kernel = 0;
+        std::string kernel_name;
+        bool smt = false;    // more threads than physical cores
+        double rate = 0.0;   // samples/s over all threads
+        bool cached = false; // read from the cache instead of measured
+
+        // seconds for `samples` samples at the measured rate
+        double predictSeconds(u64 samples) const
+        {
+            return rate > 0.0 ? static_cast<double>(samples) / rate : 0.0;
+        }
+
+        std::string describe() const
+        {
+            std::ostringstream s;
+            s << threads << " threads" << (smt ? " (SMT)" : "") << ", chunk " << display::formatCountPow2Pow10(chunk)
+              << ", kernel " << kernel_name << ", " << std::scientific << std::setprecision(3) << rate
+              << " samples/s" << (cached ? " [cached]" : " [measured]");
+            return s.str();
+        }
+
+        void apply(config::SamplesInfo &samples) const
+        {
+            samples.max_num_threads = threads;
+            samples.tuning = describe();
+        }
+    };
+
+    inline Topology topology()
+    {
+        Topology t;
+        t.cpus = config::availableCpus();
+        t.cores = t.cpus;
+#ifdef __linux__
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) != 0)
+            return t;
+        std::set<std::string> cores;
+        for (int c{0}; c < CPU_SETSIZE; ++c)
+        {
+            if (!CPU_ISSET(c, &set))
+                continue;
+            std::ifstream f("/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/thread_siblings_list");
+            std::string siblings;
+            if (!(f >> siblings))
+                return t;
+            cores.insert(siblings);
+        }
+        // a quota below the core count caps both
+        t.cores = std::min<unsigned>(t.cpus, std::max<size_t>(1, cores.size()));
+#endif
+        return t;
+    }
+
+    // host, CPU model, usable CPUs, compiler and SIMD level: what a cached decision depends on
+    inline std::string machineFingerprint(const Topology &t)
+    {
+        std::ostringstream fp;
+#ifdef __linux__
+        char host[256] = {};
+        if (::gethostname(host, sizeof(host) - 1) == 0)
+            fp << host;
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line))
+            if (line.rfind("model name", 0) == 0)
+            {
+                fp << " " << line.substr(line.find(':') + 2);
+                break;
+            }
+#endif
+        fp << " cpus" << t.cpus << " cores" << t.cores << " gcc" << __VERSION__;
+#if defined(__AVX512F__)
+        fp << " avx512";
+#elif defined(__AVX2__)
+        fp << " avx2";
+#endif
+        std::string s = fp.str();
+        std::replace(s.begin(), s.end(), '\n', ' ');
+        return s;
+    }
+
+    // samples/s of `threads` threads running kernel k for about `seconds`
+    inline double measure(const Kernel &k, size_t threads, u64 probe, double seconds)
+    {
+        using clock = std::chrono::steady_clock;
+        std::atomic<bool> stop{false};
+        std::atomic<u64> done{0};
+
+        auto worker = [&]
+        {
+            u64 sink = 0, n = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                sink += k.run(probe);
+                n += probe;
+            }
+            done.fetch_add(n, std::memory_order_relaxed);
+            return sink;
+        };
+
+        const auto t0 = clock::now();
+        std::vector<std::future<u64>> futures;
+        for (size_t t{0}; t < threads; ++t)
+            futures.emplace_back(std::async(std::launch::async, worker));
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        stop.store(true, std::memory_order_relaxed);
+        for (auto &f : futures)
+            f.get();
+        const double elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+        return static_cast<double>(done.load()) / elapsed;
+    }
+
+    // samples per call that take about `seconds` on one thread (at least 1)
+    inline u64 probeSize(const Kernel &k, double seconds)
+    {
+        using clock = std::chrono::steady_clock;
+        u64 n = 1;
+        for (;;)
+        {
+            const auto t0 = clock::now();
+            k.run(n);
+            const double s = std::chrono::duration<double>(clock::now() - t0).count();
+            if (s >= seconds || n >= (1ULL << 24))
+                return std::max<u64>(1, static_cast<u64>(n * seconds / std::max(s, 1e-9)));
+            n *= 4;
+        }
+    }
+
+    inline Decision tune(const std::string &workload, const std::vector<Kernel> &kernels,
+                         const std::string &folder = "cache", bool use_cache = true, double budget_s = 0.3)
+    {
+        if (kernels.empty())
+            throw std::invalid_argument("autotune::tune: no kernel to measure");
+
+        const Topology topo = topology();
+        const std::string machine = machineFingerprint(topo);
+        std::ostringstream file;
+        file << folder << "/autotune_" << std::hex << checkpoint::fnv1a64(machine) << ".ckpt";
+        const std::string fingerprint = machine + " | " + workload;
+
+        Decision d;
+        checkpoint::Record rec;
+        if (use_cache && checkpoint::load(file.str(), rec) && rec.fingerprint == fingerprint &&
+            rec.get("kernel") < kernels.size() && rec.get("threads") > 0)
+        {
+            d.threads = rec.get("threads");
+            d.chunk = std::max<u64>(1, rec.get("chunk"));
+            d.kernel = rec.get("kernel");
+            d.kernel_name = kernels[d.kernel].name;
+            d.smt = rec.get("smt") != 0;
+            d.rate = static_cast<double>(rec.get("rate"));
+            d.cached = true;
+            return d;
+        }
+
+        // ---------------- 1. kernel, one thread -----------------
+        std::vector<size_t> counts = {topo.cpus, topo.cores, std::max(1u, topo.cpus - 1)};
+        std::sort(counts.begin(), counts.end());
+        counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+
+        const double slice = budget_s / static_cast<double>(kernels.size() + counts.size());
+        std::vector<u64> probes(kernels.size());
+        double best_single = 0.0;
+        for (size_t k{0}; k < kernels.size(); ++k)
+        {
+            probes[k] = probeSize(kernels[k], slice / 20);
+            const double r = measure(kernels[k], 1, probes[k], slice);
+            if (r > best_single)
+            {
+                best_single = r;
+                d.kernel = k;
+            }
+        }
+        d.kernel_name = kernels[d.kernel].name;
+
+        // ---------------- 2. thread count (and so SMT), best kernel -----------------
+        d.rate = 0.0;
+        for (size_t n : counts)
+        {
+            const double r = (n == 1) ? best_single : measure(kernels[d.kernel], n, probes[d.kernel], slice);
+            if (r > d.rate * 1.03)
+            {
+                d.rate = r;
+                d.threads = n;
+            }
+        }
+        d.smt = d.threads > topo.cores;
+
+        // ---------------- 3. chunk from the per-thread rate -----------------
+        const double per_thread = d.rate / static_cast<double>(d.threads);
+        d.chunk = 1;
+        while (d.chunk < (1ULL << 24) && static_cast<double>(d.chunk) < per_thread * CHUNK_SECONDS)
+            d.chunk <<= 1;
+
+        if (use_cache)
+        {
+            rec = checkpoint::Record{};
+            rec.fingerprint = fingerprint;
+            rec.set("threads", d.threads);
+            rec.set("chunk", d.chunk);
+            rec.set("kernel", d.kernel);
+            rec.set("smt", d.smt);
+            rec.set("rate", static_cast<u64>(std::llround(d.rate)));
+            checkpoint::save(file.str(), rec); // a failed save only costs the next run a calibration
+        }
+        return d;
+    }
+}
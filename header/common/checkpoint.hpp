@@ -0,0 +1,117 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace checkpoint
+{
+    // 64-bit FNV-1a, enough to tell two run configurations apart
+    inline u64 fnv1a64(const std::string &s, u64 h = 0xcbf29ce484222325ULL)
+    {
+        for (unsigned char c : s)
+        {
+            h ^= c;
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    /**
+     * Plain-text checkpoint of a long run.
+     *
+     * File layout (one entry per line):
+     *   fingerprint <text describing the run configuration>
+     *   <name> <u64 value>
+     *   ...
+     *
+     * A checkpoint is only reused when its fingerprint matches the current run.
+     */
+    struct Record
+    {
+        std::string fingerprint;
+        std::vector<std::pair<std::string, u64>> values;
+
+        u64 get(const std::string &name, u64 fallback = 0) const
+        {
+            for (const auto &[k, v] : values)
+                if (k == name)
+                    return v;
+            return fallback;
+        }
+
+        void set(const std::string &name, u64 value)
+        {
+            for (auto &[k, v] : values)
+            {
+                if (k == name)
+                {
+                    v = value;
+                    return;
+                }
+            }
+            values.emplace_back(name, value);
+        }
+    };
+
+    // Returns false if the file is missing, unreadable or malformed.
+    inline bool load(const std::string &path, Record &rec)
+    {
+        std::ifstream in(path);
+        if (!in.is_open())
+            return false;
+
+        std::string line;
+        if (!std::getline(in, line) || line.rfind("fingerprint ", 0) != 0)
+            return false;
+
+        rec.fingerprint = line.substr(12);
+        rec.values.clear();
+
+        while (std::getline(in, line))
+        {
+            std::istringstream iss(line);
+            std::string name;
+            u64 value;
+            if (!(iss >> name >> value))
+                return false;
+            rec.values.emplace_back(name, value);
+        }
+        return true;
+    }
+
+    // Writes to "<path>.tmp" and renames, so a crash never leaves a half-written checkpoint.
+    inline bool save(const std::string &path, const Record &rec)
+    {
+        namespace fs = std::filesystem;
+
+        const fs::path p(path);
+        if (p.has_parent_path())
+            fs::create_directories(p.parent_path());
+
+        const std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out.is_open())
+                return false;
+
+            out << "fingerprint " << rec.fingerprint << "\n";
+            for (const auto &[k, v] : rec.values)
+                out << k << " " << v << "\n";
+
+            out.flush();
+            if (!out)
+                return false;
+        }
+
+        std::error_code ec;
+        fs::rename(tmp, path, ec);
+        return !ec;
+    }
+}
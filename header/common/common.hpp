@@ -12,7 +12,27 @@
 #include "ops.hpp"
 // Formatting + info printers (display namespace).
 #include "display.hpp"
+// Cycle-counter reads (cycles namespace).
+#include "cycles.hpp"
+// Per-phase cycle accounting (PNB_PHASE_* macros, -DPNB_PHASE_TIMING).
+#include "phasetiming.hpp"
 // Timer class (wall time banner).
 #include "timer.hpp"
+// Linux perf_event_open counters (perfcounters namespace).
+#include "perfcounters.hpp"
+// RAPL energy counters (energy namespace).
+#include "energy.hpp"
 // Spinner/progress UI.
 #include "progress.hpp"
+// JSON-lines progress events to a file or FIFO (progressstream namespace).
+#include "progressstream.hpp"
+// Bias estimates + confidence intervals (stats namespace).
+#include "stats.hpp"
+// Fingerprinted plain-text checkpoints (checkpoint namespace).
+#include "checkpoint.hpp"
+// Huge-page arena for large long-lived arrays (arena namespace).
+#include "arena.hpp"
+// Lock-free single-producer / single-consumer ring (spsc namespace).
+#include "spsc.hpp"
+// Startup calibration of threads / chunk / kernel (autotune namespace).
+#include "autotune.hpp"
@@ -2,9 +2,12 @@
 
 #include "types.hpp"
 
+#include <algorithm>
 #include <bitset>
 #include <cmath>
 #include <cstddef>
+#include <cstdlib>
+#include <fstream>
 #include <limits>
 #include <string>
 #include <thread>
@@ -12,8 +15,66 @@
 #include <utility>
 #include <vector>
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 namespace config
 {
+    // CPUs this process may use: the affinity mask, capped by a cgroup CPU quota (v2 cpu.max,
+    // v1 cpu.cfs_quota_us / cpu.cfs_period_us, rounded up). hardware_concurrency() sees neither.
+    inline unsigned availableCpus()
+    {
+        unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+#ifdef __linux__
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            cpus = std::max(1, CPU_COUNT(&set));
+
+        auto cap = [&](double quota, double period)
+        {
+            if (quota > 0 && period > 0)
+                cpus = std::min(cpus, std::max(1u, static_cast<unsigned>(std::ceil(quota / period))));
+        };
+
+        // own cgroup first (v2 "0::/path"), then the root a container sees as its own
+        std::string path;
+        {
+            std::ifstream cg("/proc/self/cgroup");
+            std::string line;
+            while (std::getline(cg, line))
+                if (line.rfind("0::", 0) == 0)
+                    path = line.substr(3);
+        }
+        for (const std::string &dir : {"/sys/fs/cgroup" + path, std::string("/sys/fs/cgroup")})
+        {
+            std::ifstream f(dir + "/cpu.max");
+            std::string quota;
+            double period = 0;
+            if (f >> quota >> period)
+            {
+                // runs during static initialisation, so an odd token is ignored, never thrown
+                char *end = nullptr;
+                const double q = std::strtod(quota.c_str(), &end);
+                if (quota != "max" && end != quota.c_str() && *end == '\0')
+                    cap(q, period);
+                break;
+            }
+        }
+        for (const char *dir : {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"})
+        {
+            std::ifstream q(std::string(dir) + "/cpu.cfs_quota_us"), p(std::string(dir) + "/cpu.cfs_period_us");
+            double quota = 0, period = 0;
+            if (q >> quota && p >> period)
+            {
+                cap(quota, period);
+                break;
+            }
+        }
+#endif
+        return cpus;
+    }
+
     enum class RoundGranularity : u8
     {
         Full = 1,
@@ -144,10 +205,13 @@ namespace config
         // Number of threads to actually use
         std::size_t max_num_threads = []()
         {
-            unsigned hw = std::thread::hardware_concurrency();
+            unsigned hw = availableCpus();
             return hw > 1 ? hw - 1 : 1; // leave 1 core free
         }();
 
+        // how max_num_threads etc. were chosen when autotune::tune() set them (shown by showInfo)
+        std::string tuning;
+
         // Compiler information
         std::string compiler_info = __VERSION__;
         std::string cpp_standard =
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <chrono>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief Cheap cycle-counter reads for benchmarks and phase timing.
+ *
+ * On x86 this is the TSC: it ticks at a constant reference rate, not at the current core
+ * clock, so "cycles" here are reference cycles. ticksPerSecond() calibrates that rate once
+ * against steady_clock. Elsewhere the counter falls back to steady_clock nanoseconds.
+ *
+ * Example:
+ *   const u64 t0 = cycles::now();
+ *   // ... work ...
+ *   const u64 ticks = cycles::now() - t0;
+ */
+namespace cycles
+{
+    /// Current counter value (not serialising: a few cycles, may be reordered slightly).
+    inline u64 now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now().time_since_epoch())
+                                    .count());
+#endif
+    }
+
+    /// Counter value after all earlier instructions have completed (start/stop of a measurement).
+    inline u64 fenced()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_lfence();
+        const u64 t = __rdtsc();
+        _mm_lfence();
+        return t;
+#else
+        return now();
+#endif
+    }
+
+    /// Counter ticks per second, measured once over ~50 ms.
+    inline double ticksPerSecond()
+    {
+        static const double rate = []
+        {
+            using clock = std::chrono::steady_clock;
+            const auto w0 = clock::now();
+            const u64 t0 = fenced();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            const auto w1 = clock::now();
+            const u64 t1 = fenced();
+            const double s = std::chrono::duration<double>(w1 - w0).count();
+            return static_cast<double>(t1 - t0) / s;
+        }();
+        return rate;
+    }
+
+    /// Keep the compiler from dropping or hoisting work whose result is only in memory at `p`.
+    inline void keep(const void *p)
+    {
+        asm volatile("" : : "r"(p) : "memory");
+    }
+}
@@ -538,6 +538,8 @@ namespace display
             F("C++ standard", samples->cpp_standard);
 
             F("# of threads", samples->max_num_threads);
+            if (!samples->tuning.empty())
+                F("Autotune", samples->tuning);
 
             if (samples->samples_per_thread)
                 F("Samples per thread", formatCountPow2Pow10(samples->samples_per_thread));
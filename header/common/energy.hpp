@@ -0,0 +1,289 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Energy of a run from the Linux powercap / RAPL counters.
+ *
+ * Reads energy_uj of every package domain (intel-rapl:N, name "package-N"; AMD CPUs use the
+ * same interface) and of their DRAM subdomains (intel-rapl:N:M, name "dram"). The counters
+ * are cumulative microjoules that wrap at max_energy_range_uj (about 262 kJ, i.e. roughly
+ * 20 min at 200 W). delta() accounts for at most one wrap between two readings, so anything
+ * longer than a few minutes is measured with a Meter, which polls the counters from a
+ * background thread and adds up the deltas.
+ *
+ * RAPL covers the whole package, so other load on the machine is included. Without RAPL
+ * (VMs, non-x86) or when energy_uj is root-only (Linux >= 5.10 default), available() is
+ * false, status() says why, and every reading is empty.
+ *
+ * Example:
+ *   energy::Rapl rapl;
+ *   energy::Meter meter(rapl);
+ *   const energy::Joules j0 = meter.total();
+ *   // ... work, minutes or days ...
+ *   stages.push_back({"stage", samples, meter.total() - j0});
+ *   std::cout << energy::report(stages, rapl);
+ */
+namespace energy
+{
+    struct Domain
+    {
+        std::string name; // package-0, dram, ...
+        std::string file; // .../energy_uj
+        bool dram = false;
+        double range_uj = 0.0; // wrap-around point
+    };
+
+    struct Reading
+    {
+        std::vector<double> uj; // one per domain
+        std::chrono::steady_clock::time_point at = std::chrono::steady_clock::now();
+    };
+
+    // energy between two readings
+    struct Joules
+    {
+        double package = 0.0;
+        double dram = 0.0;
+        double seconds = 0.0;
+
+        Joules &operator+=(const Joules &o)
+        {
+            package += o.package;
+            dram += o.dram;
+            seconds += o.seconds;
+            return *this;
+        }
+
+        Joules operator-(const Joules &o) const { return {package - o.package, dram - o.dram, seconds - o.seconds}; }
+    };
+
+    class Rapl
+    {
+    public:
+        explicit Rapl(const std::string &root = "/sys/class/powercap")
+        {
+            namespace fs = std::filesystem;
+            std::error_code ec;
+            if (!fs::is_directory(root, ec))
+            {
+                status_ = "no " + root + " (no RAPL on this machine or VM)";
+                return;
+            }
+
+            std::vector<fs::path> zones;
+            for (const auto &e : fs::directory_iterator(root, ec))
+                if (e.path().filename().string().rfind("intel-rapl:", 0) == 0)
+                    zones.push_back(e.path());
+            std::sort(zones.begin(), zones.end());
+
+            for (const fs::path &z : zones)
+            {
+                std::string name;
+                std::ifstream(z / "name") >> name;
+                const bool package = name.rfind("package", 0) == 0;
+                const bool dram = name == "dram";
+                if (!package && !dram)
+                    continue;
+
+                Domain d;
+                d.name = name;
+                d.file = (z / "energy_uj").string();
+                d.dram = dram;
+                std::ifstream(z / "max_energy_range_uj") >> d.range_uj;
+
+                double probe = 0.0;
+                if (!(std::ifstream(d.file) >> probe))
+                {
+                    status_ = d.file + " is not readable (root only since Linux 5.10)";
+                    domains_.clear();
+                    return;
+                }
+                domains_.push_back(d);
+            }
+
+            status_ = domains_.empty() ? "no package domain under " + root : "";
+        }
+
+        bool available() const { return !domains_.empty(); }
+
+        // why the counters are unavailable ("" when they are available)
+        const std::string &status() const { return status_; }
+
+        const std::vector<Domain> &domains() const { return domains_; }
+
+        bool hasDram() const
+        {
+            for (const Domain &d : domains_)
+                if (d.dram)
+                    return true;
+            return false;
+        }
+
+        Reading read() const
+        {
+            Reading r;
+            r.uj.reserve(domains_.size());
+            for (const Domain &d : domains_)
+            {
+                double v = 0.0;
+                std::ifstream(d.file) >> v;
+                r.uj.push_back(v);
+            }
+            r.at = std::chrono::steady_clock::now();
+            return r;
+        }
+
+        Joules delta(const Reading &a, const Reading &b) const
+        {
+            Joules j;
+            j.seconds = std::chrono::duration<double>(b.at - a.at).count();
+            for (size_t i{0}; i < domains_.size() && i < a.uj.size() && i < b.uj.size(); ++i)
+            {
+                double d = b.uj[i] - a.uj[i];
+                if (d < 0.0)
+                    d += domains_[i].range_uj;
+                (domains_[i].dram ? j.dram : j.package) += d * 1e-6;
+            }
+            return j;
+        }
+
+    private:
+        std::vector<Domain> domains_;
+        std::string status_;
+    };
+
+    /**
+     * Energy since construction. A background thread reads the counters every `period`, well
+     * inside the wrap interval, and adds up the deltas, so the total stays exact over runs of
+     * any length. total() also takes a fresh reading. Everything is zero without RAPL.
+     */
+    class Meter
+    {
+    public:
+        explicit Meter(const Rapl &rapl, std::chrono::milliseconds period = std::chrono::seconds(10))
+            : rapl_(rapl), period_(period)
+        {
+            if (!rapl_.available())
+                return;
+            last_ = rapl_.read();
+            poller_ = std::thread([this]
+                                  { poll(); });
+        }
+
+        ~Meter()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.notify_all();
+            if (poller_.joinable())
+                poller_.join();
+        }
+
+        Meter(const Meter &) = delete;
+        Meter &operator=(const Meter &) = delete;
+
+        Joules total()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            advance();
+            return total_;
+        }
+
+    private:
+        const Rapl &rapl_;
+        std::chrono::milliseconds period_;
+        Reading last_;
+        Joules total_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        bool stop_ = false;
+        std::thread poller_;
+
+        // with mutex_ held
+        void advance()
+        {
+            if (!rapl_.available())
+                return;
+            Reading now = rapl_.read();
+            total_ += rapl_.delta(last_, now);
+            last_ = std::move(now);
+        }
+
+        void poll()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!wake_.wait_for(lock, period_, [this]
+                                   { return stop_; }))
+                advance();
+        }
+    };
+
+    // energy of one stage of a run and the samples it processed
+    struct Stage
+    {
+        std::string name;
+        u64 samples = 0;
+        Joules joules;
+    };
+
+    /**
+     * One row per stage and a total row: seconds, package and DRAM joules, average watts and
+     * samples per joule (package + DRAM). One line when RAPL is unavailable.
+     */
+    inline std::string report(const std::vector<Stage> &stages, const Rapl &rapl)
+    {
+        std::ostringstream ss;
+        if (!rapl.available())
+        {
+            ss << "Energy: unavailable, " << rapl.status() << "\n";
+            return ss.str();
+        }
+
+        auto row = [&](const std::string &name, u64 samples, const Joules &j)
+        {
+            const double total = j.package + j.dram;
+            ss << std::left << std::setw(14) << name << std::right << std::setw(12) << samples << std::fixed
+               << std::setprecision(2) << std::setw(10) << j.seconds << std::setw(12) << j.package;
+            if (rapl.hasDram())
+                ss << std::setw(10) << j.dram;
+            else
+                ss << std::setw(10) << "-";
+            ss << std::setprecision(1) << std::setw(9) << (j.seconds > 0 ? total / j.seconds : 0.0)
+               << std::scientific << std::setprecision(3) << std::setw(14)
+               << (total > 0 ? static_cast<double>(samples) / total : 0.0) << "\n";
+        };
+
+        ss << "Energy (RAPL, whole package):\n";
+        ss << std::left << std::setw(14) << "stage" << std::right << std::setw(12) << "samples" << std::setw(10)
+           << "seconds" << std::setw(12) << "package J" << std::setw(10) << "DRAM J" << std::setw(9) << "W"
+           << std::setw(14) << "samples/J" << "\n";
+
+        Joules total;
+        u64 total_samples = 0;
+        for (const Stage &s : stages)
+        {
+            row(s.name, s.samples, s.joules);
+            total += s.joules;
+            total_samples += s.samples;
+        }
+        if (stages.size() > 1)
+            row("total", total_samples, total);
+        return ss.str();
+    }
+}
@@ -387,6 +387,48 @@ namespace ops
         return oss.str();
     }
 
+    // Removes a leading 0x / 0X / 0b / 0B.
+    inline std::string stripBitPrefix(std::string s)
+    {
+        if (s.size() >= 2 &&
+            (s.rfind("0x", 0) == 0 || s.rfind("0X", 0) == 0 ||
+             s.rfind("0b", 0) == 0 || s.rfind("0B", 0) == 0))
+        {
+            s = s.substr(2);
+        }
+        return s;
+    }
+
+    // Hex digits -> '0'/'1' characters (MSB first); a wildcard nibble becomes 4 wildcard bits.
+    inline std::string expandWildcardHex(const std::string &hex, char wildcard = '*')
+    {
+        std::string bin;
+        bin.reserve(hex.size() * 4);
+
+        for (char c : hex)
+        {
+            if (c == wildcard)
+            {
+                bin.append(4, wildcard);
+                continue;
+            }
+
+            unsigned v;
+            if (c >= '0' && c <= '9')
+                v = c - '0';
+            else if (c >= 'a' && c <= 'f')
+                v = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                v = c - 'A' + 10;
+            else
+                throw std::runtime_error("Invalid hex character in pattern");
+
+            for (int b = 3; b >= 0; --b)
+                bin.push_back(((v >> b) & 1) ? '1' : '0');
+        }
+        return bin;
+    }
+
     /**
      * matchBitsWithWildcard<N>
      *
@@ -399,6 +441,8 @@ namespace ops
      *   - Binary patterns: wildcard stays single-bit
      *   - Strict length enforcement after conversion (must be exactly N bits)
      *
+     * Parses both strings on every call; inside a sample loop use WildcardPattern.
+     *
      * Example:
      *     matchBitsWithWildcard<128>("0xdeadbeef...", "0x****beef...", '*');
      *     matchBitsWithWildcard<256>("0b1010...", "0b10*0...", '*');
@@ -408,62 +452,19 @@ namespace ops
                                const std::string &pat,
                                char wildcard = '*')
     {
-        std::string d = diff;
-        std::string p = pat;
-
         // Check if hex mode is needed
         bool hex_mode =
-            (d.rfind("0x", 0) == 0 || d.rfind("0X", 0) == 0) ||
-            (p.rfind("0x", 0) == 0 || p.rfind("0X", 0) == 0);
-
-        // Remove 0x/0b prefix if present
-        auto strip_prefix = [](std::string &s)
-        {
-            if (s.size() >= 2 &&
-                (s.rfind("0x", 0) == 0 || s.rfind("0X", 0) == 0 ||
-                 s.rfind("0b", 0) == 0 || s.rfind("0B", 0) == 0))
-            {
-                s = s.substr(2);
-            }
-        };
+            (diff.rfind("0x", 0) == 0 || diff.rfind("0X", 0) == 0) ||
+            (pat.rfind("0x", 0) == 0 || pat.rfind("0X", 0) == 0);
 
-        strip_prefix(d);
-        strip_prefix(p);
+        std::string d = stripBitPrefix(diff);
+        std::string p = stripBitPrefix(pat);
 
         // Convert hex → binary; propagate wildcard nibble → 4 wildcard bits
         if (hex_mode)
         {
-            auto hexToBin = [wildcard](const std::string &hex)
-            {
-                std::string bin;
-                bin.reserve(hex.size() * 4);
-
-                for (char c : hex)
-                {
-                    if (c == wildcard)
-                    {
-                        bin.append(4, wildcard);
-                        continue;
-                    }
-
-                    unsigned v;
-                    if (c >= '0' && c <= '9')
-                        v = c - '0';
-                    else if (c >= 'a' && c <= 'f')
-                        v = c - 'a' + 10;
-                    else if (c >= 'A' && c <= 'F')
-                        v = c - 'A' + 10;
-                    else
-                        throw std::runtime_error("Invalid hex character in pattern");
-
-                    for (int b = 3; b >= 0; --b)
-                        bin.push_back(((v >> b) & 1) ? '1' : '0');
-                }
-                return bin;
-            };
-
-            d = hexToBin(d);
-            p = hexToBin(p);
+            d = expandWildcardHex(d, wildcard);
+            p = expandWildcardHex(p, wildcard);
         }
         // else: already binary (wildcards unchanged)
 
@@ -490,6 +491,78 @@ namespace ops
         return true;
     }
 
+    /**
+     * WildcardPattern<WORDS, T>
+     *
+     * A matchBitsWithWildcard() pattern compiled once into per-word (mask, value) pairs:
+     * mask has a one for every fixed bit, value holds the fixed bits. Matching a state is
+     * then WORDS XOR/AND/OR steps and one compare, with no strings involved.
+     *
+     * The pattern uses the same text format (hex or binary, optional prefix, MSB first,
+     * words concatenated from word 0) and must be exactly WORDS * bits-of-T bits long.
+     *
+     * Example:
+     *     auto p = compileWildcardPattern<16>(diff.output_diff_str);
+     *     if (p.matches(delta)) ...
+     */
+    template <std::size_t WORDS, class T = u32>
+    struct WildcardPattern
+    {
+        static_assert(std::is_unsigned_v<T>, "WildcardPattern: T must be unsigned");
+
+        T mask[WORDS] = {};
+        T value[WORDS] = {};
+
+        bool matches(const T *x) const
+        {
+            T acc = 0;
+            for (std::size_t i{0}; i < WORDS; ++i)
+                acc |= (x[i] ^ value[i]) & mask[i];
+            return acc == 0;
+        }
+
+        // number of non-wildcard bits
+        std::size_t fixedBits() const
+        {
+            std::size_t n = 0;
+            for (std::size_t i{0}; i < WORDS; ++i)
+                n += static_cast<std::size_t>(std::popcount(mask[i]));
+            return n;
+        }
+    };
+
+    template <std::size_t WORDS, class T = u32>
+    WildcardPattern<WORDS, T> compileWildcardPattern(const std::string &pat, char wildcard = '*')
+    {
+        constexpr std::size_t BITS = sizeof(T) * 8;
+
+        const bool hex_mode = (pat.rfind("0x", 0) == 0 || pat.rfind("0X", 0) == 0);
+        std::string p = stripBitPrefix(pat);
+        if (hex_mode)
+            p = expandWildcardHex(p, wildcard);
+
+        if (p.size() != WORDS * BITS)
+            throw std::runtime_error("Pattern must be exactly " + std::to_string(WORDS * BITS) +
+                                     " bits after conversion.");
+
+        WildcardPattern<WORDS, T> out;
+        for (std::size_t i{0}; i < p.size(); ++i)
+        {
+            const char pc = p[i];
+            if (pc == wildcard)
+                continue;
+            if (pc != '0' && pc != '1')
+                throw std::runtime_error("Pattern has invalid character; allowed: 0/1/" +
+                                         std::string(1, wildcard));
+
+            const T bit = T{1} << (BITS - 1 - i % BITS);
+            out.mask[i / BITS] |= bit;
+            if (pc == '1')
+                out.value[i / BITS] |= bit;
+        }
+        return out;
+    }
+
     /**
      * hammingWeight(x)
      *
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Linux hardware performance counters of a process (perf_event_open).
+ *
+ * Counters opens one counter per event for the calling thread with `inherit` set, so every
+ * thread created afterwards (the std::async workers) is counted too; a worker's counts are
+ * added when it exits, which std::future::get() waits for. The counts are therefore process
+ * totals: the calling thread and helpers such as the spinner are included with the workers.
+ * Those mostly sleep, so the workers dominate. Only user-space events are counted, which
+ * needs perf_event_paranoid <= 2.
+ *
+ * Events the CPU or the kernel does not offer (VMs often expose no PMU) simply stay closed
+ * and are printed as "-"; the rest still work. Counts are scaled by time_enabled /
+ * time_running when the kernel had to multiplex them.
+ *
+ * Example:
+ *   perfcounters::Counters pc;
+ *   const perfcounters::Reading r0 = pc.read();
+ *   // ... launch and join the workers ...
+ *   stages.push_back({"stage", samples, pc.read() - r0});
+ *   std::cout << perfcounters::report(stages);
+ */
+namespace perfcounters
+{
+    enum Event : size_t
+    {
+        Cycles,
+        RefCycles,
+        Instructions,
+        BranchMisses,
+        L1DMisses,
+        LLCMisses,
+        TaskClock, // ns of CPU time (software event, present without a PMU)
+        EVENT_COUNT
+    };
+
+    inline constexpr std::array<const char *, EVENT_COUNT> EVENT_NAMES = {
+        "cycles", "ref-cycles", "instructions", "branch-misses", "L1D-load-misses", "LLC-load-misses", "task-clock"};
+
+    struct Reading
+    {
+        double value[EVENT_COUNT] = {};
+        bool ok[EVENT_COUNT] = {};
+
+        Reading operator-(const Reading &o) const
+        {
+            Reading d;
+            for (size_t e{0}; e < EVENT_COUNT; ++e)
+            {
+                d.ok[e] = ok[e] && o.ok[e];
+                d.value[e] = value[e] - o.value[e];
+            }
+            return d;
+        }
+
+        Reading &operator+=(const Reading &o)
+        {
+            for (size_t e{0}; e < EVENT_COUNT; ++e)
+            {
+                ok[e] = ok[e] && o.ok[e];
+                value[e] += o.value[e];
+            }
+            return *this;
+        }
+    };
+
+    class Counters
+    {
+    public:
+        Counters()
+        {
+            fd_.fill(-1);
+#ifdef __linux__
+            constexpr u64 L1D_READ_MISS = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            constexpr u64 LL_READ_MISS = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            const std::array<std::pair<u32, u64>, EVENT_COUNT> spec = {{
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                {PERF_TYPE_HW_CACHE, L1D_READ_MISS},
+                {PERF_TYPE_HW_CACHE, LL_READ_MISS},
+                {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+            }};
+
+            for (size_t e{0}; e < EVENT_COUNT; ++e)
+            {
+                perf_event_attr attr{};
+                attr.size = sizeof(attr);
+                attr.type = spec[e].first;
+                attr.config = spec[e].second;
+                attr.inherit = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                fd_[e] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            }
+#endif
+        }
+
+        ~Counters()
+        {
+#ifdef __linux__
+            for (int fd : fd_)
+                if (fd >= 0)
+                    ::close(fd);
+#endif
+        }
+
+        Counters(const Counters &) = delete;
+        Counters &operator=(const Counters &) = delete;
+
+        bool opened(Event e) const { return fd_[e] >= 0; }
+
+        // events that could not be opened, comma separated ("" when all are open)
+        std::string unavailable() const
+        {
+            std::string s;
+            for (size_t e{0}; e < EVENT_COUNT; ++e)
+                if (fd_[e] < 0)
+                    s += (s.empty() ? "" : ", ") + std::string(EVENT_NAMES[e]);
+            return s;
+        }
+
+        Reading read() const
+        {
+            Reading r;
+#ifdef __linux__
+            for (size_t e{0}; e < EVENT_COUNT; ++e)
+            {
+                u64 buf[3] = {}; // value, time_enabled, time_running
+                if (fd_[e] < 0 || ::read(fd_[e], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf)))
+                    continue;
+                r.ok[e] = true;
+                r.value[e] = (buf[2] > 0 && buf[2] < buf[1])
+                                 ? static_cast<double>(buf[0]) * static_cast<double>(buf[1]) / static_cast<double>(buf[2])
+                                 : static_cast<double>(buf[0]);
+            }
+#endif
+            return r;
+        }
+
+    private:
+        std::array<int, EVENT_COUNT> fd_;
+    };
+
+    // counts of one stage of a run and the samples it processed
+    struct Stage
+    {
+        std::string name;
+        u64 samples = 0;
+        Reading delta;
+    };
+
+    /**
+     * One row per stage and a total row: IPC, clock in GHz (cycles per task-clock ns),
+     * cycles / ref-cycles (below 1: throttled, above 1: turbo), and cycles, instructions
+     * and misses per sample. Unavailable values are printed as "-".
+     */
+    inline std::string report(const std::vector<Stage> &stages)
+    {
+        std::ostringstream ss;
+        auto cell = [&](bool ok, double v, int width, int precision)
+        {
+            if (ok && std::isfinite(v))
+                ss << std::fixed << std::setprecision(precision) << std::setw(width) << v;
+            else
+                ss << std::setw(width) << "-";
+        };
+        auto row = [&](const std::string &name, u64 samples, const Reading &d)
+        {
+            const double n = samples ? static_cast<double>(samples) : NAN;
+            ss << std::left << std::setw(14) << name << std::right << std::setw(12) << samples;
+            cell(d.ok[Cycles] && d.ok[Instructions], d.value[Instructions] / d.value[Cycles], 7, 2);
+            cell(d.ok[Cycles] && d.ok[TaskClock], d.value[Cycles] / d.value[TaskClock], 7, 2);
+            cell(d.ok[Cycles] && d.ok[RefCycles], d.value[Cycles] / d.value[RefCycles], 8, 3);
+            cell(d.ok[Cycles], d.value[Cycles] / n, 11, 1);
+            cell(d.ok[Instructions], d.value[Instructions] / n, 11, 1);
+            cell(d.ok[BranchMisses], d.value[BranchMisses] / n, 10, 3);
+            cell(d.ok[L1DMisses], d.value[L1DMisses] / n, 10, 3);
+            cell(d.ok[LLCMisses], d.value[LLCMisses] / n, 10, 4);
+            cell(d.ok[TaskClock], d.value[TaskClock] / n, 10, 1);
+            ss << "\n";
+        };
+
+        ss << "Hardware counters (user space, process totals: workers plus main and spinner threads;\n"
+              "per-sample columns divide by samples):\n";
+        ss << std::left << std::setw(14) << "stage" << std::right << std::setw(12) << "samples" << std::setw(7)
+           << "IPC" << std::setw(7) << "GHz" << std::setw(8) << "cyc/ref" << std::setw(11) << "cyc/smp"
+           << std::setw(11) << "ins/smp" << std::setw(10) << "brm/smp" << std::setw(10) << "L1m/smp"
+           << std::setw(10) << "LLCm/smp" << std::setw(10) << "ns/smp" << "\n";
+
+        Reading total;
+        std::fill(std::begin(total.ok), std::end(total.ok), true);
+        u64 total_samples = 0;
+        for (const Stage &s : stages)
+        {
+            row(s.name, s.samples, s.delta);
+            total += s.delta;
+            total_samples += s.samples;
+        }
+        if (stages.size() > 1)
+            row("total", total_samples, total);
+        return ss.str();
+    }
+}
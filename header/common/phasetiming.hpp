@@ -0,0 +1,110 @@
+#pragma once
+
+#include "cycles.hpp"
+#include "types.hpp"
+
+#include <array>
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Optional per-phase cycle accounting of the PNB sample loop.
+ *
+ * Build with -DPNB_PHASE_TIMING to enable it; otherwise every PNB_PHASE_* macro is empty
+ * and the kernels compile exactly as before.
+ *
+ * The sample path is cut into phases by marks: PNB_PHASE(p) charges the reference cycles
+ * since the previous mark of this thread to phase p, so each boundary costs one TSC read.
+ * PNB_PHASE_START() sets the starting point without charging anything. Counts are kept per
+ * thread and added to the process totals by PNB_PHASE_FLUSH() when a worker finishes;
+ * PNB_PHASE_SAMPLE() counts one finished sample. Timer::end_message() appends the table
+ * once at least one sample was counted.
+ */
+namespace phasetiming
+{
+    enum Phase : size_t
+    {
+        Setup,       // RNG, IV, key, initial state
+        Forward,     // forward rounds (and the last-round tail)
+        FeedForward, // Z = X + X^R
+        KeyFlip,     // key-bit flip, X^R with the guess, Z - X^R
+        Backward,    // backward rounds (and the undone tail)
+        Parity,      // mask parity, forward and backward
+        PHASE_COUNT
+    };
+
+    inline constexpr std::array<const char *, PHASE_COUNT> PHASE_NAMES = {
+        "sample setup / RNG", "forward rounds", "feed-forward add",
+        "key flip + subtract", "backward rounds", "parity extraction"};
+
+    struct Counters
+    {
+        u64 ticks[PHASE_COUNT] = {};
+        u64 samples = 0;
+    };
+
+    inline thread_local Counters local;
+    inline thread_local u64 last_mark = 0;
+
+    inline std::array<std::atomic<u64>, PHASE_COUNT> total_ticks{};
+    inline std::atomic<u64> total_samples{0};
+
+    inline void start() { last_mark = cycles::now(); }
+
+    inline void mark(Phase p)
+    {
+        const u64 t = cycles::now();
+        local.ticks[p] += t - last_mark;
+        last_mark = t;
+    }
+
+    // adds this thread's counts to the totals and clears them
+    inline void flush()
+    {
+        for (size_t p{0}; p < PHASE_COUNT; ++p)
+            total_ticks[p].fetch_add(local.ticks[p], std::memory_order_relaxed);
+        total_samples.fetch_add(local.samples, std::memory_order_relaxed);
+        local = Counters{};
+    }
+
+    // cycles per sample and share of each phase; empty when nothing was counted
+    inline std::string report()
+    {
+        const u64 samples = total_samples.load(std::memory_order_relaxed);
+        if (samples == 0)
+            return {};
+
+        u64 sum = 0;
+        for (size_t p{0}; p < PHASE_COUNT; ++p)
+            sum += total_ticks[p].load(std::memory_order_relaxed);
+
+        std::ostringstream ss;
+        ss << "Phase breakdown (reference cycles, " << samples << " samples):\n";
+        ss << std::left << std::setw(24) << "  phase" << std::right << std::setw(16) << "cycles/sample"
+           << std::setw(10) << "share" << "\n";
+        ss << std::fixed;
+        for (size_t p{0}; p < PHASE_COUNT; ++p)
+        {
+            const double t = static_cast<double>(total_ticks[p].load(std::memory_order_relaxed));
+            ss << "  " << std::left << std::setw(22) << PHASE_NAMES[p] << std::right << std::setprecision(1)
+               << std::setw(16) << t / samples << std::setw(9) << (sum ? 100.0 * t / sum : 0.0) << "%\n";
+        }
+        ss << "  " << std::left << std::setw(22) << "total" << std::right << std::setprecision(1)
+           << std::setw(16) << static_cast<double>(sum) / samples << std::setw(9) << 100.0 << "%\n";
+        return ss.str();
+    }
+}
+
+#ifdef PNB_PHASE_TIMING
+#define PNB_PHASE_START() phasetiming::start()
+#define PNB_PHASE(p) phasetiming::mark(phasetiming::p)
+#define PNB_PHASE_SAMPLE() (++phasetiming::local.samples)
+#define PNB_PHASE_FLUSH() phasetiming::flush()
+#else
+#define PNB_PHASE_START() ((void)0)
+#define PNB_PHASE(p) ((void)0)
+#define PNB_PHASE_SAMPLE() ((void)0)
+#define PNB_PHASE_FLUSH() ((void)0)
+#endif
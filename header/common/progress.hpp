@@ -10,11 +10,59 @@
 #include <cstdio>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include <unistd.h>
+
+/**
+ * @brief Samples done per worker, one counter per cache line.
+ *
+ * Each worker adds to its own slot only, so the hot loop never shares a cache line with
+ * another thread and the add is a plain load + store. The spinner sums the slots.
+ */
+class SampleCounters
+{
+public:
+    explicit SampleCounters(std::size_t workers = 1) { resize(workers); }
+
+    // drops the counts; call before the workers start
+    void resize(std::size_t workers)
+    {
+        count = workers ? workers : 1;
+        slots = std::make_unique<Slot[]>(count);
+    }
+
+    std::size_t workers() const { return count; }
+
+    // only worker `w` may call this for slot `w`
+    void add(std::size_t w, u64 n)
+    {
+        std::atomic<u64> &c = slots[w].n;
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    u64 total() const
+    {
+        u64 sum = 0;
+        for (std::size_t w{0}; w < count; ++w)
+            sum += slots[w].n.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<u64> n{0};
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::size_t count = 0;
+};
+
 class SpinnerWithETA
 {
 public:
@@ -38,12 +86,27 @@ public:
     }
 
     /**
-     * @brief Starts the spinner thread.
+     * @brief Shows samples/s and bases the ETA on samples instead of work items.
+     * @param counters Per-worker sample counters (see SampleCounters).
+     * @param total_samples Samples still to be computed when start() is called.
+     * @param unit Name of a work item, shown as "<done>/<total> <unit>".
+     */
+    void trackSamples(const SampleCounters *counters, u64 total_samples, std::string unit = "items")
+    {
+        samples = counters;
+        samples_total = total_samples;
+        work_unit = std::move(unit);
+    }
+
+    /**
+     * @brief Starts the spinner thread (not when stdout is a file or a pipe).
      */
     void start()
     {
         if (!done || total == 0)
             return; // nothing to track, silently do nothing
+        if (!::isatty(STDOUT_FILENO))
+            return; // batch job: no carriage returns or ANSI codes in the output
 
         running = true;
         start_time = std::chrono::steady_clock::now();
@@ -57,8 +120,9 @@ public:
     void stop()
     {
         running = false;
-        if (th.joinable())
-            th.join();
+        if (!th.joinable())
+            return;
+        th.join();
 
         // REVISED CLEANUP: Clear the line with spaces, then output a new line (\n)
         // to ensure the prompt starts on a fresh line.
@@ -83,6 +147,20 @@ private:
     std::thread th;
     std::chrono::steady_clock::time_point start_time;
 
+    const SampleCounters *samples = nullptr;
+    u64 samples_total = 0;
+    std::string work_unit;
+
+    // samples/s averaged over about this many seconds, so the ETA does not jump
+    static constexpr double RATE_SMOOTHING_S = 5.0;
+
+    static std::string format_rate(double per_second)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.3g samples/s", per_second);
+        return std::string(buf);
+    }
+
     /**
      * @brief Formats seconds into a human-readable ETA string (e.g., 01m 30s).
      */
@@ -290,6 +368,11 @@ private:
         std::size_t idx = 0;
         std::size_t last_len{0};
 
+        const u64 samples_start = samples ? samples->total() : 0;
+        u64 samples_last = samples_start;
+        auto last_tick = start_time;
+        double smoothed_rate = 0.0;
+
         while (running)
         {
             double frac = 0.0;
@@ -313,7 +396,35 @@ private:
                 line << " " << message;
 
             // 3. progress + ETA
-            if (total > 0 && done)
+            if (samples && samples_total > 0)
+            {
+                // samples: smoothed samples/s, work items done, ETA from the smoothed rate
+                const auto now = std::chrono::steady_clock::now();
+                const double dt = std::chrono::duration<double>(now - last_tick).count();
+                const u64 cur = samples->total();
+                if (dt > 0.0)
+                {
+                    const double rate = static_cast<double>(cur - samples_last) / dt;
+                    const double elapsed = std::chrono::duration<double>(now - start_time).count();
+                    // plain average until one smoothing period has passed, exponential after
+                    const double alpha = (elapsed <= RATE_SMOOTHING_S) ? dt / std::max(elapsed, dt)
+                                                                       : 1.0 - std::exp(-dt / RATE_SMOOTHING_S);
+                    smoothed_rate += alpha * (rate - smoothed_rate);
+                }
+                samples_last = cur;
+                last_tick = now;
+
+                const u64 computed = std::min(cur - samples_start, samples_total);
+                frac = static_cast<double>(computed) / static_cast<double>(samples_total);
+                if (smoothed_rate > 0.0)
+                    eta_sec = static_cast<double>(samples_total - computed) / smoothed_rate;
+
+                const u64 items = std::min(done->load(std::memory_order_relaxed), total);
+                int pct = static_cast<int>(frac * 100.0 + 0.5);
+                line << " [" << pct << "%]  " << items << "/" << total << " " << work_unit << "  "
+                     << format_rate(smoothed_rate) << "  " << format_eta(eta_sec);
+            }
+            else if (total > 0 && done)
             {
                 u64 cur = done->load(std::memory_order_relaxed);
                 if (cur > total)
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Machine-readable progress: one JSON object per line, written as events happen.
+ *
+ * The target is a regular file (appended to) or a FIFO, so a batch job can be followed with
+ * `tail -f` or a reader on the FIFO instead of parsing the spinner. Every line starts with
+ * "t", the seconds since the stream was opened, and is written with one write() call, which
+ * a FIFO delivers whole for lines up to PIPE_BUF (4096) bytes.
+ *
+ * A FIFO without a reader at open time, or a reader that goes away, disables the stream;
+ * the run itself goes on. Opening a FIFO ignores SIGPIPE for the process for that reason.
+ * The descriptor stays non-blocking: when a reader stops reading and the FIFO is full, the
+ * line is dropped and counted (dropped()) instead of stalling the run.
+ *
+ * Example:
+ *   progressstream::Stream out("progress.jsonl");
+ *   out.emit(progressstream::Object().add("event", "bit").add("bit", 12).add("bias", 0.41));
+ */
+namespace progressstream
+{
+    // flat JSON object built field by field
+    class Object
+    {
+    public:
+        Object &add(const char *key, const std::string &v)
+        {
+            field(key);
+            quote(v);
+            return *this;
+        }
+
+        Object &add(const char *key, const char *v) { return add(key, std::string(v)); }
+
+        Object &add(const char *key, bool v)
+        {
+            field(key);
+            body += v ? "true" : "false";
+            return *this;
+        }
+
+        template <typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+        Object &add(const char *key, T v)
+        {
+            field(key);
+            body += std::to_string(v);
+            return *this;
+        }
+
+        // non-finite values become null
+        Object &add(const char *key, double v)
+        {
+            field(key);
+            if (!std::isfinite(v))
+            {
+                body += "null";
+                return *this;
+            }
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.9g", v);
+            body += buf;
+            return *this;
+        }
+
+        const std::string &fields() const { return body; }
+
+    private:
+        std::string body; // "k":v,"k":v without braces
+
+        void field(const char *key)
+        {
+            if (!body.empty())
+                body += ',';
+            quote(key);
+            body += ':';
+        }
+
+        void quote(const std::string &v)
+        {
+            body += '"';
+            for (char c : v)
+            {
+                if (c == '"' || c == '\\')
+                    (body += '\\') += c;
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    body += buf;
+                }
+                else
+                    body += c;
+            }
+            body += '"';
+        }
+    };
+
+    class Stream
+    {
+    public:
+        Stream() = default; // disabled
+
+        explicit Stream(const std::string &path) : path_(path), t0_(std::chrono::steady_clock::now())
+        {
+            struct stat st{};
+            const bool fifo = ::stat(path.c_str(), &st) == 0 && S_ISFIFO(st.st_mode);
+            if (fifo)
+                std::signal(SIGPIPE, SIG_IGN); // a reader that quits must not kill the run
+
+            // O_NONBLOCK: opening a FIFO without a reader fails with ENXIO instead of hanging
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_NONBLOCK | O_CLOEXEC, 0644);
+            if (fd_ < 0)
+            {
+                status_ = path + ": " + (fifo && errno == ENXIO ? std::string("FIFO has no reader") : std::strerror(errno));
+                return;
+            }
+            status_ = path + (fifo ? " (FIFO)" : "");
+        }
+
+        ~Stream()
+        {
+            if (fd_ >= 0)
+                ::close(fd_);
+        }
+
+        Stream(const Stream &) = delete;
+        Stream &operator=(const Stream &) = delete;
+
+        bool enabled() const { return fd_ >= 0; }
+
+        // the target, or why there is none
+        const std::string &status() const { return status_; }
+
+        // lines not written because a FIFO was full
+        u64 dropped() const { return dropped_; }
+
+        void emit(const Object &o)
+        {
+            if (fd_ < 0)
+                return;
+            const double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0_).count();
+            char stamp[32];
+            std::snprintf(stamp, sizeof(stamp), "{\"t\":%.3f", t);
+            std::string line = stamp;
+            if (!o.fields().empty())
+                (line += ',') += o.fields();
+            line += "}\n";
+
+            size_t off = 0;
+            while (off < line.size())
+            {
+                const ssize_t w = ::write(fd_, line.data() + off, line.size() - off);
+                if (w < 0 && errno == EINTR)
+                    continue;
+                // full FIFO: lines up to PIPE_BUF are written whole or not at all
+                if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    ++dropped_;
+                    return;
+                }
+                if (w <= 0)
+                {
+                    status_ = path_ + ": " + std::strerror(errno) + ", stream stopped";
+                    ::close(fd_);
+                    fd_ = -1;
+                    return;
+                }
+                off += static_cast<size_t>(w);
+            }
+        }
+
+    private:
+        std::string path_;
+        std::string status_ = "off";
+        int fd_ = -1;
+        u64 dropped_ = 0;
+        std::chrono::steady_clock::time_point t0_;
+    };
+}
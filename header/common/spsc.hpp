@@ -0,0 +1,92 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @brief Lock-free single-producer / single-consumer ring of preallocated slots.
+ *
+ * The producer fills a slot in place (claim(), then publish()) and the consumer reads it in
+ * place (front(), then pop()), so a slot is never copied. Each side keeps its own index on
+ * its own cache line with a cached copy of the other side's index, and only reloads that
+ * copy when the ring looks full (producer) or empty (consumer). Exactly one thread may
+ * produce and one thread may consume. The slots come from Alloc (e.g. arena::Allocator).
+ *
+ * Example:
+ *   spsc::Ring<Batch> ring(64);
+ *   // producer                          // consumer
+ *   if (Batch *b = ring.claim())         if (const Batch *b = ring.front())
+ *   { fill(*b); ring.publish(); }        { use(*b); ring.pop(); }
+ */
+namespace spsc
+{
+    template <class T, class Alloc = std::allocator<T>>
+    class Ring
+    {
+    public:
+        // depth is rounded up to a power of two
+        explicit Ring(std::size_t depth)
+        {
+            if (depth == 0)
+                throw std::invalid_argument("spsc::Ring: depth must be positive");
+            std::size_t size = 1;
+            while (size < depth)
+                size <<= 1;
+            mask_ = size - 1;
+            slots_ = std::vector<T, Alloc>(size);
+        }
+
+        Ring(const Ring &) = delete;
+        Ring &operator=(const Ring &) = delete;
+
+        std::size_t depth() const { return mask_ + 1; }
+
+        // producer: a free slot to fill, or nullptr when the ring is full
+        T *claim()
+        {
+            const u64 t = tail_.load(std::memory_order_relaxed);
+            if (t - head_cache_ > mask_)
+            {
+                head_cache_ = head_.load(std::memory_order_acquire);
+                if (t - head_cache_ > mask_)
+                    return nullptr;
+            }
+            return &slots_[t & mask_];
+        }
+
+        // producer: hands the claimed slot to the consumer
+        void publish() { tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+        // consumer: the oldest filled slot, or nullptr when the ring is empty
+        const T *front()
+        {
+            const u64 h = head_.load(std::memory_order_relaxed);
+            if (h == tail_cache_)
+            {
+                tail_cache_ = tail_.load(std::memory_order_acquire);
+                if (h == tail_cache_)
+                    return nullptr;
+            }
+            return &slots_[h & mask_];
+        }
+
+        // consumer: returns the slot from front() to the producer
+        void pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    private:
+        // consumer side
+        alignas(64) std::atomic<u64> head_{0};
+        u64 tail_cache_ = 0;
+        // producer side
+        alignas(64) std::atomic<u64> tail_{0};
+        u64 head_cache_ = 0;
+
+        alignas(64) std::size_t mask_ = 0;
+        std::vector<T, Alloc> slots_;
+    };
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cmath>
+#include <limits>
+
+namespace stats
+{
+    // z-score of the two-sided 95% normal interval, used for every bias CI we print
+    constexpr double Z95 = 1.959963984540054;
+
+    // bias of an event observed `hits` times in `n` trials: eps = 2p - 1
+    inline double biasFromCount(u64 hits, u64 n)
+    {
+        if (n == 0)
+            return 0.0;
+        return 2.0 * static_cast<double>(hits) / static_cast<double>(n) - 1.0;
+    }
+
+    // Half-width of the normal-approximation CI of biasFromCount():
+    //   SE(eps) = 2 * sqrt(p(1-p)/n)
+    inline double biasHalfWidth(u64 hits, u64 n, double z = Z95)
+    {
+        if (n == 0)
+            return std::numeric_limits<double>::infinity();
+        const double p = static_cast<double>(hits) / static_cast<double>(n);
+        return z * 2.0 * std::sqrt(p * (1.0 - p) / static_cast<double>(n));
+    }
+
+    // Bias estimate together with its confidence interval.
+    struct BiasEstimate
+    {
+        u64 hits = 0;
+        u64 n = 0;
+
+        double bias() const { return biasFromCount(hits, n); }
+        double halfWidth(double z = Z95) const { return biasHalfWidth(hits, n, z); }
+        double lower(double z = Z95) const { return bias() - halfWidth(z); }
+        double upper(double z = Z95) const { return bias() + halfWidth(z); }
+    };
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "display.hpp"
+#include "phasetiming.hpp"
 
 #include <chrono>
 #include <ctime>
@@ -71,12 +72,16 @@ public:
         return display::formatTime("Execution started");
     }
 
-    /// Pretty end banner including wall duration since start/reset.
+    /// Pretty end banner including wall duration since start/reset
+    /// (and the phase breakdown in a -DPNB_PHASE_TIMING build).
     std::string end_message() const
     {
         const long long wall_ms = elapsed_ms();
 
         std::ostringstream ss;
+#ifdef PNB_PHASE_TIMING
+        ss << phasetiming::report();
+#endif
         ss << std::left << std::setw(35) << "Wall time elapsed " << " : " << display::formatMSduration(wall_ms) << ".\n";
         ss << display::formatTime("Execution ended");
         return ss.str();
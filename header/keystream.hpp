@@ -0,0 +1,393 @@
+/*
+ * REFERENCE IMPLEMENTATION OF keystream header file
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ *
+ * Synopsis:
+ * Salsa20/R keystream generator (R = 20, 12, 8 or any reduced round count), HSalsa20 and
+ * XSalsa20. The state is set up with salsa::init_iv_const / salsa::insert_key: nonce in
+ * words 6, 7, 64-bit block counter in words 8 (low) and 9 (high), the 16-byte constants
+ * replaced by "expand 32-byte k" for 32-byte keys.
+ *
+ * Blocks are computed L at a time, one counter per lane, so 16 blocks are one AVX-512 pass
+ * and 8 one AVX2 pass. For a power-of-two L the state stays in vector registers for all
+ * rounds (salsaBlocksInRegisters); other widths use arx::laneForwardHalf. Every block is
+ * addressed by its counter, so any byte range of the stream can be produced directly.
+ *
+ * selfTest() checks the published vectors: the Salsa20 expansion examples of the
+ * specification (32- and 16-byte keys) and the HSalsa20 / XSalsa20 values of the NaCl tests.
+ */
+
+#pragma once
+#include "arx.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace keystream
+{
+    constexpr size_t BLOCK_BYTES = 64;
+    constexpr size_t KEY_BYTES = 32;
+    constexpr size_t NONCE_BYTES = 8;    // Salsa20
+    constexpr size_t HNONCE_BYTES = 16;  // HSalsa20
+    constexpr size_t XNONCE_BYTES = 24;  // XSalsa20
+
+    // "expand 32-byte k"; salsa::init_iv_const sets the 16-byte ("expand 16-byte k") words
+    constexpr u32 SIGMA_5 = 0x3320646e;
+    constexpr u32 SIGMA_10 = 0x79622d32;
+
+    // lanes of one pass for the vector width this is compiled for
+#if defined(__AVX512F__)
+    constexpr size_t NATIVE_LANES = 16;
+#elif defined(__AVX2__)
+    constexpr size_t NATIVE_LANES = 8;
+#else
+    constexpr size_t NATIVE_LANES = 4;
+#endif
+
+    inline u32 load32le(const u8 *p)
+    {
+        return static_cast<u32>(p[0]) | static_cast<u32>(p[1]) << 8 |
+               static_cast<u32>(p[2]) << 16 | static_cast<u32>(p[3]) << 24;
+    }
+
+    inline void store32le(u8 *p, u32 v)
+    {
+        if constexpr (std::endian::native == std::endian::little)
+            std::memcpy(p, &v, 4);
+        else
+        {
+            p[0] = static_cast<u8>(v);
+            p[1] = static_cast<u8>(v >> 8);
+            p[2] = static_cast<u8>(v >> 16);
+            p[3] = static_cast<u8>(v >> 24);
+        }
+    }
+
+    // constants, key (16 bytes are repeated) and the 16 bytes of words 6..9
+    inline void setupState(u32 *x, const u8 *key, size_t key_bytes, const u8 *words_6_9)
+    {
+        if (key_bytes != 16 && key_bytes != 32)
+            throw std::invalid_argument("keystream: key must be 16 or 32 bytes");
+
+        u32 k[KEYWORD_COUNT];
+        for (size_t i{0}; i < KEYWORD_COUNT; ++i)
+            k[i] = load32le(key + 4 * (i % (key_bytes / 4)));
+
+        salsa::init_iv_const(x, false);
+        salsa::insert_key(x, k);
+        if (key_bytes == 32)
+        {
+            x[5] = SIGMA_5;
+            x[10] = SIGMA_10;
+        }
+        for (size_t i{SALSA_IV_START}; i <= SALSA_IV_END; ++i)
+            x[i] = load32le(words_6_9 + 4 * (i - SALSA_IV_START));
+    }
+
+    inline void checkRounds(int rounds)
+    {
+        if (rounds < 1 || rounds > 64)
+            throw std::invalid_argument("keystream: rounds must be in [1,64]");
+    }
+
+    /**
+     * salsaBlocks() for a power-of-two L >= 2 with the state in registers: every state word is one
+     * vector of L lanes (GCC/Clang vector extension, one zmm register for L = 16 under
+     * AVX-512), and each double round is written out as eight quarter-rounds, so the rounds
+     * never touch memory.
+     */
+    template <size_t L>
+    struct LaneVector
+    {
+        typedef u32 type __attribute__((vector_size(4 * L))); // L lanes of one state word
+    };
+
+    template <size_t L>
+    inline void salsaBlocksInRegisters(const u32 *x0, u64 counter, int rounds, u8 *out)
+    {
+        using V = typename LaneVector<L>::type;
+
+        V in[STATEWORD_COUNT];
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            in[i] = V{} + x0[i];
+        for (size_t l{0}; l < L; ++l)
+        {
+            const u64 c = counter + l;
+            in[8][l] = static_cast<u32>(c);
+            in[9][l] = static_cast<u32>(c >> 32);
+        }
+
+        V x0v = in[0], x1 = in[1], x2 = in[2], x3 = in[3], x4 = in[4], x5 = in[5], x6 = in[6], x7 = in[7],
+          x8 = in[8], x9 = in[9], x10 = in[10], x11 = in[11], x12 = in[12], x13 = in[13], x14 = in[14], x15 = in[15];
+
+        // vectors only pass by reference, which keeps -Wpsabi quiet below the native width
+        auto quarter = [](V &a, V &b, V &c, V &d)
+        {
+            V t = a + d;
+            b ^= (t << 7) | (t >> 25);
+            t = b + a;
+            c ^= (t << 9) | (t >> 23);
+            t = c + b;
+            d ^= (t << 13) | (t >> 19);
+            t = d + c;
+            a ^= (t << 18) | (t >> 14);
+        };
+        auto columns = [&]
+        {
+            quarter(x0v, x4, x8, x12);
+            quarter(x5, x9, x13, x1);
+            quarter(x10, x14, x2, x6);
+            quarter(x15, x3, x7, x11);
+        };
+        auto rows = [&]
+        {
+            quarter(x0v, x1, x2, x3);
+            quarter(x5, x6, x7, x4);
+            quarter(x10, x11, x8, x9);
+            quarter(x15, x12, x13, x14);
+        };
+
+        int r{0};
+        for (; r + 2 <= rounds; r += 2)
+        {
+            columns();
+            rows();
+        }
+        if (r < rounds)
+            columns();
+
+        // feed-forward, then word-major -> block-major
+        const V x[STATEWORD_COUNT] = {x0v, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15};
+        alignas(64) u32 z[STATEWORD_COUNT][L];
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            const V v = x[i] + in[i];
+            std::memcpy(z[i], &v, sizeof(v));
+        }
+        for (size_t l{0}; l < L; ++l)
+            for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+                store32le(out + l * BLOCK_BYTES + 4 * i, z[i][l]);
+    }
+
+    /**
+     * L consecutive blocks: block l uses counter + l (mod 2^64) in words 8 and 9 of x0 and is
+     * written to out + 64 l. Each block is x + Salsa_R(x). A power-of-two L >= 2 keeps the state in
+     * registers (salsaBlocksInRegisters); other widths run arx::laneForwardHalf over an array.
+     */
+    template <size_t L>
+    inline void salsaBlocks(const u32 *x0, u64 counter, int rounds, u8 *out)
+    {
+        static_assert(L >= 1 && L <= 64, "salsaBlocks: 1..64 lanes");
+        if constexpr (L >= 2 && std::has_single_bit(L))
+        {
+            salsaBlocksInRegisters<L>(x0, counter, rounds, out);
+            return;
+        }
+
+        alignas(64) u32 w[STATEWORD_COUNT][L];
+        alignas(64) u32 in[STATEWORD_COUNT][L];
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            for (size_t l{0}; l < L; ++l)
+                in[i][l] = x0[i];
+        for (size_t l{0}; l < L; ++l)
+        {
+            const u64 c = counter + l;
+            in[8][l] = static_cast<u32>(c);
+            in[9][l] = static_cast<u32>(c >> 32);
+        }
+        std::memcpy(w, in, sizeof(w));
+
+        for (int h{1}; h <= 2 * rounds; ++h)
+            arx::laneForwardHalf<arx::Salsa, L>(w, h);
+
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            for (size_t l{0}; l < L; ++l)
+                store32le(out + l * BLOCK_BYTES + 4 * i, w[i][l] + in[i][l]);
+    }
+
+    /**
+     * Salsa20/R keyed with a 16- or 32-byte key and an 8-byte nonce. Blocks are addressed by
+     * their 64-bit counter and byte ranges by their stream offset, so the object is read-only
+     * after construction and can be shared between threads.
+     */
+    class Salsa20
+    {
+    public:
+        Salsa20(const u8 *key, size_t key_bytes, const u8 *nonce, int rounds = 20)
+            : rounds_(rounds)
+        {
+            checkRounds(rounds);
+            u8 words_6_9[16] = {};
+            std::memcpy(words_6_9, nonce, NONCE_BYTES);
+            setupState(x0_, key, key_bytes, words_6_9);
+        }
+
+        int rounds() const { return rounds_; }
+
+        // one 64-byte block
+        void block(u64 counter, u8 *out) const
+        {
+            salsaBlocks<1>(x0_, counter, rounds_, out);
+        }
+
+        // L consecutive blocks starting at `counter` (L x 64 bytes)
+        template <size_t L = NATIVE_LANES>
+        void blocks(u64 counter, u8 *out) const
+        {
+            salsaBlocks<L>(x0_, counter, rounds_, out);
+        }
+
+        // `bytes` bytes of keystream starting at byte `offset` of the stream
+        void keystream(u64 offset, u8 *out, size_t bytes) const
+        {
+            constexpr size_t CHUNK = NATIVE_LANES * BLOCK_BYTES;
+            alignas(64) u8 buf[CHUNK];
+            u64 counter = offset / BLOCK_BYTES;
+            const size_t skip = offset % BLOCK_BYTES;
+
+            if (skip && bytes)
+            {
+                block(counter++, buf);
+                const size_t n = std::min(bytes, BLOCK_BYTES - skip);
+                std::memcpy(out, buf + skip, n);
+                out += n;
+                bytes -= n;
+            }
+            for (; bytes >= CHUNK; bytes -= CHUNK, out += CHUNK, counter += NATIVE_LANES)
+                blocks(counter, out);
+            for (; bytes >= BLOCK_BYTES; bytes -= BLOCK_BYTES, out += BLOCK_BYTES)
+                block(counter++, out);
+            if (bytes)
+            {
+                block(counter, buf);
+                std::memcpy(out, buf, bytes);
+            }
+        }
+
+        // out = in ^ keystream from byte `offset` (encrypts and decrypts; in == out is allowed)
+        void apply(u64 offset, const u8 *in, u8 *out, size_t bytes) const
+        {
+            constexpr size_t CHUNK = NATIVE_LANES * BLOCK_BYTES;
+            alignas(64) u8 buf[CHUNK];
+            while (bytes)
+            {
+                // stay block aligned after the first chunk so keystream() takes the lane path
+                const size_t n = std::min(bytes, CHUNK - static_cast<size_t>(offset % BLOCK_BYTES));
+                keystream(offset, buf, n);
+                for (size_t i{0}; i < n; ++i)
+                    out[i] = in[i] ^ buf[i];
+                in += n;
+                out += n;
+                offset += n;
+                bytes -= n;
+            }
+        }
+
+    private:
+        u32 x0_[STATEWORD_COUNT]; // words 8 and 9 are replaced by the block counter
+        int rounds_;
+    };
+
+    // HSalsa20/R: words 0, 5, 10, 15, 6, 7, 8, 9 of Salsa_R(x) without the feed-forward
+    inline void hsalsa20(const u8 *key, const u8 *nonce16, u8 *out32, int rounds = 20)
+    {
+        checkRounds(rounds);
+        u32 x[STATEWORD_COUNT];
+        setupState(x, key, KEY_BYTES, nonce16);
+        for (int h{1}; h <= 2 * rounds; ++h)
+            arx::forwardHalf<arx::Salsa>(x, h);
+
+        constexpr u16 OUT_WORDS[8] = {0, 5, 10, 15, 6, 7, 8, 9};
+        for (size_t i{0}; i < 8; ++i)
+            store32le(out32 + 4 * i, x[OUT_WORDS[i]]);
+    }
+
+    // XSalsa20/R: Salsa20/R under HSalsa20/R(key, nonce[0..16)) with nonce[16..24)
+    inline Salsa20 xsalsa20(const u8 *key, const u8 *nonce24, int rounds = 20)
+    {
+        u8 subkey[KEY_BYTES];
+        hsalsa20(key, nonce24, subkey, rounds);
+        return Salsa20(subkey, KEY_BYTES, nonce24 + HNONCE_BYTES, rounds);
+    }
+
+    /**
+     * Known-answer test against the published vectors, plus agreement of the lane and
+     * single-block paths (also for 8 and 12 rounds and across a counter carry).
+     * Throws std::runtime_error naming the first failing check.
+     */
+    inline void selfTest()
+    {
+        auto fromHex = [](const std::string &hex)
+        {
+            std::string out(hex.size() / 2, '\0');
+            for (size_t i{0}; i < out.size(); ++i)
+                out[i] = static_cast<char>(std::stoul(hex.substr(2 * i, 2), nullptr, 16));
+            return out;
+        };
+        auto expect = [&](const char *what, const u8 *got, const std::string &hex)
+        {
+            const std::string want = fromHex(hex);
+            if (std::memcmp(got, want.data(), want.size()) != 0)
+                throw std::runtime_error(std::string("keystream self-test failed: ") + what);
+        };
+
+        // specification, section 10: k0 = 1..16, k1 = 201..216, n = 101..116
+        u8 key[KEY_BYTES], n[16], out[16 * BLOCK_BYTES], ref[16 * BLOCK_BYTES];
+        for (u8 i{0}; i < 16; ++i)
+        {
+            key[i] = static_cast<u8>(1 + i);
+            key[16 + i] = static_cast<u8>(201 + i);
+            n[i] = static_cast<u8>(101 + i);
+        }
+        u64 counter = 0;
+        for (int i{7}; i >= 0; --i)
+            counter = counter << 8 | n[8 + i];
+
+        Salsa20(key, 32, n).block(counter, out);
+        expect("Salsa20 expansion, 32-byte key", out,
+               "45254427290f6bc1ff8b7a06aae9d9625990b66a1533c841ef31de22d772287e"
+               "68c507e1c5991f02664e4cb054f5f6b8b1a0858206489577c0c384ecea67f64a");
+        Salsa20(key, 16, n).block(counter, out);
+        expect("Salsa20 expansion, 16-byte key", out,
+               "27ad2ef81ec852113043feef25120df7f1c83d900a3732b9062ff6fd8f56bbe1"
+               "86556ef6a1a32bebe75eab3391d6701d0ee80510978cb78dab097ab568b6b1c1");
+
+        // NaCl tests core1, core2 and stream3
+        const std::string shared = fromHex("4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742");
+        const std::string nonce = fromHex("69696ee955b62b73cd62bda875fc73d68219e0036b7a0b37");
+        const u8 zero[HNONCE_BYTES] = {};
+        u8 firstkey[KEY_BYTES], secondkey[KEY_BYTES];
+        hsalsa20(reinterpret_cast<const u8 *>(shared.data()), zero, firstkey);
+        expect("HSalsa20 (core1)", firstkey, "1b27556473e985d462cd51197a9a46c76009549eac6474f206c4ee0844f68389");
+        hsalsa20(firstkey, reinterpret_cast<const u8 *>(nonce.data()), secondkey);
+        expect("HSalsa20 (core2)", secondkey, "dc908dda0b9344a953629b733820778880f3ceb421bb61b91cbd4c3e66256ce4");
+        xsalsa20(firstkey, reinterpret_cast<const u8 *>(nonce.data())).keystream(0, out, 32);
+        expect("XSalsa20 (stream3)", out, "eea6a7251c1e72916d11c2cb214d3c252539121d8e234e652d651fa4c8cff880");
+
+        // lane path == block path, for reduced rounds and across the 32-bit counter carry
+        for (int rounds : {8, 12, 20})
+        {
+            const Salsa20 s(key, 32, n, rounds);
+            const u64 first = 0xfffffffcULL;
+            s.blocks<16>(first, out);
+            for (size_t l{0}; l < 16; ++l)
+                s.block(first + l, ref + l * BLOCK_BYTES);
+            if (std::memcmp(out, ref, sizeof(out)) != 0)
+                throw std::runtime_error("keystream self-test failed: lanes vs single blocks, " +
+                                         std::to_string(rounds) + " rounds");
+            s.keystream(first * BLOCK_BYTES + 13, out, 1000);
+            if (std::memcmp(out, ref + 13, 1000) != 0)
+                throw std::runtime_error("keystream self-test failed: unaligned range, " +
+                                         std::to_string(rounds) + " rounds");
+        }
+    }
+}
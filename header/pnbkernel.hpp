@@ -0,0 +1,756 @@
+/*
+ * REFERENCE IMPLEMENTATION OF pnb kernel header file
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ *
+ * Synopsis:
+ * This file contains the per-sample forward/backward computation shared by every
+ * backward-bias experiment (single-bit PNB search, PNB-set bias, ...).
+ *
+ * A sample is split in two:
+ *   forward  : X, X' = X ^ ID  ->  parity at the distinguishing round, Z = X + X^R, Z' = X' + X'^R
+ *   backward : Z - X(guessed key) -> rounds inverted back to the distinguishing round -> parity
+ * so the forward half can be computed once and the backward half repeated for many key guesses.
+ *
+ * Rounds are counted in half-rounds: half-round h (1-based) belongs to round (h + 1) / 2,
+ * odd h is the 7/9 half and even h the 13/18 half. Odd rounds are column rounds.
+ *
+ * The round steps, state layout and last-round tail come from the arx.hpp description of
+ * the cipher named in CipherInfo::cipher_name (salsa or chacha). Functions that take a
+ * RoundPlan pick the instantiation from plan.cipher; the plan-less kernels take the cipher
+ * as a template argument and default to Salsa.
+ */
+
+#pragma once
+#include "arx.hpp"
+#include <array>
+#include <stdexcept>
+#include <string>
+
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+#include <immintrin.h>
+#endif
+
+namespace pnbkernel
+{
+    // bump whenever a change alters what a sample measures (rounds, tail, parity), so counts
+    // cached by an older kernel are not merged with new ones
+    constexpr u32 KERNEL_VERSION = 1;
+
+    // keys drawn for chosen-IV conditions before they are taken as unsatisfiable
+    constexpr u32 MAX_CONDITION_KEYS = 1u << 16;
+
+    struct RoundPlan
+    {
+        int fwd_halves = 0;   // half-rounds up to the distinguishing round
+        int total_halves = 0; // half-rounds before the modified last round
+        bool key_128 = false; // 128-bit key: word w is mirrored into word w + 4
+        arx::CipherId cipher = arx::CipherId::Salsa;
+
+        u32 id_words[STATEWORD_COUNT] = {};   // input difference as a state-sized XOR mask
+        u32 mask_words[STATEWORD_COUNT] = {}; // output mask as a state-sized AND mask
+
+        // chosen IV: IVs are built to satisfy these (owned by the caller), nullptr = random IV
+        const salsa::IVConditions *iv_conditions = nullptr;
+        u64 iv_conditions_id = 0; // fnv1a64 of iv_conditions->fingerprint(), 0 = random IV
+    };
+
+    inline RoundPlan makeRoundPlan(const config::CipherInfo &cipher, const config::DLInfo &diff,
+                                   const salsa::IVConditions *iv_conditions = nullptr)
+    {
+        if (!config::is_valid_round(cipher.total_rounds, config::RoundGranularity::Half))
+            throw std::invalid_argument("makeRoundPlan: total_rounds must be a multiple of 0.5");
+        if (!config::is_valid_round(diff.distinguishing_round, config::RoundGranularity::Half))
+            throw std::invalid_argument("makeRoundPlan: distinguishing_round must be a multiple of 0.5");
+        if (diff.distinguishing_round > cipher.total_rounds)
+            throw std::invalid_argument("makeRoundPlan: distinguishing_round cannot exceed total_rounds");
+        if (diff.chosen_iv_flag && (!iv_conditions || iv_conditions->empty()))
+            throw std::invalid_argument("makeRoundPlan: chosen_iv_flag needs non-empty IV conditions");
+
+        RoundPlan plan;
+        plan.cipher = arx::cipherFromName(cipher.cipher_name);
+        if (diff.chosen_iv_flag && plan.cipher != arx::CipherId::Salsa)
+            throw std::invalid_argument("makeRoundPlan: IV conditions are only defined for salsa");
+
+        plan.fwd_halves = static_cast<int>(std::lround(diff.distinguishing_round * 2.0));
+        plan.total_halves = static_cast<int>(std::lround(cipher.total_rounds * 2.0));
+        plan.key_128 = (cipher.key_size == 128);
+
+        // toggling keeps the old GET_BIT/TOGGLE_BIT semantics when a pair is listed twice
+        for (const auto &d : diff.id)
+            TOGGLE_BIT(plan.id_words[d.first], d.second);
+        for (const auto &d : diff.mask)
+            TOGGLE_BIT(plan.mask_words[d.first], d.second);
+
+        if (diff.chosen_iv_flag && iv_conditions)
+        {
+            plan.iv_conditions = iv_conditions;
+            plan.iv_conditions_id = checkpoint::fnv1a64(iv_conditions->fingerprint());
+        }
+
+        return plan;
+    }
+
+    // DLInfo::output_diff_str (wildcards allowed), or DLInfo::od when the string is empty,
+    // compiled for matching full states
+    inline ops::WildcardPattern<STATEWORD_COUNT> makeOutputPattern(const config::DLInfo &diff,
+                                                                   const config::CipherInfo &cipher)
+    {
+        config::DLInfo d = diff;
+        if (d.output_diff_str.empty())
+        {
+            if (d.od.empty())
+                throw std::invalid_argument("makeOutputPattern: neither od nor output_diff_str is set");
+            ops::build_output_diff_str(d, cipher);
+        }
+        return ops::compileWildcardPattern<STATEWORD_COUNT>(d.output_diff_str);
+    }
+
+    // ---------------- half-round steps -----------------
+    template <class C = arx::Salsa>
+    inline void forwardHalf(u32 *x, int h)
+    {
+        arx::forwardHalf<C>(x, h);
+    }
+
+    // undoes half-round h
+    template <class C = arx::Salsa>
+    inline void backwardHalf(u32 *x, int h)
+    {
+        arx::backwardHalf<C>(x, h);
+    }
+
+    // applies half-rounds from + 1, ..., to
+    template <class C = arx::Salsa>
+    inline void forwardHalves(u32 *x, int from, int to)
+    {
+        for (int h{from + 1}; h <= to; ++h)
+            arx::forwardHalf<C>(x, h);
+    }
+
+    // undoes half-rounds from, from - 1, ..., to + 1
+    template <class C = arx::Salsa>
+    inline void backwardHalves(u32 *x, int from, int to)
+    {
+        for (int h{from}; h > to; --h)
+            arx::backwardHalf<C>(x, h);
+    }
+
+    // modified last round (Salsa: 13 of a row round, 18 left out; ChaCha: none)
+    template <class C = arx::Salsa>
+    inline void lastRoundTail(u32 *x)
+    {
+        arx::lastRoundTail<C>(x);
+    }
+
+    template <class C = arx::Salsa>
+    inline void undoLastRoundTail(u32 *x)
+    {
+        arx::undoLastRoundTail<C>(x);
+    }
+
+    // parity of (x ^ dx) under the output mask
+    inline u8 maskParity(const u32 *x, const u32 *dx, const u32 *mask)
+    {
+        u32 acc = 0;
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            acc ^= (x[i] ^ dx[i]) & mask[i];
+        return static_cast<u8>(std::popcount(acc) & 1);
+    }
+
+    // ---------------- key helpers -----------------
+    // global key-bit index -> (word, bit); a 128-bit key repeats words 0..3 in 4..7
+    inline void toggleKeyBit(u32 *key, u16 idx, bool key_128)
+    {
+        const u16 w = idx / WORD_SIZE;
+        const u16 b = idx % WORD_SIZE;
+        TOGGLE_BIT(key[w], b);
+        if (key_128)
+            TOGGLE_BIT(key[w + 4], b);
+    }
+
+    // mask[w] has a one for every listed key bit; throws for an index outside the key
+    inline void buildKeyMask(const std::vector<u16> &indices, bool key_128, u32 *mask)
+    {
+        const u16 key_bits = key_128 ? 128 : 256;
+        ops::setState(mask, 0, KEYWORD_COUNT, u32{0});
+        for (u16 idx : indices)
+        {
+            if (idx >= key_bits)
+                throw std::out_of_range("key bit " + std::to_string(idx) + " outside a " +
+                                        std::to_string(key_bits) + "-bit key");
+            SET_BIT(mask[idx / WORD_SIZE], idx % WORD_SIZE);
+            if (key_128)
+                SET_BIT(mask[idx / WORD_SIZE + 4], idx % WORD_SIZE);
+        }
+    }
+
+    // guess = key outside mask, values inside mask (mirrored for 128-bit keys)
+    inline void replaceKeyBits(u32 *guess, const u32 *key, const u32 *mask, const u32 *values, bool key_128)
+    {
+        for (size_t w{0}; w < KEYWORD_COUNT; ++w)
+            guess[w] = (key[w] & ~mask[w]) | (values[w] & mask[w]);
+        if (key_128)
+        {
+            for (size_t w{0}; w < KEYWORD_COUNT / 2; ++w)
+                guess[w + 4] = guess[w];
+        }
+    }
+
+    // ---------------- forward half of a sample -----------------
+    struct ForwardSample
+    {
+        u32 key[KEYWORD_COUNT];
+        u32 iv[arx::IV_WORD_COUNT];
+        u32 z[STATEWORD_COUNT];  // X + X^R
+        u32 dz[STATEWORD_COUNT]; // X' + X'^R
+        u8 fwd_parity;           // mask parity of the difference at the distinguishing round
+    };
+
+    // constants + iv + key
+    template <class C = arx::Salsa>
+    inline void initialState(u32 *x, const u32 *iv, const u32 *key)
+    {
+        arx::initialState<C>(x, iv, key);
+    }
+
+    inline void initialState(const RoundPlan &plan, u32 *x, const u32 *iv, const u32 *key)
+    {
+        arx::dispatch(plan.cipher, [&](auto c)
+                      { initialState<decltype(c)>(x, iv, key); });
+    }
+
+    // Runs the forward half from an already built initial state x0.
+    template <class C>
+    inline void forwardFromState(const RoundPlan &plan, const u32 *x0, ForwardSample &s)
+    {
+        u32 x[STATEWORD_COUNT], dx[STATEWORD_COUNT];
+
+        arx::extractKey<C>(x0, s.key);
+        arx::extractIV<C>(x0, s.iv);
+
+        ops::copyState(x, x0);
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            dx[i] = x0[i] ^ plan.id_words[i];
+
+        PNB_PHASE(Setup);
+
+        forwardHalves<C>(x, 0, plan.fwd_halves);
+        forwardHalves<C>(dx, 0, plan.fwd_halves);
+        PNB_PHASE(Forward);
+
+        s.fwd_parity = maskParity(x, dx, plan.mask_words);
+        PNB_PHASE(Parity);
+
+        forwardHalves<C>(x, plan.fwd_halves, plan.total_halves);
+        forwardHalves<C>(dx, plan.fwd_halves, plan.total_halves);
+
+        lastRoundTail<C>(x);
+        lastRoundTail<C>(dx);
+        PNB_PHASE(Forward);
+
+        // Z = X + X^R
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            s.z[i] = x[i] + x0[i];
+            s.dz[i] = dx[i] + (x0[i] ^ plan.id_words[i]);
+        }
+        PNB_PHASE(FeedForward);
+    }
+
+    inline void forwardFromState(const RoundPlan &plan, const u32 *x0, ForwardSample &s)
+    {
+        arx::dispatch(plan.cipher, [&](auto c)
+                      { forwardFromState<decltype(c)>(plan, x0, s); });
+    }
+
+    // Fresh random IV and key (in that order, as the search always drew them). With chosen-IV
+    // conditions (Salsa only) the key comes first and the IV is built for it; a key that
+    // admits no such IV is redrawn, and after MAX_CONDITION_KEYS keys std::runtime_error is
+    // thrown (e.g. an equality on a constant bit that contradicts a fixed bit).
+    template <class C>
+    inline void generateInitialState(const RoundPlan &plan, u32 *x0)
+    {
+        salsa::InitKey init_key;
+        u32 key[KEYWORD_COUNT], iv[arx::IV_WORD_COUNT];
+
+        if constexpr (C::ID == arx::CipherId::Salsa)
+        {
+            if (plan.iv_conditions)
+            {
+                for (u32 draw{0}; draw < MAX_CONDITION_KEYS; ++draw)
+                {
+                    if (plan.key_128)
+                        init_key.key_128bit(key);
+                    else
+                        init_key.key_256bit(key);
+                    salsa::insert_key(x0, key);
+                    if (salsa::init_iv_const(x0, *plan.iv_conditions))
+                        return;
+                }
+                throw std::runtime_error("IV conditions unsatisfiable: no IV for " + std::to_string(MAX_CONDITION_KEYS) +
+                                         " random keys (" + plan.iv_conditions->fingerprint() + ")");
+            }
+        }
+
+        for (size_t i{0}; i < arx::IV_WORD_COUNT; ++i)
+            iv[i] = RandomNumber<u32>();
+        if (plan.key_128)
+            init_key.key_128bit(key);
+        else
+            init_key.key_256bit(key);
+        initialState<C>(x0, iv, key);
+    }
+
+    inline void generateInitialState(const RoundPlan &plan, u32 *x0)
+    {
+        arx::dispatch(plan.cipher, [&](auto c)
+                      { generateInitialState<decltype(c)>(plan, x0); });
+    }
+
+    // random initial state + forward half
+    template <class C>
+    inline void generateSample(const RoundPlan &plan, ForwardSample &s)
+    {
+        u32 x0[STATEWORD_COUNT];
+
+        PNB_PHASE_START();
+        generateInitialState<C>(plan, x0);
+        forwardFromState<C>(plan, x0, s);
+    }
+
+    inline void generateSample(const RoundPlan &plan, ForwardSample &s)
+    {
+        arx::dispatch(plan.cipher, [&](auto c)
+                      { generateSample<decltype(c)>(plan, s); });
+    }
+
+    // ---------------- fixed key, many IVs -----------------
+    // Four of the eight ARX steps of the first (column) half-round read only constants and key
+    // words: x3' and x4' (7 steps) and the terms XORed into the IV words 9 (7 step), 7 and 8
+    // (9 steps). With the key fixed they are computed once and reused for every IV, in X and X'.
+    struct KeyedFirstHalf
+    {
+        u32 key[KEYWORD_COUNT];
+        u32 base[2][STATEWORD_COUNT]; // X / X' with zero IV words ([1] carries the whole ID)
+        u32 x3[2], x4[2];             // x3', x4'
+        u32 t7[2], t8[2], t9[2];      // x7 ^= t7, x8 ^= t8, x9 ^= t9
+    };
+
+    inline void makeKeyedFirstHalf(const RoundPlan &plan, const u32 *key, KeyedFirstHalf &kf)
+    {
+        if (plan.cipher != arx::CipherId::Salsa)
+            throw std::invalid_argument("makeKeyedFirstHalf: the precomputed first half-round is Salsa's");
+
+        const u32 zero_iv[SALSA_IV_END - SALSA_IV_START + 1] = {};
+        ops::copyState(kf.key, key, 0, KEYWORD_COUNT);
+        initialState(kf.base[0], zero_iv, key);
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            kf.base[1][i] = kf.base[0][i] ^ plan.id_words[i];
+
+        for (int v{0}; v < 2; ++v)
+        {
+            const u32 *b = kf.base[v];
+            kf.x3[v] = b[3] ^ std::rotl(b[15] + b[11], 7);
+            kf.x4[v] = b[4] ^ std::rotl(b[0] + b[12], 7);
+            kf.t9[v] = std::rotl(b[5] + b[1], 7);
+            kf.t7[v] = std::rotl(kf.x3[v] + b[15], 9);
+            kf.t8[v] = std::rotl(kf.x4[v] + b[0], 9);
+        }
+    }
+
+    // forwardFromState() for the key of `kf` and `iv`, first half-round from the precomputation
+    inline void forwardFromKeyed(const RoundPlan &plan, const KeyedFirstHalf &kf, const u32 *iv, ForwardSample &s)
+    {
+        u32 x0[2][STATEWORD_COUNT], x[2][STATEWORD_COUNT];
+        for (int v{0}; v < 2; ++v)
+        {
+            ops::copyState(x0[v], kf.base[v]);
+            for (size_t i{SALSA_IV_START}; i <= SALSA_IV_END; ++i)
+                x0[v][i] ^= iv[i - SALSA_IV_START];
+        }
+
+        if (plan.fwd_halves < 1)
+        {
+            forwardFromState(plan, x0[0], s);
+            return;
+        }
+
+        ops::copyState(s.key, kf.key, 0, KEYWORD_COUNT);
+        for (size_t i{SALSA_IV_START}; i <= SALSA_IV_END; ++i)
+            s.iv[i - SALSA_IV_START] = iv[i - SALSA_IV_START];
+
+        for (int v{0}; v < 2; ++v)
+        {
+            u32 *y = x[v];
+            ops::copyState(y, x0[v]);
+
+            // half-round 1: column 7 steps, then 9 steps
+            y[3] = kf.x3[v];
+            y[4] = kf.x4[v];
+            y[9] ^= kf.t9[v];
+            y[14] ^= std::rotl(y[10] + y[6], 7);
+            y[7] ^= kf.t7[v];
+            y[8] ^= kf.t8[v];
+            y[13] ^= std::rotl(y[9] + y[5], 9);
+            y[2] ^= std::rotl(y[14] + y[10], 9);
+
+            forwardHalves(y, 1, plan.fwd_halves);
+        }
+
+        s.fwd_parity = maskParity(x[0], x[1], plan.mask_words);
+
+        for (int v{0}; v < 2; ++v)
+        {
+            forwardHalves(x[v], plan.fwd_halves, plan.total_halves);
+            lastRoundTail(x[v]);
+        }
+
+        // Z = X + X^R
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            s.z[i] = x[0][i] + x0[0][i];
+            s.dz[i] = x[1][i] + x0[1][i];
+        }
+    }
+
+    // ---------------- backward half of a sample -----------------
+    // Mask parity at the distinguishing round when Z is inverted with `guess` as the key.
+    template <class C>
+    inline u8 backwardParity(const RoundPlan &plan, const ForwardSample &s, const u32 *guess)
+    {
+        u32 x[STATEWORD_COUNT], dx[STATEWORD_COUNT];
+
+        initialState<C>(x, s.iv, guess);
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            dx[i] = x[i] ^ plan.id_words[i];
+        arx::insertKey<C>(dx, guess); // key words always carry the guess
+
+        // Z - X^R
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            x[i] = s.z[i] - x[i];
+            dx[i] = s.dz[i] - dx[i];
+        }
+        PNB_PHASE(KeyFlip);
+
+        undoLastRoundTail<C>(x);
+        undoLastRoundTail<C>(dx);
+
+        backwardHalves<C>(x, plan.total_halves, plan.fwd_halves);
+        backwardHalves<C>(dx, plan.total_halves, plan.fwd_halves);
+        PNB_PHASE(Backward);
+
+        const u8 parity = maskParity(x, dx, plan.mask_words);
+        PNB_PHASE(Parity);
+        return parity;
+    }
+
+    inline u8 backwardParity(const RoundPlan &plan, const ForwardSample &s, const u32 *guess)
+    {
+        return arx::dispatch(plan.cipher, [&](auto c)
+                             { return backwardParity<decltype(c)>(plan, s, guess); });
+    }
+
+    // ---------------- key masks -----------------
+    using KeyMask = std::array<u32, KEYWORD_COUNT>;
+
+    inline KeyMask makeKeyMask(const std::vector<u16> &indices, bool key_128)
+    {
+        KeyMask m;
+        buildKeyMask(indices, key_128, m.data());
+        return m;
+    }
+
+    // ---------------- lane-batched backward half -----------------
+    // L key guesses of the same sample are inverted together. The state is kept as
+    // w[word][lane] so every ARX step is one loop over lanes, which -O3 turns into
+    // vector instructions (SSE/AVX2/AVX-512 depending on -march).
+    template <size_t L>
+    struct LaneState
+    {
+        alignas(64) u32 w[STATEWORD_COUNT][L];
+    };
+
+    // applies half-round h on all lanes (same convention as forwardHalf)
+    template <size_t L, class C = arx::Salsa>
+    inline void laneForwardHalf(LaneState<L> &s, int h)
+    {
+        arx::laneForwardHalf<C, L>(s.w, h);
+    }
+
+    // undoes half-round h on all lanes (same convention as backwardHalf)
+    template <size_t L, class C = arx::Salsa>
+    inline void laneBackwardHalf(LaneState<L> &s, int h)
+    {
+        arx::laneBackwardHalf<C, L>(s.w, h);
+    }
+
+    template <size_t L, class C = arx::Salsa>
+    inline void laneUndoLastRoundTail(LaneState<L> &s)
+    {
+        arx::laneUndoLastRoundTail<C, L>(s.w);
+    }
+
+    // x <- Z - X(guess), dx <- Z' - X'(guess); guesses[l] is the key of lane l
+    template <size_t L, class C = arx::Salsa>
+    inline void laneLoadBackward(const RoundPlan &plan, const u32 *iv, const u32 *z, const u32 *dz,
+                                 const u32 (*guesses)[KEYWORD_COUNT], LaneState<L> &x, LaneState<L> &dx)
+    {
+        u32 x0[STATEWORD_COUNT];
+        initialState<C>(x0, iv, guesses[0]);
+
+        // non-key words are the same in every lane
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            const u32 a = z[i] - x0[i];
+            const u32 b = dz[i] - (x0[i] ^ plan.id_words[i]);
+            for (size_t l{0}; l < L; ++l)
+            {
+                x.w[i][l] = a;
+                dx.w[i][l] = b;
+            }
+        }
+
+        // key words carry each lane's guess (in X and X')
+        for (size_t k{0}; k < KEYWORD_COUNT; ++k)
+        {
+            const size_t i = C::KEY_WORDS[k];
+            for (size_t l{0}; l < L; ++l)
+            {
+                x.w[i][l] = z[i] - guesses[l][k];
+                dx.w[i][l] = dz[i] - guesses[l][k];
+            }
+        }
+    }
+
+    // bit l = mask parity of (x ^ dx) in lane l
+    template <size_t L>
+    inline u64 laneMaskParity(const LaneState<L> &x, const LaneState<L> &dx, const u32 *mask)
+    {
+        u32 acc[L] = {};
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            if (!mask[i])
+                continue;
+            for (size_t l{0}; l < L; ++l)
+                acc[l] ^= (x.w[i][l] ^ dx.w[i][l]) & mask[i];
+        }
+
+        u64 parities = 0;
+        for (size_t l{0}; l < L; ++l)
+            parities |= static_cast<u64>(std::popcount(acc[l]) & 1) << l;
+        return parities;
+    }
+
+    // hw[i][l] = Hamming weight of x[i] ^ dx[i] in lane l. Uses VPOPCNTDQ (16 words per
+    // instruction) when compiled for it, otherwise std::popcount per word.
+    template <size_t L>
+    inline void laneDiffWeights(const LaneState<L> &x, const LaneState<L> &dx, u32 (*hw)[L])
+    {
+#if defined(__AVX512F__) && defined(__AVX512VPOPCNTDQ__)
+        if constexpr (L % 16 == 0)
+        {
+            for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+                for (size_t l{0}; l < L; l += 16)
+                {
+                    const __m512i a = _mm512_load_si512(&x.w[i][l]);
+                    const __m512i b = _mm512_load_si512(&dx.w[i][l]);
+                    _mm512_storeu_si512(&hw[i][l], _mm512_popcnt_epi32(_mm512_xor_si512(a, b)));
+                }
+            return;
+        }
+#endif
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            for (size_t l{0}; l < L; ++l)
+                hw[i][l] = static_cast<u32>(std::popcount(x.w[i][l] ^ dx.w[i][l]));
+    }
+
+    // bit l = the difference x ^ dx of lane l matches the compiled output difference
+    template <size_t L>
+    inline u64 laneMatchPattern(const LaneState<L> &x, const LaneState<L> &dx,
+                                const ops::WildcardPattern<STATEWORD_COUNT> &od)
+    {
+        u32 acc[L] = {};
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            if (!od.mask[i])
+                continue;
+            for (size_t l{0}; l < L; ++l)
+                acc[l] |= (x.w[i][l] ^ dx.w[i][l] ^ od.value[i]) & od.mask[i];
+        }
+
+        u64 hits = 0;
+        for (size_t l{0}; l < L; ++l)
+            hits |= static_cast<u64>(acc[l] == 0) << l;
+        return hits;
+    }
+
+    /**
+     * backwardParity() for L key guesses of one sample at once.
+     * guesses[l] is the key of lane l; bit l of the result is the backward parity of lane l.
+     */
+    template <size_t L, class C>
+    inline u64 backwardParityLanes(const RoundPlan &plan, const ForwardSample &s,
+                                   const u32 (*guesses)[KEYWORD_COUNT])
+    {
+        static_assert(L >= 1 && L <= 64, "backwardParityLanes: 1..64 lanes");
+
+        LaneState<L> x, dx;
+        laneLoadBackward<L, C>(plan, s.iv, s.z, s.dz, guesses, x, dx);
+
+        laneUndoLastRoundTail<L, C>(x);
+        laneUndoLastRoundTail<L, C>(dx);
+
+        for (int h{plan.total_halves}; h > plan.fwd_halves; --h)
+        {
+            laneBackwardHalf<L, C>(x, h);
+            laneBackwardHalf<L, C>(dx, h);
+        }
+
+        return laneMaskParity(x, dx, plan.mask_words);
+    }
+
+    template <size_t L>
+    inline u64 backwardParityLanes(const RoundPlan &plan, const ForwardSample &s,
+                                   const u32 (*guesses)[KEYWORD_COUNT])
+    {
+        return arx::dispatch(plan.cipher, [&](auto c)
+                             { return backwardParityLanes<L, decltype(c)>(plan, s, guesses); });
+    }
+
+    /**
+     * backwardParity() for L samples at once, one per lane: lane l inverts s[l] with the key
+     * guesses[l]. Bit l of the result is the backward parity of lane l.
+     */
+    template <size_t L, class C>
+    inline u64 backwardParitySamples(const RoundPlan &plan, const ForwardSample *s,
+                                     const u32 (*guesses)[KEYWORD_COUNT])
+    {
+        static_assert(L >= 1 && L <= 64, "backwardParitySamples: 1..64 lanes");
+
+        LaneState<L> x, dx;
+        for (size_t l{0}; l < L; ++l)
+        {
+            u32 x0[STATEWORD_COUNT], dx0[STATEWORD_COUNT];
+            initialState<C>(x0, s[l].iv, guesses[l]);
+            for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+                dx0[i] = x0[i] ^ plan.id_words[i];
+            arx::insertKey<C>(dx0, guesses[l]); // key words always carry the guess
+
+            for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            {
+                x.w[i][l] = s[l].z[i] - x0[i];
+                dx.w[i][l] = s[l].dz[i] - dx0[i];
+            }
+        }
+        PNB_PHASE(KeyFlip);
+
+        laneUndoLastRoundTail<L, C>(x);
+        laneUndoLastRoundTail<L, C>(dx);
+
+        for (int h{plan.total_halves}; h > plan.fwd_halves; --h)
+        {
+            laneBackwardHalf<L, C>(x, h);
+            laneBackwardHalf<L, C>(dx, h);
+        }
+        PNB_PHASE(Backward);
+
+        const u64 parities = laneMaskParity(x, dx, plan.mask_words);
+        PNB_PHASE(Parity);
+        return parities;
+    }
+
+    template <size_t L>
+    inline u64 backwardParitySamples(const RoundPlan &plan, const ForwardSample *s,
+                                     const u32 (*guesses)[KEYWORD_COUNT])
+    {
+        return arx::dispatch(plan.cipher, [&](auto c)
+                             { return backwardParitySamples<L, decltype(c)>(plan, s, guesses); });
+    }
+
+    // ---------------- batched evaluation of many key jobs -----------------
+    // A key job either flips the masked key bits or replaces them with the sample's random values.
+    struct KeyJob
+    {
+        KeyMask mask{};
+        bool randomize = false;
+    };
+
+    /**
+     * Joint evaluator: for `samples` fresh samples, counts fwd_parity == bwd_parity for every
+     * job (matches[i] += ...) and fwd_parity == 0 (d_hits).
+     *
+     * The forward half is computed once per sample, the backward halves of all jobs run L at a
+     * time, and every job sees the same sample and the same random values, so differences
+     * between jobs are not sampling noise of independent runs.
+     */
+    template <size_t L = 16>
+    inline void countJobMatches(const RoundPlan &plan,
+                                const std::vector<KeyJob> &jobs,
+                                u64 samples,
+                                std::vector<u64> &matches,
+                                u64 &d_hits)
+    {
+        matches.assign(jobs.size(), 0);
+        d_hits = 0;
+
+        ForwardSample sample;
+        u32 guesses[L][KEYWORD_COUNT], values[KEYWORD_COUNT];
+
+        for (u64 loop{0}; loop < samples; ++loop)
+        {
+            generateSample(plan, sample);
+            for (size_t w{0}; w < KEYWORD_COUNT; ++w)
+                values[w] = RandomNumber<u32>();
+
+            d_hits += (sample.fwd_parity == 0);
+
+            for (size_t t0{0}; t0 < jobs.size(); t0 += L)
+            {
+                const size_t lanes = std::min(L, jobs.size() - t0);
+                for (size_t l{0}; l < L; ++l)
+                {
+                    if (l >= lanes)
+                    {
+                        ops::copyState(guesses[l], sample.key, 0, KEYWORD_COUNT); // padding lane
+                        continue;
+                    }
+
+                    const KeyJob &job = jobs[t0 + l];
+                    if (job.randomize)
+                        replaceKeyBits(guesses[l], sample.key, job.mask.data(), values, plan.key_128);
+                    else
+                    {
+                        for (size_t w{0}; w < KEYWORD_COUNT; ++w)
+                            guesses[l][w] = sample.key[w] ^ job.mask[w];
+                    }
+                }
+
+                const u64 parities = backwardParityLanes<L>(plan, sample, guesses);
+                for (size_t l{0}; l < lanes; ++l)
+                    matches[t0 + l] += (sample.fwd_parity == ((parities >> l) & 1));
+            }
+        }
+    }
+
+    // countJobMatches() with every PNB of every set randomised
+    inline void countSetMatches(const RoundPlan &plan,
+                                const std::vector<KeyMask> &masks,
+                                u64 samples,
+                                std::vector<u64> &matches,
+                                u64 &d_hits)
+    {
+        std::vector<KeyJob> jobs;
+        jobs.reserve(masks.size());
+        for (const auto &m : masks)
+            jobs.push_back({m, true});
+        countJobMatches(plan, jobs, samples, matches, d_hits);
+    }
+}
@@ -145,7 +145,7 @@ namespace pnbinfo
     // File format:
     //   - Any mix of spaces/newlines/commas is accepted.
     //   - E.g. "1 2 3 7 8 21" or "1,2,3,7,8,21"
-    //   - Values must be in [0,256).
+    //   - Values must be in [0,key_size); pnbsInKeyRange() checks a list set in code.
     // -----------------------------------------------------------------------------
 
     // Helper: take a vector of PNB indices, sort/dedup, and fill cfg.{pnbs, ...}
@@ -204,10 +204,10 @@ namespace pnbinfo
             int v;
             while (iss >> v)
             {
-                if (v < 0 || v > cipher->key_size)
+                if (v < 0 || v >= cipher->key_size)
                 {
                     std::cerr << "⚠ Invalid PNB value: " << v
-                              << " (must be in [0,256))\n";
+                              << " (must be in [0," << cipher->key_size << "))\n";
                     return false;
                 }
                 vals.push_back(static_cast<u16>(v));
@@ -232,6 +232,21 @@ namespace pnbinfo
         return finalizePNBValues(cfg, std::move(vals));
     }
 
+    // every index in cfg.pnbs addresses a key bit; reports the first one that does not
+    inline bool pnbsInKeyRange(const PNBdetails &cfg, const config::CipherInfo *cipher)
+    {
+        for (u16 v : cfg.pnbs)
+        {
+            if (v >= cipher->key_size)
+            {
+                std::cerr << "⚠ Invalid PNB value: " << v
+                          << " (must be in [0," << cipher->key_size << "))\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
     // Helper: print a vector in { a, b, c } format
     template <class T>
     void print_braced_list(const std::vector<T> &v, std::ostream &out)
@@ -487,6 +502,117 @@ namespace pnbinfo
         }
     }
 
+    // ---------------- bias convergence over sample checkpoints -----------------
+    // Matches of every key bit after 2^10, 2^12, ... samples and after the full budget, in one
+    // flat array (row = key bit). Checkpoints below the samples taken from a cache are not
+    // measured in this run.
+    struct BiasConvergence
+    {
+        static constexpr u64 NOT_MEASURED = ~0ULL;
+
+        std::vector<u64> checkpoints; // ascending sample counts, the last one is the budget
+        std::vector<u64> matches;     // [bit * checkpoints.size() + k]
+        std::vector<u32> ms;          // time from the start of the bit until checkpoint k was reached
+
+        void init(u64 budget, std::size_t bits, u64 first = 1ULL << 10)
+        {
+            checkpoints.clear();
+            for (u64 c = first; c < budget; c <<= 2)
+                checkpoints.push_back(c);
+            checkpoints.push_back(budget);
+            matches.assign(bits * checkpoints.size(), NOT_MEASURED);
+            ms.assign(bits * checkpoints.size(), 0);
+        }
+
+        bool enabled() const { return !checkpoints.empty(); }
+
+        std::size_t at(u16 bit, std::size_t k) const { return bit * checkpoints.size() + k; }
+
+        bool measured(u16 bit, std::size_t k) const { return matches[at(bit, k)] != NOT_MEASURED; }
+
+        // same rule as the search: |bias| >= threshold and non-zero
+        bool pnbAt(u16 bit, std::size_t k, double threshold) const
+        {
+            const double b = std::fabs(stats::biasFromCount(matches[at(bit, k)], checkpoints[k]));
+            return b >= threshold && b > 0.0;
+        }
+
+        // first checkpoint from which the PNB decision of `bit` no longer changes (0: none measured)
+        u64 settledAt(u16 bit, double threshold) const
+        {
+            const std::size_t last = checkpoints.size() - 1;
+            if (!measured(bit, last))
+                return 0;
+            const bool final_decision = pnbAt(bit, last, threshold);
+            std::size_t k = last;
+            while (k > 0 && measured(bit, k - 1) && pnbAt(bit, k - 1, threshold) == final_decision)
+                --k;
+            return checkpoints[k];
+        }
+    };
+
+    // one BiasTableLayout table per key bit: samples, probability, bias, 95% CI, time to reach
+    inline void print_bias_convergence(const BiasConvergence &conv,
+                                       const std::vector<u16> &bits,
+                                       double threshold,
+                                       const config::CipherInfo *cipher,
+                                       std::ostream &out)
+    {
+        display::BiasTableLayout lay;
+        lay.label_4 = "95% CI (+/-)";
+
+        out << "------------------------------------------------------------------------------\n";
+        out << "Bias convergence per key bit (bias = 2p - 1, PNB when |bias| >= " << threshold << "):\n";
+        for (u16 bit : bits)
+        {
+            const u64 settled = conv.settledAt(bit, threshold);
+            if (settled == 0)
+                continue;
+            const std::size_t last = conv.checkpoints.size() - 1;
+            out << "\nKey bit " << bit << " (word " << bit / cipher->word_size_bits << ", bit "
+                << bit % cipher->word_size_bits << "): " << (conv.pnbAt(bit, last, threshold) ? "PNB" : "non-PNB")
+                << " from " << display::formatCountPow2Pow10(settled) << " samples on\n";
+
+            display::printHeader(lay, out);
+            for (std::size_t k{0}; k < conv.checkpoints.size(); ++k)
+            {
+                if (!conv.measured(bit, k))
+                    continue;
+                const u64 hits = conv.matches[conv.at(bit, k)];
+                const u64 n = conv.checkpoints[k];
+                display::outputResult(n, static_cast<double>(hits) / static_cast<double>(n), stats::biasFromCount(hits, n),
+                                      stats::biasHalfWidth(hits, n), conv.ms[conv.at(bit, k)], lay, out);
+            }
+            display::printBorder(lay, out);
+        }
+    }
+
+    // how many key bits have their final PNB decision at each checkpoint, and the samples all need
+    inline void print_bias_convergence_summary(const BiasConvergence &conv,
+                                               const std::vector<u16> &bits,
+                                               double threshold,
+                                               std::ostream &out)
+    {
+        std::vector<std::size_t> settled(conv.checkpoints.size(), 0);
+        u64 needed = 0;
+        for (u16 bit : bits)
+        {
+            const u64 s = conv.settledAt(bit, threshold);
+            if (s == 0)
+                continue;
+            for (std::size_t k{0}; k < conv.checkpoints.size(); ++k)
+                if (conv.checkpoints[k] >= s)
+                    ++settled[k];
+            needed = std::max(needed, s);
+        }
+
+        out << "Bias convergence (key bits with their final PNB decision):\n";
+        for (std::size_t k{0}; k < conv.checkpoints.size(); ++k)
+            display::printField(out, "  from " + display::formatCountPow2Pow10(conv.checkpoints[k]) + " samples",
+                                std::to_string(settled[k]) + " / " + std::to_string(bits.size()));
+        display::printField(out, "Samples for a stable PNB set", needed ? display::formatCountPow2Pow10(needed) : std::string("-"));
+    }
+
     // 4. Biases as –log2(|bias|) for all PNBs
     void print_neglog2_biases_all(const std::vector<double> &bias_per_bit,
                                   const config::CipherInfo *cipher,
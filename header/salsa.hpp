@@ -4,7 +4,7 @@
  * Filename: salsa.h
  *
  * created: 23/9/23
- * updated: 01/12/25
+ * updated: 18/10/26
  *
  * by Hiren
  * Researcher
@@ -324,7 +324,7 @@ namespace salsa
                 x[index] = value;
         }
     }
-    void insert_key(u32 *x, u32 *k)
+    void insert_key(u32 *x, const u32 *k)
     {
         for (size_t index{1}; index <= 4; ++index)
             x[index] = k[index - 1];
@@ -443,5 +443,251 @@ namespace salsa
             }
         }
     };
+
+    // ---------------- chosen-IV conditions -----------------
+    /*
+     * Conditions on the state after the first half-round (column round, 7/9 steps), met by
+     * building the IV instead of rejecting samples. With the key in place:
+     *   x6' = x6                          x14' = x14 ^ ((x10 + x6) <<< 7)
+     *   x9' = x9 ^ ((x5 + x1) <<< 7)       x13' = x13 ^ ((x9' + x5) <<< 9)
+     *   x7' = x7 ^ ((x3' + x15) <<< 9)     x8'  = x8 ^ ((x4' + x0) <<< 9)
+     * Words 7 and 8 are linear in their IV word. Words 6/14 and 9/13 are solved together,
+     * bit by bit through the carries of the addition. Word 2 (two additions away from the
+     * IV) cannot be conditioned, and neither can bits that do not depend on the IV.
+     *
+     * Groups are solved in the order 9/13, 6/14, 7, 8, so an equality is resolved into a
+     * fixed bit of whichever of its two bits is solved later.
+     */
+    inline int iv_group(u16 word)
+    {
+        switch (word)
+        {
+        case 9:
+        case 13:
+            return 1;
+        case 6:
+        case 14:
+            return 2;
+        case 7:
+            return 3;
+        case 8:
+            return 4;
+        case 2:
+            return -1;
+        default:
+            return 0; // key / constant only
+        }
+    }
+
+    struct IVConditions
+    {
+        struct Bit
+        {
+            u16 word, bit;
+        };
+        struct Equality
+        {
+            Bit a, b; // b is solved after a
+            u8 value; // a ^ b
+        };
+
+        u32 fixed_mask[STATEWORD_COUNT] = {};
+        u32 fixed_value[STATEWORD_COUNT] = {};
+        std::vector<Equality> equalities;
+
+        // bit `bit` of word `word` after the first half-round equals `value`
+        void fix(u16 word, u16 bit, u8 value)
+        {
+            check(word, bit);
+            if (iv_group(word) == 0)
+                throw std::invalid_argument("IVConditions: word " + std::to_string(word) +
+                                            " does not depend on the IV after the first half-round");
+            const u32 m = 1u << bit;
+            if ((fixed_mask[word] & m) && (((fixed_value[word] >> bit) & 1u) != (value & 1u)))
+                throw std::invalid_argument("IVConditions: conflicting values for x" + std::to_string(word) +
+                                            "[" + std::to_string(bit) + "]");
+            fixed_mask[word] |= m;
+            fixed_value[word] = (fixed_value[word] & ~m) | ((value & 1u) << bit);
+        }
+
+        // x<w1>[b1] ^ x<w2>[b2] == opposite, after the first half-round
+        void equal(u16 w1, u16 b1, u16 w2, u16 b2, bool opposite = false)
+        {
+            check(w1, b1);
+            check(w2, b2);
+            int g1 = iv_group(w1), g2 = iv_group(w2);
+            if (g1 == 0 && g2 == 0)
+                throw std::invalid_argument("IVConditions: neither bit depends on the IV");
+            if (g1 == g2)
+                throw std::invalid_argument("IVConditions: equalities within one IV word group are not supported");
+            Bit a{w1, b1}, b{w2, b2};
+            if (g1 > g2)
+                std::swap(a, b);
+            equalities.push_back({a, b, static_cast<u8>(opposite)});
+        }
+
+        bool empty() const
+        {
+            for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+                if (fixed_mask[i])
+                    return false;
+            return equalities.empty();
+        }
+
+        // canonical text of the conditions, for cache / pool fingerprints
+        std::string fingerprint() const
+        {
+            std::ostringstream s;
+            s << std::hex;
+            for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+                if (fixed_mask[i])
+                    s << "f" << i << ":" << fixed_mask[i] << ":" << fixed_value[i] << ";";
+            for (const auto &e : equalities)
+                s << "e" << e.a.word << "." << e.a.bit << "," << e.b.word << "." << e.b.bit << ":" << int(e.value) << ";";
+            return s.str();
+        }
+
+    private:
+        static void check(u16 word, u16 bit)
+        {
+            if (word >= STATEWORD_COUNT || bit >= WORD_SIZE)
+                throw std::invalid_argument("IVConditions: bit x" + std::to_string(word) + "[" +
+                                            std::to_string(bit) + "] is out of range");
+            if (iv_group(word) < 0)
+                throw std::invalid_argument("IVConditions: word 2 is two additions away from the IV and cannot be conditioned");
+        }
+    };
+
+    /*
+     * Uniformly random y with (y & ymask) == yval and ((y + k) & smask) == sval.
+     *
+     * When no bit is conditioned both in y and in the sum, every sum condition owns its bit
+     * of y: the free bits are drawn and the wrong sum bits are then fixed from the lowest up
+     * (flipping y_j only moves the carries above j). Otherwise count[j][c], the number of
+     * completions of bits j..top with carry c into bit j, is computed and one random index
+     * below count[0][0] is unranked bit by bit.
+     */
+    bool solve_addition(u32 k, u32 ymask, u32 yval, u32 smask, u32 sval, u32 &y)
+    {
+        if (!(ymask & smask))
+        {
+            y = (RandomNumber<u32>() & ~ymask) | (yval & ymask);
+            for (u32 wrong; (wrong = ((y + k) ^ sval) & smask) != 0;)
+                y ^= wrong & (0u - wrong);
+            return true;
+        }
+        const int top = 31 - std::countl_zero(ymask | smask);
+
+        // ok[c][v] bit j: bit j may take value v when carry c comes in
+        u32 ok[2][2];
+        for (u32 c{0}; c < 2; ++c)
+            for (u32 v{0}; v < 2; ++v)
+            {
+                const u32 V = 0u - v, C = 0u - c;
+                ok[c][v] = (~ymask | ~(yval ^ V)) & (~smask | ~(sval ^ V ^ k ^ C));
+            }
+        auto pick = [](u32 okbits, int j, u64 n) { return (0ULL - ((okbits >> j) & 1u)) & n; };
+
+        u64 count[WORD_SIZE + 1][2];
+        count[top + 1][0] = count[top + 1][1] = 1;
+        for (int j = top; j >= 0; --j)
+        {
+            const u32 kj = (k >> j) & 1u;
+            const u64 *n = count[j + 1];
+            count[j][0] = pick(ok[0][0], j, n[0]) + pick(ok[0][1], j, n[kj]);
+            count[j][1] = pick(ok[1][0], j, n[kj]) + pick(ok[1][1], j, n[1]);
+        }
+        if (count[0][0] == 0)
+            return false;
+
+        u64 r = RandomNumber<u64>(0, count[0][0] - 1);
+        u32 c = 0;
+        y = (top == 31) ? 0u : (RandomNumber<u32>() & (~0u << (top + 1)));
+        for (int j = 0; j <= top; ++j)
+        {
+            const u32 kj = (k >> j) & 1u;
+            const u64 w0 = pick(ok[c][0], j, count[j + 1][kj & c]);
+            const u32 v = (r >= w0); // kept branch free: v is a coin flip
+            r -= (0ULL - v) & w0;
+            y |= v << j;
+            c = (kj & c) | (v & (kj | c));
+        }
+        return true;
+    }
+
+    /*
+     * Constants and an IV that satisfies `cond`, drawn uniformly among the satisfying IVs.
+     * The key must already be in x. Returns false when no IV works for this key (an
+     * equality against a key bit, or fixed bits whose carries contradict each other); the
+     * caller then draws a new key.
+     */
+    bool init_iv_const(u32 *x, const IVConditions &cond)
+    {
+        x[0] = 0x61707865;
+        x[5] = 0x3120646e;
+        x[10] = 0x79622d36;
+        x[15] = 0x6b206574;
+
+        u32 h[STATEWORD_COUNT]; // state after the first half-round, filled group by group
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            h[i] = x[i];
+        h[3] = x[3] ^ ROTATE_LEFT(x[15] + x[11], 7);
+        h[4] = x[4] ^ ROTATE_LEFT(x[0] + x[12], 7);
+
+        u32 mask[STATEWORD_COUNT], value[STATEWORD_COUNT];
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            mask[i] = cond.fixed_mask[i];
+            value[i] = cond.fixed_value[i];
+        }
+
+        // equalities whose later bit is in `group` become fixed bits
+        auto pin = [&](int group)
+        {
+            for (const auto &e : cond.equalities)
+            {
+                if (iv_group(e.b.word) != group)
+                    continue;
+                const u32 v = ((h[e.a.word] >> e.a.bit) & 1u) ^ e.value;
+                const u32 m = 1u << e.b.bit;
+                if ((mask[e.b.word] & m) && (((value[e.b.word] >> e.b.bit) & 1u) != v))
+                    return false;
+                mask[e.b.word] |= m;
+                value[e.b.word] = (value[e.b.word] & ~m) | (v << e.b.bit);
+            }
+            return true;
+        };
+
+        u32 y;
+
+        // x9' = y, x13' = x13 ^ ((y + x5) <<< 9)
+        if (!pin(1) || !solve_addition(x[5], mask[9], value[9], ROTATE_RIGHT(mask[13], 9),
+                                       ROTATE_RIGHT((value[13] ^ x[13]) & mask[13], 9), y))
+            return false;
+        h[9] = y;
+        h[13] = x[13] ^ ROTATE_LEFT(y + x[5], 9);
+        x[9] = y ^ ROTATE_LEFT(x[5] + x[1], 7);
+
+        // x6' = x6 = y, x14' = x14 ^ ((x10 + y) <<< 7)
+        if (!pin(2) || !solve_addition(x[10], mask[6], value[6], ROTATE_RIGHT(mask[14], 7),
+                                       ROTATE_RIGHT((value[14] ^ x[14]) & mask[14], 7), y))
+            return false;
+        h[6] = x[6] = y;
+        h[14] = x[14] ^ ROTATE_LEFT(x[10] + y, 7);
+
+        // x7' = x7 ^ ((x3' + x15) <<< 9)
+        if (!pin(3))
+            return false;
+        h[7] = (RandomNumber<u32>() & ~mask[7]) | value[7];
+        x[7] = h[7] ^ ROTATE_LEFT(h[3] + x[15], 9);
+
+        // x8' = x8 ^ ((x4' + x0) <<< 9)
+        if (!pin(4))
+            return false;
+        h[8] = (RandomNumber<u32>() & ~mask[8]) | value[8];
+        x[8] = h[8] ^ ROTATE_LEFT(h[4] + x[0], 9);
+
+        return true;
+    }
 }
 // namespace Salsa
@@ -0,0 +1,294 @@
+/*
+ * REFERENCE IMPLEMENTATION OF sample pool header file
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ *
+ * Synopsis:
+ * A sample pool is a file of precomputed forward halves (pnbkernel::ForwardSample: key, IV,
+ * Z, Z' and fwd_parity) for one (ID, mask, rounds) configuration. Programs map it read-only and
+ * stream it instead of recomputing the forward half, so a repeated analysis of the same
+ * distinguisher only pays for the backward half and the memory bandwidth.
+ *
+ * File layout (native little-endian):
+ *   [0, HEADER_BYTES)  Header, zero padded (records start page aligned)
+ *   [HEADER_BYTES, ..) count x ForwardSample
+ *
+ * The magic is written last, so an interrupted generation never looks like a valid pool.
+ */
+
+#pragma once
+#include "pnbkernel.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace samplepool
+{
+    constexpr char MAGIC[8] = {'P', 'N', 'B', 'P', 'O', 'O', 'L', '1'};
+    constexpr u32 VERSION = 3;
+    constexpr u64 HEADER_BYTES = 4096;
+    constexpr u64 PREFETCH_RECORDS = 1ULL << 14; // ~3 MB of records per readahead hint
+
+    static_assert(std::is_trivially_copyable_v<pnbkernel::ForwardSample>, "records are stored raw");
+
+    struct Header
+    {
+        char magic[8];
+        u32 version;
+        u32 record_size; // sizeof(pnbkernel::ForwardSample) of the writer
+        u64 count;       // number of records
+        u32 key_size;    // 128 / 256
+        u32 fwd_halves;
+        u32 total_halves;
+        u32 id_words[STATEWORD_COUNT];
+        u32 mask_words[STATEWORD_COUNT];
+        u64 iv_conditions; // RoundPlan::iv_conditions_id, 0 = random IVs
+        u32 cipher;        // arx::CipherId
+    };
+
+    static_assert(sizeof(Header) <= HEADER_BYTES, "pool header does not fit");
+
+    inline Header makeHeader(const pnbkernel::RoundPlan &plan, u64 count)
+    {
+        Header h{};
+        h.version = VERSION;
+        h.record_size = sizeof(pnbkernel::ForwardSample);
+        h.count = count;
+        h.key_size = plan.key_128 ? 128 : 256;
+        h.fwd_halves = static_cast<u32>(plan.fwd_halves);
+        h.total_halves = static_cast<u32>(plan.total_halves);
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            h.id_words[i] = plan.id_words[i];
+            h.mask_words[i] = plan.mask_words[i];
+        }
+        h.iv_conditions = plan.iv_conditions_id;
+        h.cipher = static_cast<u32>(plan.cipher);
+        return h;
+    }
+
+    // empty if the pool was generated for `plan`, otherwise what differs
+    inline std::string mismatch(const Header &h, const pnbkernel::RoundPlan &plan)
+    {
+        const Header want = makeHeader(plan, h.count);
+        if (h.cipher != want.cipher)
+            return "cipher";
+        if (h.record_size != want.record_size)
+            return "record size " + std::to_string(h.record_size) + " (expected " + std::to_string(want.record_size) + ")";
+        if (h.key_size != want.key_size)
+            return "key size " + std::to_string(h.key_size);
+        if (h.fwd_halves != want.fwd_halves)
+            return "distinguishing round " + std::to_string(h.fwd_halves / 2.0);
+        if (h.total_halves != want.total_halves)
+            return "total rounds " + std::to_string(h.total_halves / 2.0);
+        if (h.iv_conditions != want.iv_conditions)
+            return "chosen-IV conditions";
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            if (h.id_words[i] != want.id_words[i])
+                return "input difference (word " + std::to_string(i) + ")";
+            if (h.mask_words[i] != want.mask_words[i])
+                return "output mask (word " + std::to_string(i) + ")";
+        }
+        return {};
+    }
+
+    inline std::string errnoText(const std::string &what, const std::string &path)
+    {
+        return what + " " + path + ": " + std::strerror(errno);
+    }
+
+    /**
+     * Read-only mapping of a pool file. Throws std::runtime_error when the file cannot be
+     * mapped or is not a complete pool.
+     */
+    class Pool
+    {
+    public:
+        explicit Pool(const std::string &path) : path_(path)
+        {
+            fd_ = ::open(path.c_str(), O_RDONLY);
+            if (fd_ < 0)
+                throw std::runtime_error(errnoText("samplepool: cannot open", path));
+
+            struct stat st{};
+            if (::fstat(fd_, &st) != 0)
+            {
+                ::close(fd_);
+                throw std::runtime_error(errnoText("samplepool: cannot stat", path));
+            }
+            bytes_ = static_cast<u64>(st.st_size);
+            if (bytes_ < HEADER_BYTES)
+            {
+                ::close(fd_);
+                throw std::runtime_error("samplepool: " + path + " is too small to be a pool");
+            }
+
+            void *p = ::mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd_, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(fd_);
+                throw std::runtime_error(errnoText("samplepool: cannot map", path));
+            }
+            base_ = static_cast<const unsigned char *>(p);
+            ::madvise(p, bytes_, MADV_SEQUENTIAL);
+
+            std::memcpy(&header_, base_, sizeof(Header));
+            if (std::memcmp(header_.magic, MAGIC, sizeof(MAGIC)) != 0 || header_.version != VERSION ||
+                header_.record_size != sizeof(pnbkernel::ForwardSample) ||
+                HEADER_BYTES + header_.count * header_.record_size > bytes_)
+            {
+                release();
+                throw std::runtime_error("samplepool: " + path + " is not a complete version " +
+                                         std::to_string(VERSION) + " pool");
+            }
+        }
+
+        Pool(const Pool &) = delete;
+        Pool &operator=(const Pool &) = delete;
+        ~Pool() { release(); }
+
+        const Header &header() const { return header_; }
+        const std::string &path() const { return path_; }
+        u64 size() const { return header_.count; }
+        u64 bytes() const { return bytes_; }
+
+        const pnbkernel::ForwardSample *records() const
+        {
+            return reinterpret_cast<const pnbkernel::ForwardSample *>(base_ + HEADER_BYTES);
+        }
+
+        // readahead hint for records [first, first + count)
+        void willNeed(u64 first, u64 count) const
+        {
+            if (first >= size())
+                return;
+            count = std::min(count, size() - first);
+
+            const u64 page = static_cast<u64>(::sysconf(_SC_PAGESIZE));
+            u64 lo = HEADER_BYTES + first * sizeof(pnbkernel::ForwardSample);
+            const u64 hi = lo + count * sizeof(pnbkernel::ForwardSample);
+            lo -= lo % page;
+            ::madvise(const_cast<unsigned char *>(base_) + lo, hi - lo, MADV_WILLNEED);
+        }
+
+        // f(record) for records [first, first + count), one readahead hint ahead of the reader
+        template <class F>
+        void forEach(u64 first, u64 count, F &&f) const
+        {
+            const pnbkernel::ForwardSample *r = records();
+            willNeed(first, PREFETCH_RECORDS);
+            for (u64 i{0}; i < count; ++i)
+            {
+                if ((i % PREFETCH_RECORDS) == 0)
+                    willNeed(first + i + PREFETCH_RECORDS, PREFETCH_RECORDS);
+                f(r[first + i]);
+            }
+        }
+
+    private:
+        void release()
+        {
+            if (base_)
+                ::munmap(const_cast<unsigned char *>(base_), bytes_);
+            if (fd_ >= 0)
+                ::close(fd_);
+            base_ = nullptr;
+            fd_ = -1;
+        }
+
+        std::string path_;
+        int fd_ = -1;
+        u64 bytes_ = 0;
+        const unsigned char *base_ = nullptr;
+        Header header_{};
+    };
+
+    /**
+     * Writable mapping of a new pool of `count` records. Fill records(), then finish()
+     * writes the header. Throws std::runtime_error on I/O errors.
+     */
+    class PoolWriter
+    {
+    public:
+        PoolWriter(const std::string &path, const pnbkernel::RoundPlan &plan, u64 count)
+            : path_(path), header_(makeHeader(plan, count))
+        {
+            bytes_ = HEADER_BYTES + count * sizeof(pnbkernel::ForwardSample);
+
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd_ < 0)
+                throw std::runtime_error(errnoText("samplepool: cannot create", path));
+            if (::ftruncate(fd_, static_cast<off_t>(bytes_)) != 0)
+            {
+                ::close(fd_);
+                throw std::runtime_error(errnoText("samplepool: cannot size", path));
+            }
+
+            void *p = ::mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(fd_);
+                throw std::runtime_error(errnoText("samplepool: cannot map", path));
+            }
+            base_ = static_cast<unsigned char *>(p);
+            ::madvise(p, bytes_, MADV_SEQUENTIAL);
+        }
+
+        PoolWriter(const PoolWriter &) = delete;
+        PoolWriter &operator=(const PoolWriter &) = delete;
+        ~PoolWriter() { release(); }
+
+        u64 size() const { return header_.count; }
+        u64 bytes() const { return bytes_; }
+
+        pnbkernel::ForwardSample *records()
+        {
+            return reinterpret_cast<pnbkernel::ForwardSample *>(base_ + HEADER_BYTES);
+        }
+
+        // records are flushed before the header, so a crash leaves no magic behind
+        void finish()
+        {
+            if (::msync(base_, bytes_, MS_SYNC) != 0)
+                throw std::runtime_error(errnoText("samplepool: cannot flush", path_));
+
+            std::memcpy(header_.magic, MAGIC, sizeof(MAGIC));
+            std::memcpy(base_, &header_, sizeof(Header));
+            if (::msync(base_, HEADER_BYTES, MS_SYNC) != 0)
+                throw std::runtime_error(errnoText("samplepool: cannot flush", path_));
+        }
+
+    private:
+        void release()
+        {
+            if (base_)
+                ::munmap(base_, bytes_);
+            if (fd_ >= 0)
+                ::close(fd_);
+            base_ = nullptr;
+            fd_ = -1;
+        }
+
+        std::string path_;
+        int fd_ = -1;
+        u64 bytes_ = 0;
+        unsigned char *base_ = nullptr;
+        Header header_{};
+    };
+}
@@ -0,0 +1,521 @@
+/*
+ * REFERENCE IMPLEMENTATION OF a scaled-down PNB key-recovery simulator
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * End-to-end check of a PNB set. A random secret key is fixed and N keystream block pairs
+ * (IV, IV ^ ID) are generated under the configured rounds. g non-PNB bits are guessed; the other
+ * non-PNBs are fixed to their true values so the search stays tractable, and the PNBs are set
+ * to a fixed value (the approximation of the attack). For every guess the backward bias
+ *   eps(guess) = 2 Pr[backward parity == 0] - 1
+ * is measured over the N blocks and the guesses are ranked by the score eps(guess) * sign(eps),
+ * eps the predicted bias (a wrong guess can flip the parity and show -eps). The rank of the
+ * correct guess tells whether the PNB set recovers key bits at the predicted data complexity.
+ * Guesses that differ only in bits that are neutral in practice tie with the correct one; the
+ * rank counts strictly better guesses and the ties are reported separately.
+ *
+ * Guesses are split across the worker threads, 16 guesses share one lane-batched backward
+ * pass, and a guess is abandoned once its running score is more than `z` standard errors below
+ * the predicted |eps| (it can no longer be the right key, with error probability ~ Phi(-z)).
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native keyrecovery.cpp -o keyrec
+ *   ./keyrec <pnb_file|-> [guess_bits] [log2_blocks] [eps=<predicted bias>] [z=<abort z-score>] [log]
+ *
+ *   eps : predicted (signed) eps_a * eps_d; estimated on N random-key samples when not given
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + forward/backward sample kernel
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+pnbinfo::PNBdetails pnb_config;
+
+constexpr size_t LANES = 16;   // guesses per backward batch
+constexpr size_t CHUNKS = 16;  // early-abort checks per guess
+
+static atomic<u64> progress{0};
+
+struct RecoveryOptions
+{
+    string pnb_file = "-";
+    int guess_bits = 8;
+    int log2_blocks = 16;
+    double eps = 0.0; // 0 = estimate
+    double z_abort = 3.0;
+};
+
+// shared, read-only state of the simulated attack
+struct Attack
+{
+    u32 secret[KEYWORD_COUNT];
+    u32 pnb_mask[KEYWORD_COUNT];
+    vector<u16> guess_bits;                 // non-PNBs that are guessed
+    vector<pnbkernel::ForwardSample> blocks; // keystream pairs (fwd_parity unused)
+    double eps = 0.0;                        // predicted (signed) bias
+    double z_abort = 3.0;
+};
+
+struct GuessResult
+{
+    u32 guess = 0;
+    u64 hits = 0;   // backward parity == 0
+    u64 blocks = 0; // blocks processed before finishing / aborting
+    bool aborted = false;
+
+    double bias() const { return stats::biasFromCount(hits, blocks); }
+    double score(double eps) const { return eps < 0 ? -bias() : bias(); }
+};
+
+vector<GuessResult> guessrange(const Attack *attack, u32 first, u32 last);
+
+static void parse_cli(int argc, char *argv[], RecoveryOptions &opt)
+{
+    if (argc >= 2)
+        opt.pnb_file = argv[1];
+
+    auto read_int = [](const char *arg, const char *what, int lo, int hi, int fallback)
+    {
+        try
+        {
+            int v = std::stoi(arg);
+            if (v < lo || v > hi)
+            {
+                std::cerr << what << " must be in [" << lo << "," << hi << "]. Using default " << fallback << ".\n";
+                return fallback;
+            }
+            return v;
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid " << what << " input. Using default " << fallback << ".\n";
+            return fallback;
+        }
+    };
+
+    if (argc >= 3)
+        opt.guess_bits = read_int(argv[2], "guess_bits", 1, 24, 8);
+    if (argc >= 4)
+        opt.log2_blocks = read_int(argv[3], "log2_blocks", 8, 30, 16);
+
+    for (int i = 4; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        try
+        {
+            if (flag == "log" || flag == "1")
+                basic_config.logfile_flag = true;
+            else if (flag.rfind("eps=", 0) == 0)
+                opt.eps = std::stod(flag.substr(4));
+            else if (flag.rfind("z=", 0) == 0)
+                opt.z_abort = std::stod(flag.substr(2));
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid option " << flag << ", ignored.\n";
+        }
+    }
+}
+
+static bool init_config_and_banner(const RecoveryOptions &opt, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "KeyRecovery"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.comment = "last round modified";
+    basic_config.total_rounds = 7.5;
+
+    diff_config.distinguishing_round = 5;
+    diff_config.id = {{7, 31}};
+    diff_config.mask = {{4, 7}};
+
+    bool ok;
+    if (opt.pnb_file == "-")
+    {
+        pnb_config.pnbs = {
+            // example:
+            // 148, 149, 150, 156, 157, 158, 159, 191, 196
+        };
+        ok = pnbinfo::preparePNBFromVector(pnb_config);
+    }
+    else
+    {
+        pnb_config.pnb_file = opt.pnb_file;
+        ok = pnbinfo::preparePNBFromFile(opt.pnb_file, pnb_config, &basic_config);
+    }
+
+    if (!ok)
+    {
+        std::cerr << "ERROR: no PNBs to evaluate.\n";
+        return false;
+    }
+
+    samples_config.samples_per_batch = 1ULL << opt.log2_blocks;
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    if (!pnb_config.pnb_file.empty())
+        display::printField(dmsg, "PNB file", pnb_config.pnb_file);
+    pnbinfo::showPNBConfig(pnb_config, dmsg);
+
+    return true;
+}
+
+// secret key, guessed bits and the N keystream block pairs
+static void setup_attack(const RecoveryOptions &opt, Attack &attack, std::ostream &out)
+{
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+    const u16 key_bits = static_cast<u16>(basic_config.key_size);
+
+    salsa::InitKey init_key;
+    if (plan.key_128)
+        init_key.key_128bit(attack.secret);
+    else
+        init_key.key_256bit(attack.secret);
+
+    pnbkernel::buildKeyMask(pnb_config.pnbs, plan.key_128, attack.pnb_mask);
+
+    // g random non-PNBs are guessed, the rest keep their true value
+    vector<u16> nonpnbs;
+    for (u16 i{0}; i < key_bits; ++i)
+        if (!std::binary_search(pnb_config.pnbs.begin(), pnb_config.pnbs.end(), i))
+            nonpnbs.push_back(i);
+    std::shuffle(nonpnbs.begin(), nonpnbs.end(), thread_rng());
+    nonpnbs.resize(std::min<size_t>(opt.guess_bits, nonpnbs.size()));
+    std::sort(nonpnbs.begin(), nonpnbs.end());
+    attack.guess_bits = nonpnbs;
+
+    // ---------------- keystream block pairs under the secret key -----------------
+    const u64 n = 1ULL << opt.log2_blocks;
+    attack.blocks.resize(n);
+    u32 x0[STATEWORD_COUNT], iv[arx::IV_WORD_COUNT];
+    for (auto &b : attack.blocks)
+    {
+        for (size_t i{0}; i < arx::IV_WORD_COUNT; ++i)
+            iv[i] = RandomNumber<u32>();
+        pnbkernel::initialState(plan, x0, iv, attack.secret);
+        pnbkernel::forwardFromState(plan, x0, b);
+    }
+
+    // ---------------- predicted bias: fixed PNBs, random keys -----------------
+    attack.z_abort = opt.z_abort;
+    attack.eps = opt.eps;
+    if (attack.eps == 0.0)
+    {
+        pnbkernel::ForwardSample s;
+        u32 guess[KEYWORD_COUNT];
+        const u32 zero[KEYWORD_COUNT] = {};
+        u64 hits = 0;
+        for (u64 i{0}; i < n; ++i)
+        {
+            pnbkernel::generateSample(plan, s);
+            pnbkernel::replaceKeyBits(guess, s.key, attack.pnb_mask, zero, plan.key_128);
+            hits += (pnbkernel::backwardParity(plan, s, guess) == 0);
+        }
+        attack.eps = stats::biasFromCount(hits, n);
+    }
+
+    // Aumasson et al.: N ~ ((sqrt(alpha ln 4) + 3 sqrt(1 - eps^2)) / eps)^2 for a 2^-alpha false alarm
+    const double alpha = static_cast<double>(attack.guess_bits.size());
+    const double n_pred = std::pow((std::sqrt(alpha * std::log(4.0)) + 3.0 * std::sqrt(1.0 - attack.eps * attack.eps)) / std::fabs(attack.eps), 2.0);
+
+    int w = 0;
+    display::printField(out, "Guessed non-PNB bits", attack.guess_bits.size());
+    {
+        std::ostringstream s;
+        for (size_t i{0}; i < attack.guess_bits.size(); ++i)
+            s << (i ? ", " : "") << attack.guess_bits[i];
+        display::printField(out, "Guessed bit indices", s.str());
+    }
+    display::printField(out, "Keystream block pairs (N)", display::formatCountPow2Pow10(n));
+    display::printField(out, opt.eps == 0.0 ? "Predicted eps (estimated)" : "Predicted eps (given)",
+                        display::formatRealPow2(attack.eps, w));
+    display::printField(out, "Predicted N for success", std::isfinite(n_pred) ? display::formatCountPow2Pow10(static_cast<u64>(std::ceil(n_pred))) : "inf");
+    display::printField(out, "Early-abort z-score", attack.z_abort);
+    out << basic_config.star_sep;
+}
+
+// the guess value that matches the secret key
+static u32 correct_guess(const Attack &attack)
+{
+    u32 v = 0;
+    for (size_t i{0}; i < attack.guess_bits.size(); ++i)
+    {
+        const u16 idx = attack.guess_bits[i];
+        v |= static_cast<u32>(GET_BIT(attack.secret[idx / WORD_SIZE], idx % WORD_SIZE)) << i;
+    }
+    return v;
+}
+
+static vector<GuessResult> run_guesses(const Attack &attack)
+{
+    const u32 guesses = 1U << attack.guess_bits.size();
+    const u32 threads = static_cast<u32>(samples_config.max_num_threads);
+    // contiguous ranges, whole lane groups per thread
+    const u32 groups = (guesses + LANES - 1) / LANES;
+    const u32 groups_per_thread = (groups + threads - 1) / threads;
+
+    progress.store(0, std::memory_order_relaxed);
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    SpinnerWithETA spinner("Enumerating guesses ...", &progress, groups);
+    spinner.start();
+    #endif
+
+    vector<std::future<vector<GuessResult>>> future_results;
+    for (u32 t{0}; t < threads; ++t)
+    {
+        const u32 first = std::min<u64>(static_cast<u64>(t) * groups_per_thread * LANES, guesses);
+        const u32 last = std::min<u64>(static_cast<u64>(t + 1) * groups_per_thread * LANES, guesses);
+        if (first < last)
+            future_results.emplace_back(async(launch::async, guessrange, &attack, first, last));
+    }
+
+    vector<GuessResult> results;
+    results.reserve(guesses);
+    try
+    {
+        for (auto &f : future_results)
+        {
+            vector<GuessResult> part = f.get();
+            results.insert(results.end(), part.begin(), part.end());
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "Thread error: " << e.what() << "\n";
+    }
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    spinner.stop();
+    #endif
+
+    // finished guesses first, then by score
+    std::sort(results.begin(), results.end(),
+              [&](const GuessResult &a, const GuessResult &b)
+              {
+                  if (a.aborted != b.aborted)
+                      return !a.aborted;
+                  const double sa = a.score(attack.eps), sb = b.score(attack.eps);
+                  if (sa != sb)
+                      return sa > sb;
+                  return a.guess < b.guess;
+              });
+    return results;
+}
+
+static void print_ranking(const Attack &attack, const vector<GuessResult> &results, std::ostream &out, size_t top = 10)
+{
+    const u32 truth = correct_guess(attack);
+
+    const GuessResult *correct = nullptr;
+    size_t aborted = 0;
+    for (const GuessResult &r : results)
+    {
+        if (r.guess == truth)
+            correct = &r;
+        aborted += r.aborted;
+    }
+
+    // a thread error leaves only partial results, which may miss the true guess
+    if (!correct)
+    {
+        out << basic_config.dash_sep;
+        display::printField(out, "Guesses", results.size());
+        display::printField(out, "Aborted early", aborted);
+        display::printField(out, "Correct guess", config::formatWord(truth) + " (not evaluated)");
+        out << basic_config.dash_sep;
+        return;
+    }
+
+    // rank = 1 + strictly better guesses; equal counts are ties
+    size_t rank = 1, ties = 0;
+    for (const GuessResult &r : results)
+    {
+        if (&r == correct)
+            continue;
+        if (!correct->aborted && r.aborted)
+            continue;
+        if (correct->aborted && !r.aborted)
+            ++rank;
+        else if (r.hits == correct->hits && r.blocks == correct->blocks)
+            ++ties;
+        else if (r.score(attack.eps) > correct->score(attack.eps))
+            ++rank;
+    }
+
+    out << basic_config.dash_sep;
+    display::printField(out, "Guesses", results.size());
+    display::printField(out, "Aborted early", aborted);
+    display::printField(out, "Correct guess", config::formatWord(truth) + (correct->aborted ? " (aborted)" : ""));
+    display::printField(out, "Rank of the correct guess", std::to_string(rank) + " / " + std::to_string(results.size()));
+    display::printField(out, "Guesses tied with it", ties);
+    display::printField(out, "Key bits recovered", (rank == 1 && !correct->aborted) ? (ties == 0 ? "yes" : "yes, up to ties") : "no");
+    out << basic_config.dash_sep;
+
+    out << "Top " << std::min(top, results.size()) << " guesses\n";
+    out << "Format: rank  guess  HD to correct  bias  blocks  status\n";
+    out << std::fixed << std::setprecision(5);
+    for (size_t i{0}; i < std::min(top, results.size()); ++i)
+    {
+        const GuessResult &r = results[i];
+        out << std::right << std::setw(5) << i + 1 << "  "
+            << config::formatWord(r.guess) << "  "
+            << std::setw(3) << std::popcount(r.guess ^ truth) << "  "
+            << std::setw(9) << r.bias() << "  "
+            << std::setw(10) << r.blocks << "  "
+            << (r.aborted ? "aborted" : (r.guess == truth ? "correct" : "")) << "\n";
+    }
+    out << std::left;
+    out << basic_config.dash_sep;
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    RecoveryOptions opt;
+    parse_cli(argc, argv, opt);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "keyrecovery";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    if (!init_config_and_banner(opt, dmsg))
+        return 1;
+
+    Attack attack;
+    setup_attack(opt, attack, dmsg);
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    vector<GuessResult> results = run_guesses(attack);
+
+    stringstream report;
+    print_ranking(attack, results, report);
+    cout << "\n" << report.str();
+    dmsg << report.str();
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = makeLogFilename(basic_config, diff_config, &pnb_config, folder);
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: guesses [first, last), LANES at a time -----------------
+vector<GuessResult> guessrange(const Attack *attack, u32 first, u32 last)
+{
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+    const u64 n = attack->blocks.size();
+    const u64 chunk = (n + CHUNKS - 1) / CHUNKS;
+
+    // the guess key: secret outside the guessed bits and PNBs, PNBs fixed to 0
+    u32 base[KEYWORD_COUNT], values[KEYWORD_COUNT] = {};
+    u32 guess_mask[KEYWORD_COUNT];
+    pnbkernel::buildKeyMask(attack->guess_bits, plan.key_128, guess_mask);
+    for (size_t w{0}; w < KEYWORD_COUNT; ++w)
+        base[w] = attack->secret[w] & ~guess_mask[w];
+    pnbkernel::replaceKeyBits(base, base, attack->pnb_mask, values, plan.key_128);
+
+    vector<GuessResult> results;
+    results.reserve(last - first);
+
+    u32 keys[LANES][KEYWORD_COUNT];
+
+    for (u32 g0{first}; g0 < last; g0 += LANES)
+    {
+        const size_t lanes = std::min<size_t>(LANES, last - g0);
+        GuessResult r[LANES];
+        for (size_t l{0}; l < LANES; ++l)
+        {
+            r[l].guess = g0 + static_cast<u32>(l);
+            ops::copyState(keys[l], base, 0, KEYWORD_COUNT);
+            if (l >= lanes)
+                continue;
+            for (size_t i{0}; i < attack->guess_bits.size(); ++i)
+            {
+                if (GET_BIT(r[l].guess, i))
+                    pnbkernel::toggleKeyBit(keys[l], attack->guess_bits[i], plan.key_128);
+            }
+        }
+
+        // ---------------- blocks in chunks, with an abort check after each chunk -----------------
+        size_t active = lanes;
+        for (u64 b0{0}; b0 < n && active > 0; b0 += chunk)
+        {
+            const u64 b1 = std::min(n, b0 + chunk);
+            for (u64 b{b0}; b < b1; ++b)
+            {
+                const u64 parities = pnbkernel::backwardParityLanes<LANES>(plan, attack->blocks[b], keys);
+                for (size_t l{0}; l < lanes; ++l)
+                    r[l].hits += !r[l].aborted & !((parities >> l) & 1);
+            }
+
+            for (size_t l{0}; l < lanes; ++l)
+            {
+                if (r[l].aborted)
+                    continue;
+                r[l].blocks = b1;
+                // under "right key" the running score is ~ N(|eps|, 1/n); far below it -> hopeless
+                const double running = r[l].score(attack->eps);
+                if (b1 < n && running < std::fabs(attack->eps) - attack->z_abort / std::sqrt(static_cast<double>(b1)))
+                {
+                    r[l].aborted = true;
+                    --active;
+                }
+            }
+        }
+
+        for (size_t l{0}; l < lanes; ++l)
+            results.push_back(r[l]);
+
+        progress.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return results;
+}
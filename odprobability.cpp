@@ -0,0 +1,280 @@
+/*
+ * REFERENCE IMPLEMENTATION OF an output-difference probability estimator
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * Estimates the probability that the input difference ID leads to the output difference at
+ * the distinguishing round, Pr[X ^ X' matches OD]. OD is DLInfo::output_diff_str (hex or
+ * binary, '*' for bits that may take any value), or DLInfo::od (every listed bit set, every
+ * other bit clear) when the string is empty. This is the differential counterpart of the
+ * linear-mask bias the PNB programs measure.
+ *
+ * The pattern is compiled once into per-word (mask, value) pairs
+ * (ops::compileWildcardPattern), so a match is a handful of AND/XOR/OR steps. Samples run
+ * LANES at a time in pnbkernel::LaneState, and only the forward half up to the
+ * distinguishing round is computed.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native odprobability.cpp -o odprob
+ *   ./odprob [log2_samples] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + lane-batched state
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+
+constexpr size_t LANES = 16; // samples per batch
+
+static atomic<u64> progress{0};
+
+struct ODOptions
+{
+    int log2_samples = 24;
+};
+
+template <class C>
+u64 odcount(const ops::WildcardPattern<STATEWORD_COUNT> *od, u64 batches);
+
+static void parse_cli(int argc, char *argv[], ODOptions &opt)
+{
+    if (argc >= 2)
+    {
+        try
+        {
+            opt.log2_samples = std::stoi(argv[1]);
+            if (opt.log2_samples < 8 || opt.log2_samples > 40)
+            {
+                std::cerr << "log2_samples must be in [8,40]. Using default 24.\n";
+                opt.log2_samples = 24;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_samples input. Using default 24.\n";
+            opt.log2_samples = 24;
+        }
+    }
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        if (flag == "log" || flag == "1")
+            basic_config.logfile_flag = true;
+    }
+}
+
+static void init_config_and_banner(const ODOptions &opt, const ops::WildcardPattern<STATEWORD_COUNT> &od,
+                                   std::stringstream &dmsg)
+{
+    samples_config.samples_per_batch = 1ULL << opt.log2_samples;
+    samples_config.samples_per_thread =
+        (samples_config.samples_per_batch + samples_config.max_num_threads - 1) / samples_config.max_num_threads;
+    samples_config.samples_per_thread = (samples_config.samples_per_thread + LANES - 1) / LANES * LANES;
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    display::printField(dmsg, "Fixed bits in OD", od.fixedBits());
+    dmsg << basic_config.star_sep;
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    ODOptions opt;
+    parse_cli(argc, argv, opt);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "odprob";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "ODProbability"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.total_rounds = 1;
+
+    diff_config.distinguishing_round = 1;
+    diff_config.id = {{7, 31}};
+    diff_config.od = {{7, 31}, {11, 12}, {15, 17}, {15, 30}};
+    // or a pattern with wildcards (hex: '*' = 4 free bits), e.g. the top nibble of x15 left free:
+    // diff_config.output_diff_str = "0x" + string(56, '0') + "80000000" + string(24, '0') +
+    //                               "00001000" + string(24, '0') + "*0020000";
+
+    ops::WildcardPattern<STATEWORD_COUNT> od;
+    arx::CipherId cipher;
+    try
+    {
+        od = pnbkernel::makeOutputPattern(diff_config, basic_config);
+        cipher = pnbkernel::makeRoundPlan(basic_config, diff_config).cipher;
+    }
+    catch (const exception &e)
+    {
+        cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    init_config_and_banner(opt, od, dmsg);
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    const u64 batches = samples_config.samples_per_thread / LANES;
+    const u64 samples = samples_config.samples_per_thread * samples_config.max_num_threads;
+
+    progress.store(0, std::memory_order_relaxed);
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    SpinnerWithETA spinner("Counting OD matches ...", &progress, samples);
+    spinner.start();
+    #endif
+
+    vector<std::future<u64>> future_results;
+    future_results.reserve(samples_config.max_num_threads);
+
+    for (u16 thread_number{0}; thread_number < samples_config.max_num_threads; ++thread_number)
+        future_results.emplace_back(arx::dispatch(cipher, [&](auto c)
+                                                  { return async(launch::async, odcount<decltype(c)>, &od, batches); }));
+
+    u64 hits = 0;
+    try
+    {
+        for (auto &f : future_results)
+            hits += f.get();
+    }
+    catch (const exception &e)
+    {
+        cerr << "Thread error: " << e.what() << "\n";
+        return 1;
+    }
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    spinner.stop();
+    #endif
+
+    // ---------------- probability with a normal-approximation 95% interval -----------------
+    const double p = static_cast<double>(hits) / samples;
+    const double half = stats::Z95 * std::sqrt(p * (1.0 - p) / samples);
+    auto neglog2 = [](double v)
+    { return v > 0.0 ? -std::log2(v) : std::numeric_limits<double>::infinity(); };
+
+    stringstream report;
+    report << basic_config.dash_sep;
+    display::printField(report, "Matches", std::to_string(hits) + " / " + display::formatCountPow2Pow10(samples));
+    {
+        std::ostringstream s;
+        s << std::scientific << std::setprecision(4) << p << "  (95% CI " << std::max(0.0, p - half)
+          << " .. " << std::min(1.0, p + half) << ")";
+        display::printField(report, "Pr[OD | ID]", s.str());
+    }
+    {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(3) << neglog2(p) << "  (95% CI " << neglog2(std::min(1.0, p + half))
+          << " .. " << neglog2(std::max(0.0, p - half)) << ")";
+        display::printField(report, "-log2 Pr", s.str());
+    }
+    if (hits == 0)
+        report << "No match: the probability is below about 2^-" << std::fixed << std::setprecision(1)
+               << std::log2(static_cast<double>(samples)) << ".\n";
+    report << basic_config.dash_sep;
+
+    cout << "\n" << report.str();
+    dmsg << report.str();
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = pnbinfo::makeLogFilename(basic_config, diff_config, nullptr, folder);
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: OD matches among `batches` x LANES samples -----------------
+template <class C>
+u64 odcount(const ops::WildcardPattern<STATEWORD_COUNT> *od, u64 batches)
+{
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+
+    salsa::InitKey init_key;
+    u32 x0[STATEWORD_COUNT], key[KEYWORD_COUNT], iv[arx::IV_WORD_COUNT];
+    pnbkernel::LaneState<LANES> x, dx;
+    u64 hits = 0;
+
+    for (u64 batch{0}; batch < batches; ++batch)
+    {
+        // ---------------- cipher setup, one sample per lane -----------------
+        for (size_t l{0}; l < LANES; ++l)
+        {
+            for (size_t i{0}; i < arx::IV_WORD_COUNT; ++i)
+                iv[i] = RandomNumber<u32>();
+            if (plan.key_128)
+                init_key.key_128bit(key);
+            else
+                init_key.key_256bit(key);
+            pnbkernel::initialState<C>(x0, iv, key);
+
+            for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            {
+                x.w[i][l] = x0[i];
+                dx.w[i][l] = x0[i] ^ plan.id_words[i];
+            }
+        }
+
+        // ---------------- forward to the distinguishing round -----------------
+        for (int h{1}; h <= plan.fwd_halves; ++h)
+        {
+            pnbkernel::laneForwardHalf<LANES, C>(x, h);
+            pnbkernel::laneForwardHalf<LANES, C>(dx, h);
+        }
+
+        hits += std::popcount(pnbkernel::laneMatchPattern(x, dx, *od));
+
+        if ((batch & 0xff) == 0xff)
+            progress.fetch_add(0x100 * LANES, std::memory_order_relaxed);
+    }
+    progress.fetch_add((batches & 0xff) * LANES, std::memory_order_relaxed);
+
+    return hits;
+}
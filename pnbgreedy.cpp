@@ -0,0 +1,395 @@
+/*
+ * REFERENCE IMPLEMENTATION OF greedy / beam-search PNB set construction
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * Threshold selection on single-bit biases ignores how PNBs interact. This program grows the
+ * PNB set one bit at a time instead: at every step each set in the beam is extended by every
+ * candidate bit, all extensions are evaluated jointly (all PNBs randomised at once) on the same
+ * samples, and the `beam_width` sets with the largest |eps_a| are kept (ties broken by the
+ * smaller set, so runs are reproducible). Beam width 1 is plain greedy.
+ *
+ * The evaluation of one step is pnbkernel::countSetMatches(): one forward half per sample,
+ * one backward half per candidate set, samples split across the worker threads.
+ *
+ * Output: the bias curve eps_a(k), eps_a(k) * eps_d as a function of the set size k.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 pnbgreedy.cpp -o greedy && ./greedy <max_size> [beam_width] [log2_samples] [cand=<file>] [log]
+ *
+ *   cand=<file> : restrict candidate bits to a PNB list (e.g. a low-threshold run_search result)
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + forward/backward sample kernel
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <map>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+pnbinfo::PNBdetails pnb_config;
+
+static atomic<u64> progress{0};
+
+struct GreedyOptions
+{
+    size_t max_size = 32;
+    size_t beam_width = 1;
+    int log2_samples = 16; // samples per step, shared by all candidates of the step
+    string candidate_file;
+};
+
+// one point of the bias curve
+struct CurvePoint
+{
+    size_t size = 0;
+    stats::BiasEstimate eps_a;
+    stats::BiasEstimate eps_d;
+    vector<u16> pnbs;
+};
+
+struct StepCounts
+{
+    vector<u64> matches;
+    u64 d_hits = 0;
+};
+
+StepCounts stepcount(const vector<pnbkernel::KeyMask> *masks, u64 samples);
+
+static void parse_cli(int argc, char *argv[], GreedyOptions &opt)
+{
+    auto read_number = [](const char *arg, const char *what, long lo, long hi, long fallback)
+    {
+        try
+        {
+            long v = std::stol(arg);
+            if (v < lo || v > hi)
+            {
+                std::cerr << what << " must be in [" << lo << "," << hi << "]. Using default " << fallback << ".\n";
+                return fallback;
+            }
+            return v;
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid " << what << " input. Using default " << fallback << ".\n";
+            return fallback;
+        }
+    };
+
+    if (argc >= 2)
+        opt.max_size = static_cast<size_t>(read_number(argv[1], "max_size", 1, 256, 32));
+    if (argc >= 3)
+        opt.beam_width = static_cast<size_t>(read_number(argv[2], "beam_width", 1, 64, 1));
+    if (argc >= 4)
+        opt.log2_samples = static_cast<int>(read_number(argv[3], "log2_samples", 8, 30, 16));
+
+    for (int i = 4; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        if (flag.rfind("cand=", 0) == 0)
+        {
+            opt.candidate_file = flag.substr(5);
+            continue;
+        }
+
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        if (flag == "log" || flag == "1")
+            basic_config.logfile_flag = true;
+    }
+}
+
+// candidate bits of the search; empty when cand=<file> could not be loaded
+static vector<u16> init_config_and_banner(const GreedyOptions &opt, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "PNBgreedy"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.comment = "last round modified";
+    basic_config.total_rounds = 7.5;
+
+    diff_config.distinguishing_round = 5;
+    diff_config.id = {{7, 31}};
+    diff_config.mask = {{4, 7}};
+
+    samples_config.samples_per_batch = 1ULL << opt.log2_samples;
+    samples_config.samples_per_thread =
+        (samples_config.samples_per_batch + samples_config.max_num_threads - 1) / samples_config.max_num_threads;
+
+    const u16 key_bits = static_cast<u16>(basic_config.key_size);
+
+    // candidate bits: a loaded list, otherwise every key bit
+    vector<u16> candidates;
+    if (!opt.candidate_file.empty())
+    {
+        // an unreadable list must not widen the search to every key bit
+        if (!pnbinfo::preparePNBFromFile(opt.candidate_file, pnb_config, &basic_config))
+        {
+            std::cerr << "ERROR: could not load the candidate bits from " << opt.candidate_file << ".\n";
+            return candidates;
+        }
+        pnb_config.pnb_file = opt.candidate_file;
+        for (u16 p : pnb_config.pnbs)
+            if (p < key_bits)
+                candidates.push_back(p);
+    }
+    else
+    {
+        for (u16 p{0}; p < key_bits; ++p)
+            candidates.push_back(p);
+    }
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    display::printField(dmsg, "Beam width", opt.beam_width);
+    display::printField(dmsg, "Max PNB set size", opt.max_size);
+    display::printField(dmsg, "Candidate bits", candidates.size());
+    if (!pnb_config.pnb_file.empty())
+        display::printField(dmsg, "Candidate file", pnb_config.pnb_file);
+    dmsg << basic_config.star_sep;
+
+    return candidates;
+}
+
+// evaluates every mask on the same 2^log2_samples samples, split across threads
+static StepCounts evaluate_step(const vector<pnbkernel::KeyMask> &masks)
+{
+    StepCounts total;
+    total.matches.assign(masks.size(), 0);
+
+    vector<std::future<StepCounts>> future_results;
+    future_results.reserve(samples_config.max_num_threads);
+
+    for (u16 thread_number{0}; thread_number < samples_config.max_num_threads; ++thread_number)
+        future_results.emplace_back(async(launch::async, stepcount, &masks, static_cast<u64>(samples_config.samples_per_thread)));
+
+    try
+    {
+        for (auto &f : future_results)
+        {
+            StepCounts c = f.get();
+            for (size_t m{0}; m < masks.size(); ++m)
+                total.matches[m] += c.matches[m];
+            total.d_hits += c.d_hits;
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "Thread error: " << e.what() << "\n";
+    }
+
+    return total;
+}
+
+static vector<CurvePoint> run_beam_search(const GreedyOptions &opt, const vector<u16> &candidates)
+{
+    const bool key_128 = (basic_config.key_size == 128);
+    const u64 n = samples_config.samples_per_thread * samples_config.max_num_threads;
+    const size_t max_size = std::min(opt.max_size, candidates.size());
+
+    vector<CurvePoint> curve;
+    vector<vector<u16>> beam{{}};
+
+    progress.store(0, std::memory_order_relaxed);
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    SpinnerWithETA spinner("Growing PNB set ...", &progress, max_size);
+    spinner.start();
+    #endif
+
+    for (size_t size{1}; size <= max_size; ++size)
+    {
+        // ---------------- all distinct one-bit extensions of the beam -----------------
+        std::map<vector<u16>, size_t> seen;
+        vector<vector<u16>> sets;
+        vector<pnbkernel::KeyMask> masks;
+
+        for (const auto &base : beam)
+        {
+            for (u16 c : candidates)
+            {
+                if (std::binary_search(base.begin(), base.end(), c))
+                    continue;
+
+                vector<u16> ext = base;
+                ext.insert(std::upper_bound(ext.begin(), ext.end(), c), c);
+                if (seen.emplace(ext, sets.size()).second)
+                {
+                    masks.push_back(pnbkernel::makeKeyMask(ext, key_128));
+                    sets.push_back(std::move(ext));
+                }
+            }
+        }
+
+        if (sets.empty())
+            break;
+
+        StepCounts counts = evaluate_step(masks);
+
+        // ---------------- keep the beam_width best extensions -----------------
+        // ranked by |eps_a| (|2 * matches - n|) like the search; equal ones by the set itself
+        auto strength = [&](size_t i)
+        {
+            const u64 twice = 2 * counts.matches[i];
+            return twice > n ? twice - n : n - twice;
+        };
+        vector<size_t> order(sets.size());
+        for (size_t i{0}; i < order.size(); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(),
+                  [&](size_t a, size_t b)
+                  {
+                      const u64 sa = strength(a), sb = strength(b);
+                      return sa != sb ? sa > sb : sets[a] < sets[b];
+                  });
+
+        beam.clear();
+        for (size_t i{0}; i < std::min(opt.beam_width, order.size()); ++i)
+            beam.push_back(sets[order[i]]);
+
+        CurvePoint p;
+        p.size = size;
+        p.eps_a = {counts.matches[order[0]], n};
+        p.eps_d = {counts.d_hits, n};
+        p.pnbs = sets[order[0]];
+        curve.push_back(std::move(p));
+
+        progress.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    spinner.stop();
+    #endif
+
+    return curve;
+}
+
+static void print_curve(const vector<CurvePoint> &curve, std::ostream &out)
+{
+    out << basic_config.dash_sep;
+    out << "Bias curve (best set of each size, all PNBs randomised jointly)\n";
+    out << "Format: size  eps_a  (95% CI)  eps_a*eps_d  -log2|eps_a*eps_d|  added bit\n";
+    out << basic_config.dash_sep;
+
+    for (size_t i{0}; i < curve.size(); ++i)
+    {
+        const CurvePoint &p = curve[i];
+        const double eps = p.eps_a.bias() * p.eps_d.bias();
+
+        // the bit added at this step (the best set of size k need not extend the best of size k-1)
+        int added = -1;
+        if (i == 0)
+            added = p.pnbs[0];
+        else
+        {
+            vector<u16> diff;
+            std::set_difference(p.pnbs.begin(), p.pnbs.end(),
+                                curve[i - 1].pnbs.begin(), curve[i - 1].pnbs.end(),
+                                std::back_inserter(diff));
+            if (diff.size() == 1)
+                added = diff[0];
+        }
+
+        out << std::right << std::fixed << std::setprecision(5)
+            << std::setw(5) << p.size << "  "
+            << std::setw(9) << p.eps_a.bias() << "  "
+            << "(" << std::setw(8) << p.eps_a.lower() << ", " << std::setw(8) << p.eps_a.upper() << ")  "
+            << std::setw(9) << eps << "  "
+            << std::setprecision(2) << std::setw(6) << (eps == 0.0 ? std::numeric_limits<double>::infinity() : -std::log2(std::fabs(eps))) << "  ";
+        if (added >= 0)
+            out << added;
+        else
+            out << "(beam switch)";
+        out << "\n";
+    }
+    out << std::left;
+
+    if (!curve.empty())
+    {
+        out << basic_config.dash_sep;
+        out << curve.back().pnbs.size() << " PNBs in the largest set (sorted by index)\n";
+        pnbinfo::print_braced_list(curve.back().pnbs, out);
+    }
+    out << basic_config.dash_sep;
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    GreedyOptions opt;
+    parse_cli(argc, argv, opt);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "greedy";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    vector<u16> candidates = init_config_and_banner(opt, dmsg);
+    if (candidates.empty())
+        return 1;
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    vector<CurvePoint> curve = run_beam_search(opt, candidates);
+
+    stringstream report;
+    print_curve(curve, report);
+    cout << "\n" << report.str();
+    dmsg << report.str();
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = pnbinfo::makeLogFilename(basic_config, diff_config, nullptr, folder);
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: joint counts of every candidate set on this thread's samples -----------------
+StepCounts stepcount(const vector<pnbkernel::KeyMask> *masks, u64 samples)
+{
+    StepCounts c;
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+    pnbkernel::countSetMatches(plan, *masks, samples, c.matches, c.d_hits);
+    return c;
+}
@@ -0,0 +1,412 @@
+/*
+ * REFERENCE IMPLEMENTATION OF pairwise key-bit neutrality interaction matrix
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * For every key bit i and every pair i < j this program measures the neutrality bias when the
+ * bit (pair) is flipped, and compares eps_ij with eps_i * eps_j. A large |eps_ij - eps_i * eps_j|
+ * marks PNB candidates that are not independent of each other.
+ *
+ * Per sample there is ONE forward half; the n single flips and n(n-1)/2 pair flips are inverted
+ * LANES at a time with pnbkernel::backwardParityLanes(). Pair counts live in a triangular array,
+ * index(i, j) = j(j-1)/2 + i for i < j.
+ *
+ * Cost: 32,896 backward halves per sample against 256 forward + 256 backward for a single-bit
+ * search with the same samples per bit. Shared forward halves and lanes make that about 11x
+ * the wall time of the tuned search (2^12 samples, one core: 5.7 s against 0.5 s), not 128x.
+ *
+ * Output (folder "pairs"):
+ *   <name>.bin              : binary counts (layout in write_binary())
+ *   <name>_bias.csv         : n x n matrix, eps_ij off the diagonal, eps_i on it
+ *   <name>_interaction.csv  : n x n matrix, eps_ij - eps_i * eps_j off the diagonal, eps_i on it
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native pnbpairs.cpp -o pairs && ./pairs [log2_samples] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + forward/backward sample kernel
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+
+constexpr size_t LANES = 16; // key guesses per backward batch
+
+static atomic<u64> progress{0};
+
+// flip job: single bit (i, i) or pair (i, j), i < j
+using FlipJob = pair<u16, u16>;
+
+// count matrices and the job list live in the huge-page arena (one per thread + the total)
+struct PairCounts
+{
+    arena::vector<u64> single; // [n]
+    arena::vector<u64> tri;    // [n(n-1)/2]
+};
+
+PairCounts paircount(const arena::vector<FlipJob> *jobs, u16 key_bits, u64 samples);
+
+inline size_t tri_index(size_t i, size_t j) { return j * (j - 1) / 2 + i; } // i < j
+
+static void parse_cli(int argc, char *argv[], int &log2_samples)
+{
+    if (argc >= 2)
+    {
+        try
+        {
+            log2_samples = std::stoi(argv[1]);
+            if (log2_samples < 6 || log2_samples > 32)
+            {
+                std::cerr << "log2_samples must be in [6,32]. Using default 14.\n";
+                log2_samples = 14;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_samples input. Using default 14.\n";
+            log2_samples = 14;
+        }
+    }
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        if (flag == "log" || flag == "1")
+            basic_config.logfile_flag = true;
+    }
+}
+
+static u16 init_config_and_banner(int log2_samples, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "PNBpairs"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.comment = "last round modified";
+    basic_config.total_rounds = 7.5;
+
+    diff_config.distinguishing_round = 5;
+    diff_config.id = {{7, 31}};
+    diff_config.mask = {{4, 7}};
+
+    samples_config.samples_per_batch = 1ULL << log2_samples;
+    samples_config.samples_per_thread =
+        (samples_config.samples_per_batch + samples_config.max_num_threads - 1) / samples_config.max_num_threads;
+
+    const u16 key_bits = static_cast<u16>(basic_config.key_size);
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    display::printField(dmsg, "Key bits", key_bits);
+    display::printField(dmsg, "Backward passes per sample", key_bits + key_bits * (key_bits - 1) / 2);
+    display::printField(dmsg, "Lanes per backward batch", LANES);
+    dmsg << basic_config.star_sep;
+
+    return key_bits;
+}
+
+static PairCounts run_matrix(u16 key_bits)
+{
+    // singles first, then pairs in triangular order, so job t maps straight to a counter
+    arena::vector<FlipJob> jobs;
+    jobs.reserve(key_bits + key_bits * (key_bits - 1) / 2);
+    for (u16 i{0}; i < key_bits; ++i)
+        jobs.push_back({i, i});
+    for (u16 j{1}; j < key_bits; ++j)
+        for (u16 i{0}; i < j; ++i)
+            jobs.push_back({i, j});
+
+    PairCounts total;
+    total.single.assign(key_bits, 0);
+    total.tri.assign(static_cast<size_t>(key_bits) * (key_bits - 1) / 2, 0);
+
+    progress.store(0, std::memory_order_relaxed);
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    SpinnerWithETA spinner("Building interaction matrix ...", &progress,
+                           samples_config.samples_per_thread * samples_config.max_num_threads);
+    spinner.start();
+    #endif
+
+    vector<std::future<PairCounts>> future_results;
+    future_results.reserve(samples_config.max_num_threads);
+
+    for (u16 thread_number{0}; thread_number < samples_config.max_num_threads; ++thread_number)
+        future_results.emplace_back(async(launch::async, paircount, &jobs, key_bits, static_cast<u64>(samples_config.samples_per_thread)));
+
+    try
+    {
+        for (auto &f : future_results)
+        {
+            PairCounts c = f.get();
+            for (size_t i{0}; i < total.single.size(); ++i)
+                total.single[i] += c.single[i];
+            for (size_t i{0}; i < total.tri.size(); ++i)
+                total.tri[i] += c.tri[i];
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "Thread error: " << e.what() << "\n";
+    }
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    spinner.stop();
+    #endif
+
+    return total;
+}
+
+/*
+ * Binary layout (native little-endian):
+ *   char[8] magic "PNBPAIRS"
+ *   u32     version (1)
+ *   u32     key bits n
+ *   u64     samples
+ *   u64     single[n]          matches with bit i flipped
+ *   u64     tri[n(n-1)/2]      matches with bits i < j flipped, index j(j-1)/2 + i
+ */
+static bool write_binary(const string &path, const PairCounts &c, u16 key_bits, u64 samples)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    const char magic[8] = {'P', 'N', 'B', 'P', 'A', 'I', 'R', 'S'};
+    const u32 version = 1;
+    const u32 n = key_bits;
+
+    out.write(magic, sizeof(magic));
+    out.write(reinterpret_cast<const char *>(&version), sizeof(version));
+    out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+    out.write(reinterpret_cast<const char *>(&samples), sizeof(samples));
+    out.write(reinterpret_cast<const char *>(c.single.data()), c.single.size() * sizeof(u64));
+    out.write(reinterpret_cast<const char *>(c.tri.data()), c.tri.size() * sizeof(u64));
+    return static_cast<bool>(out);
+}
+
+// n x n matrix with a header row/column of bit indices; interaction = false writes eps_ij
+static bool write_csv(const string &path, const PairCounts &c, u16 key_bits, u64 samples, bool interaction)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    vector<double> eps(key_bits);
+    for (u16 i{0}; i < key_bits; ++i)
+        eps[i] = stats::biasFromCount(c.single[i], samples);
+
+    out << "bit";
+    for (u16 j{0}; j < key_bits; ++j)
+        out << "," << j;
+    out << "\n";
+
+    out << std::setprecision(6);
+    for (u16 i{0}; i < key_bits; ++i)
+    {
+        out << i;
+        for (u16 j{0}; j < key_bits; ++j)
+        {
+            double v;
+            if (i == j)
+                v = eps[i];
+            else
+            {
+                const double e = stats::biasFromCount(c.tri[tri_index(std::min(i, j), std::max(i, j))], samples);
+                v = interaction ? e - eps[i] * eps[j] : e;
+            }
+            out << "," << v;
+        }
+        out << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+// the most dependent pairs, by |eps_ij - eps_i * eps_j|
+static void print_top_pairs(const PairCounts &c, u16 key_bits, u64 samples, std::ostream &out, size_t top = 20)
+{
+    struct Entry
+    {
+        u16 i, j;
+        double eps_ij, product;
+    };
+
+    vector<Entry> entries;
+    entries.reserve(c.tri.size());
+    for (u16 j{1}; j < key_bits; ++j)
+    {
+        const double ej = stats::biasFromCount(c.single[j], samples);
+        for (u16 i{0}; i < j; ++i)
+        {
+            const double ei = stats::biasFromCount(c.single[i], samples);
+            entries.push_back({i, j, stats::biasFromCount(c.tri[tri_index(i, j)], samples), ei * ej});
+        }
+    }
+
+    top = std::min(top, entries.size());
+    std::partial_sort(entries.begin(), entries.begin() + top, entries.end(),
+                      [](const Entry &a, const Entry &b)
+                      { return std::fabs(a.eps_ij - a.product) > std::fabs(b.eps_ij - b.product); });
+
+    out << basic_config.dash_sep;
+    out << "Top " << top << " interacting pairs (largest |eps_ij - eps_i*eps_j|)\n";
+    out << "Format: i  j  eps_ij  eps_i*eps_j  difference\n";
+    out << "(95% CI half-width of a single eps at this sample size: " << std::fixed << std::setprecision(5)
+        << stats::biasHalfWidth(samples / 2, samples) << ")\n";
+    for (size_t k{0}; k < top; ++k)
+    {
+        const Entry &e = entries[k];
+        out << std::right << std::setw(6) << e.i << std::setw(6) << e.j
+            << std::setw(11) << e.eps_ij << std::setw(11) << e.product
+            << std::setw(11) << (e.eps_ij - e.product) << "\n";
+    }
+    out << std::left;
+    out << basic_config.dash_sep;
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    int log2_samples = 14;
+    parse_cli(argc, argv, log2_samples);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "pairs";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    const u16 key_bits = init_config_and_banner(log2_samples, dmsg);
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    PairCounts counts = run_matrix(key_bits);
+    const u64 samples = samples_config.samples_per_thread * samples_config.max_num_threads;
+
+    stringstream report;
+    print_top_pairs(counts, key_bits, samples, report);
+
+    // ---------------- save matrix files -----------------
+    string base = pnbinfo::makeLogFilename(basic_config, diff_config, nullptr, folder);
+    base = base.substr(0, base.size() - 4); // drop ".txt"
+
+    const string bin_file = base + ".bin";
+    const string bias_csv = base + "_bias.csv";
+    const string inter_csv = base + "_interaction.csv";
+
+    if (write_binary(bin_file, counts, key_bits, samples))
+        report << "Binary counts saved to: " << bin_file << "\n";
+    else
+        std::cerr << "ERROR: Could not write " << bin_file << "\n";
+
+    if (write_csv(bias_csv, counts, key_bits, samples, false) &&
+        write_csv(inter_csv, counts, key_bits, samples, true))
+        report << "CSV matrices saved to: " << bias_csv << ", " << inter_csv << "\n";
+    else
+        std::cerr << "ERROR: Could not write CSV matrices under " << folder << "\n";
+
+    report << arena::global().report();
+
+    cout << "\n" << report.str();
+    dmsg << report.str();
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = base + ".txt";
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: single + pair counts on this thread's samples -----------------
+PairCounts paircount(const arena::vector<FlipJob> *jobs, u16 key_bits, u64 samples)
+{
+    PairCounts c;
+    c.single.assign(key_bits, 0);
+    c.tri.assign(static_cast<size_t>(key_bits) * (key_bits - 1) / 2, 0);
+
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+    const size_t job_count = jobs->size();
+
+    pnbkernel::ForwardSample sample;
+    u32 guesses[LANES][KEYWORD_COUNT];
+
+    for (u64 loop{0}; loop < samples; ++loop)
+    {
+        // ---------------- one forward half per sample -----------------
+        pnbkernel::generateSample(plan, sample);
+
+        // ---------------- all flips, LANES at a time -----------------
+        for (size_t t0{0}; t0 < job_count; t0 += LANES)
+        {
+            const size_t lanes = std::min(LANES, job_count - t0);
+            for (size_t l{0}; l < LANES; ++l)
+            {
+                ops::copyState(guesses[l], sample.key, 0, KEYWORD_COUNT);
+                if (l >= lanes)
+                    continue; // padding lane, result ignored
+
+                const auto [i, j] = (*jobs)[t0 + l];
+                pnbkernel::toggleKeyBit(guesses[l], i, plan.key_128);
+                if (j != i)
+                    pnbkernel::toggleKeyBit(guesses[l], j, plan.key_128);
+            }
+
+            const u64 parities = pnbkernel::backwardParityLanes<LANES>(plan, sample, guesses);
+
+            for (size_t l{0}; l < lanes; ++l)
+            {
+                const size_t t = t0 + l;
+                const u64 match = (sample.fwd_parity == ((parities >> l) & 1));
+                if (t < key_bits)
+                    c.single[t] += match;
+                else
+                    c.tri[t - key_bits] += match;
+            }
+        }
+
+        progress.fetch_add(1, std::memory_order_relaxed); // one sample = 32896 backward passes
+    }
+
+    return c;
+}
@@ -0,0 +1,364 @@
+/*
+ * REFERENCE IMPLEMENTATION OF segment-level joint neutrality of consecutive PNB runs
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * Consecutive PNBs inside a key word (segments such as [31:28] in the report) do not behave
+ * like independent bits: carries run from the low bit of a segment into the higher ones.
+ * This program measures, for every segment of a PNB set and every nested prefix of it
+ * (low bit first: [lo], [lo+1:lo], ..., [hi:lo]),
+ *   - the bias when all bits of the prefix are flipped together,
+ *   - the bias when all bits of the prefix are replaced by random values,
+ * next to the product of the single-bit flip biases. The pattern/border/rest split of
+ * pnbinfo::finalizePNBValues() is evaluated jointly as well.
+ *
+ * All jobs share one forward half per sample and are evaluated in one pass over the
+ * samples with pnbkernel::countJobMatches().
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native pnbsegments.cpp -o segments && ./segments <pnb_file|-> [log2_samples] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + forward/backward sample kernel
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+pnbinfo::PNBdetails pnb_config;
+
+static atomic<u64> progress{0};
+
+// one row of the report: a bit group evaluated with a flip job and a random job
+struct SegmentRow
+{
+    string label;
+    vector<u16> bits;
+    size_t flip_job = 0;
+    size_t random_job = 0;
+    bool nested = false; // prefix of a segment (indented in the report)
+};
+
+struct JobCounts
+{
+    vector<u64> matches;
+    u64 d_hits = 0;
+};
+
+JobCounts jobcount(const vector<pnbkernel::KeyJob> *jobs, u64 samples);
+
+static void parse_cli(int argc, char *argv[], string &pnb_file, int &log2_samples)
+{
+    if (argc >= 2)
+        pnb_file = argv[1];
+
+    if (argc >= 3)
+    {
+        try
+        {
+            log2_samples = std::stoi(argv[2]);
+            if (log2_samples < 8 || log2_samples > 36)
+            {
+                std::cerr << "log2_samples must be in [8,36]. Using default 20.\n";
+                log2_samples = 20;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_samples input. Using default 20.\n";
+            log2_samples = 20;
+        }
+    }
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        if (flag == "log" || flag == "1")
+            basic_config.logfile_flag = true;
+    }
+}
+
+static bool init_config_and_banner(const string &pnb_file, int log2_samples, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "PNBsegments"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.comment = "last round modified";
+    basic_config.total_rounds = 7.5;
+
+    diff_config.distinguishing_round = 5;
+    diff_config.id = {{7, 31}};
+    diff_config.mask = {{4, 7}};
+
+    pnb_config.pnb_pattern_flag = true; // we want pattern/border/rest
+
+    bool ok;
+    if (pnb_file == "-")
+    {
+        pnb_config.pnbs = {
+            // example:
+            // 148, 149, 150, 156, 157, 158, 159, 191, 196
+        };
+        ok = pnbinfo::preparePNBFromVector(pnb_config) && pnbinfo::pnbsInKeyRange(pnb_config, &basic_config);
+    }
+    else
+    {
+        pnb_config.pnb_file = pnb_file;
+        ok = pnbinfo::preparePNBFromFile(pnb_file, pnb_config, &basic_config);
+    }
+
+    if (!ok)
+    {
+        std::cerr << "ERROR: no PNBs to evaluate.\n";
+        return false;
+    }
+
+    samples_config.samples_per_batch = 1ULL << log2_samples;
+    samples_config.samples_per_thread =
+        (samples_config.samples_per_batch + samples_config.max_num_threads - 1) / samples_config.max_num_threads;
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    if (!pnb_config.pnb_file.empty())
+        display::printField(dmsg, "PNB file", pnb_config.pnb_file);
+    pnbinfo::showPNBConfig(pnb_config, dmsg);
+
+    return true;
+}
+
+// "[31:28]"-style label of a (global-index) bit range inside one key word
+static string segment_label(u16 lo, u16 hi)
+{
+    std::ostringstream s;
+    s << "Keyword " << lo / WORD_SIZE << " [" << hi % WORD_SIZE;
+    if (hi != lo)
+        s << ":" << lo % WORD_SIZE;
+    s << "]";
+    return s.str();
+}
+
+// rows for every segment and its nested prefixes, then the joint pattern/border/rest groups
+static vector<SegmentRow> build_rows(vector<pnbkernel::KeyJob> &jobs, vector<size_t> &single_job)
+{
+    const bool key_128 = (basic_config.key_size == 128);
+    vector<SegmentRow> rows;
+
+    auto add_row = [&](const string &label, const vector<u16> &bits, bool nested)
+    {
+        if (bits.empty())
+            return;
+        SegmentRow r;
+        r.label = label;
+        r.bits = bits;
+        r.nested = nested;
+        r.flip_job = jobs.size();
+        jobs.push_back({pnbkernel::makeKeyMask(bits, key_128), false});
+        r.random_job = jobs.size();
+        jobs.push_back({pnbkernel::makeKeyMask(bits, key_128), true});
+        rows.push_back(std::move(r));
+    };
+
+    // single-bit flips, for the product column (indices are < key_size, see pnbinfo::pnbsInKeyRange)
+    single_job.assign(basic_config.key_size, 0);
+    for (u16 p : pnb_config.pnbs)
+    {
+        single_job[p] = jobs.size();
+        jobs.push_back({pnbkernel::makeKeyMask({p}, key_128), false});
+    }
+
+    // ---------------- segments: consecutive runs inside one key word -----------------
+    const vector<u16> &pnbs = pnb_config.pnbs; // sorted + deduplicated
+    for (size_t start{0}; start < pnbs.size();)
+    {
+        size_t end = start + 1;
+        while (end < pnbs.size() && pnbs[end] == pnbs[end - 1] + 1 &&
+               pnbs[end] / WORD_SIZE == pnbs[start] / WORD_SIZE)
+            ++end;
+
+        const vector<u16> run(pnbs.begin() + start, pnbs.begin() + end);
+        if (run.size() >= 2)
+        {
+            add_row(segment_label(run.front(), run.back()), run, false);
+            // nested prefixes from the low bit up; the full run is the row above
+            for (size_t k{1}; k < run.size(); ++k)
+            {
+                const vector<u16> prefix(run.begin(), run.begin() + k);
+                add_row("  prefix " + segment_label(prefix.front(), prefix.back()), prefix, true);
+            }
+        }
+        start = end;
+    }
+
+    // ---------------- joint groups of finalizePNBValues() -----------------
+    vector<u16> pattern_border = pnb_config.pnbs_in_pattern;
+    pattern_border.insert(pattern_border.end(), pnb_config.pnbs_in_border.begin(), pnb_config.pnbs_in_border.end());
+    std::sort(pattern_border.begin(), pattern_border.end());
+
+    add_row("pnbs_in_pattern", pnb_config.pnbs_in_pattern, false);
+    add_row("pnbs_in_pattern + border", pattern_border, false);
+    add_row("rest_pnbs", pnb_config.rest_pnbs, false);
+    add_row("all PNBs", pnb_config.pnbs, false);
+
+    return rows;
+}
+
+static JobCounts run_jobs(const vector<pnbkernel::KeyJob> &jobs)
+{
+    JobCounts total;
+    total.matches.assign(jobs.size(), 0);
+
+    progress.store(0, std::memory_order_relaxed);
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    SpinnerWithETA spinner("Evaluating segments ...", &progress, samples_config.max_num_threads);
+    spinner.start();
+    #endif
+
+    vector<std::future<JobCounts>> future_results;
+    future_results.reserve(samples_config.max_num_threads);
+
+    for (u16 thread_number{0}; thread_number < samples_config.max_num_threads; ++thread_number)
+        future_results.emplace_back(async(launch::async, jobcount, &jobs, static_cast<u64>(samples_config.samples_per_thread)));
+
+    try
+    {
+        for (auto &f : future_results)
+        {
+            JobCounts c = f.get();
+            for (size_t j{0}; j < jobs.size(); ++j)
+                total.matches[j] += c.matches[j];
+            total.d_hits += c.d_hits;
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "Thread error: " << e.what() << "\n";
+    }
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    spinner.stop();
+    #endif
+
+    return total;
+}
+
+static void print_rows(const vector<SegmentRow> &rows, const vector<size_t> &single_job,
+                       const JobCounts &c, u64 n, std::ostream &out)
+{
+    out << basic_config.dash_sep;
+    out << "Joint neutrality of PNB segments (" << display::formatCountPow2Pow10(n) << " samples)\n";
+    out << "Format: segment  #bits  eps flip (95% CI)  eps random (95% CI)  prod of single-bit flip eps\n";
+    out << basic_config.dash_sep;
+
+    out << std::fixed << std::setprecision(4);
+    for (const auto &r : rows)
+    {
+        const stats::BiasEstimate flip{c.matches[r.flip_job], n};
+        const stats::BiasEstimate rnd{c.matches[r.random_job], n};
+
+        double product = 1.0;
+        for (u16 b : r.bits)
+            product *= stats::biasFromCount(c.matches[single_job[b]], n);
+
+        out << std::left << std::setw(30) << r.label
+            << std::right << std::setw(4) << r.bits.size() << "  "
+            << std::setw(8) << flip.bias() << " ±" << std::setw(7) << flip.halfWidth() << "  "
+            << std::setw(8) << rnd.bias() << " ±" << std::setw(7) << rnd.halfWidth() << "  "
+            << std::setw(8) << product << "\n";
+    }
+    out << std::left;
+
+    const stats::BiasEstimate eps_d{c.d_hits, n};
+    out << basic_config.dash_sep;
+    display::printField(out, "eps_d (forward parity)", eps_d.bias());
+    out << basic_config.dash_sep;
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    string pnb_file = "-";
+    int log2_samples = 20;
+    parse_cli(argc, argv, pnb_file, log2_samples);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "segments";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    if (!init_config_and_banner(pnb_file, log2_samples, dmsg))
+        return 1;
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    vector<pnbkernel::KeyJob> jobs;
+    vector<size_t> single_job;
+    vector<SegmentRow> rows = build_rows(jobs, single_job);
+
+    JobCounts counts = run_jobs(jobs);
+    const u64 n = samples_config.samples_per_thread * samples_config.max_num_threads;
+
+    stringstream report;
+    print_rows(rows, single_job, counts, n, report);
+    pnbinfo::print_per_keyword_pnb_segments(pnb_config.pnbs, &basic_config, report);
+    cout << "\n" << report.str();
+    dmsg << report.str();
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = makeLogFilename(basic_config, diff_config, &pnb_config, folder);
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: every job on this thread's samples -----------------
+JobCounts jobcount(const vector<pnbkernel::KeyJob> *jobs, u64 samples)
+{
+    JobCounts c;
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+    pnbkernel::countJobMatches(plan, *jobs, samples, c.matches, c.d_hits);
+    progress.fetch_add(1, std::memory_order_relaxed);
+    return c;
+}
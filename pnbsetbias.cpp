@@ -0,0 +1,498 @@
+/*
+ * REFERENCE IMPLEMENTATION OF joint PNB-set bias evaluation
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * This file measures the quantity the attack actually needs for a given PNB set: the backward
+ * bias when ALL PNBs are replaced by random (or fixed) values at once. For every sample it counts
+ *   fwd_parity == 0            -> eps_d (differential-linear bias at the distinguishing round)
+ *   fwd_parity == bwd_parity   -> eps_a (neutrality of the whole PNB set)
+ *   bwd_parity == 0            -> eps   (combined bias, ~ eps_a * eps_d)
+ * and reports them with 95% confidence intervals. Meant for 2^30 - 2^36 samples, so the
+ * counts are checkpointed and a restarted run resumes where it stopped.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 pnbsetbias.cpp -o setbias && ./setbias <pnb_file|-> [log2_samples] [random|fixed] [value=<word>] [log] [fresh] [pool=<file>]
+ *
+ *   pnb_file    : PNB list (see pnbinfo::preparePNBFromFile), "-" uses the list in init_config_and_banner()
+ *   value=<word>: fixed mode with this 32-bit word (decimal or 0x...) in every key word, so PNB i
+ *                 gets bit i % 32 of it; default 0
+ *   pool=<file> : stream forward halves from a sample pool (samplepool.cpp); at most the pool size is used
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp, samplepool.hpp
+ */
+
+#include "header/samplepool.hpp" // salsa round functions + forward/backward sample kernel + sample pool
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+pnbinfo::PNBdetails pnb_config;
+
+static atomic<u64> progress{0};
+static std::unique_ptr<samplepool::Pool> sample_pool; // set by pool=<file>
+
+struct SetBiasOptions
+{
+    string pnb_file = "-";
+    int log2_samples = 30;
+    bool fixed_pnbs = false; // false: PNB bits random per sample, true: PNB bits set to fixed_value
+    u32 fixed_value = 0;
+    bool fresh = false; // ignore an existing checkpoint
+    string pool_file;
+    u64 target_samples = 0; // 2^log2_samples, capped by the pool size
+};
+
+struct SetCounts
+{
+    u64 d_hits = 0; // fwd_parity == 0
+    u64 a_hits = 0; // fwd_parity == bwd_parity
+    u64 hits = 0;   // bwd_parity == 0
+    u64 samples = 0;
+};
+
+// samples per lane-batched backward pass in setcount()
+constexpr size_t SETBIAS_LANES = 16;
+
+SetCounts setcount(const u32 *pnb_mask, u32 fixed_value, bool fixed_pnbs, u64 samples, u64 pool_first);
+
+static void parse_cli(int argc, char *argv[], SetBiasOptions &opt)
+{
+    if (argc >= 2)
+        opt.pnb_file = argv[1];
+
+    if (argc >= 3)
+    {
+        try
+        {
+            opt.log2_samples = std::stoi(argv[2]);
+            if (opt.log2_samples < 10 || opt.log2_samples > 40)
+            {
+                std::cerr << "log2_samples must be in [10,40]. Using default 30.\n";
+                opt.log2_samples = 30;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_samples input. Using default 30.\n";
+            opt.log2_samples = 30;
+        }
+    }
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        if (flag.rfind("pool=", 0) == 0)
+        {
+            opt.pool_file = flag.substr(5);
+            continue;
+        }
+        if (flag.rfind("value=", 0) == 0)
+        {
+            try
+            {
+                size_t used = 0;
+                const unsigned long v = std::stoul(flag.substr(6), &used, 0);
+                if (used != flag.size() - 6 || v > 0xffffffffUL)
+                    throw std::out_of_range("value");
+                opt.fixed_value = static_cast<u32>(v);
+                opt.fixed_pnbs = true;
+            }
+            catch (...)
+            {
+                std::cerr << "Invalid value= input (a 32-bit word). Using " << config::formatWord(opt.fixed_value) << ".\n";
+            }
+            continue;
+        }
+
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        if (flag == "log" || flag == "1")
+            basic_config.logfile_flag = true;
+        else if (flag == "fixed")
+            opt.fixed_pnbs = true;
+        else if (flag == "random")
+            opt.fixed_pnbs = false;
+        else if (flag == "fresh")
+            opt.fresh = true;
+    }
+}
+
+static bool init_config_and_banner(SetBiasOptions &opt, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "PNBsetbias"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.comment = "last round modified";
+    basic_config.total_rounds = 7.5;
+
+    diff_config.distinguishing_round = 5;
+    diff_config.id = {{7, 31}};
+    diff_config.mask = {{4, 7}};
+
+    pnb_config.pnb_pattern_flag = true;
+
+    bool ok;
+    if (opt.pnb_file == "-")
+    {
+        pnb_config.pnbs = {
+            // example:
+            // 148, 149, 150, 156, 157, 158, 159, 191, 196
+        };
+        ok = pnbinfo::preparePNBFromVector(pnb_config) && pnbinfo::pnbsInKeyRange(pnb_config, &basic_config);
+    }
+    else
+    {
+        pnb_config.pnb_file = opt.pnb_file;
+        ok = pnbinfo::preparePNBFromFile(opt.pnb_file, pnb_config, &basic_config);
+    }
+
+    if (!ok)
+    {
+        std::cerr << "ERROR: no PNBs to evaluate.\n";
+        return false;
+    }
+
+    opt.target_samples = 1ULL << opt.log2_samples;
+    if (!opt.pool_file.empty())
+    {
+        try
+        {
+            sample_pool = std::make_unique<samplepool::Pool>(opt.pool_file);
+        }
+        catch (const exception &e)
+        {
+            std::cerr << "ERROR: " << e.what() << "\n";
+            return false;
+        }
+
+        const string diff = samplepool::mismatch(sample_pool->header(), pnbkernel::makeRoundPlan(basic_config, diff_config));
+        if (!diff.empty())
+        {
+            std::cerr << "ERROR: sample pool " << opt.pool_file << " was generated for another " << diff << ".\n";
+            return false;
+        }
+        opt.target_samples = std::min<u64>(opt.target_samples, sample_pool->size());
+    }
+
+    samples_config.samples_per_thread = 1ULL << 22;
+    if (static_cast<int>(std::log2(samples_config.samples_per_thread)) > opt.log2_samples)
+        samples_config.samples_per_thread = 1ULL << opt.log2_samples;
+    if (sample_pool)
+        samples_config.samples_per_thread = std::min<u64>(samples_config.samples_per_thread,
+                                                          (opt.target_samples + samples_config.max_num_threads - 1) / samples_config.max_num_threads);
+    samples_config.samples_per_batch =
+        samples_config.samples_per_thread * samples_config.max_num_threads;
+
+    const u64 total = opt.target_samples;
+    samples_config.num_batches = (total + samples_config.samples_per_batch - 1) / samples_config.samples_per_batch;
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    display::printField(dmsg, "PNB values", opt.fixed_pnbs ? "fixed (" + config::formatWord(opt.fixed_value) + ")" : "random per sample");
+    if (!pnb_config.pnb_file.empty())
+        display::printField(dmsg, "PNB file", pnb_config.pnb_file);
+    if (sample_pool)
+        display::printField(dmsg, "Sample pool", sample_pool->path() + " (" + display::formatCountPow2Pow10(sample_pool->size()) + " records)");
+    pnbinfo::showPNBConfig(pnb_config, dmsg);
+
+    return true;
+}
+
+// everything a checkpoint must agree on before its counts are reused
+static string run_fingerprint(const SetBiasOptions &opt)
+{
+    std::ostringstream fp;
+    fp << "kernel" << pnbkernel::KERNEL_VERSION << " "
+       << basic_config.cipher_name << "-" << basic_config.key_size
+       << " R" << basic_config.total_rounds << " D" << diff_config.distinguishing_round
+       << " " << basic_config.comment << " id";
+    for (const auto &[w, b] : diff_config.id)
+        fp << ":" << w << "," << b;
+    fp << " mask";
+    for (const auto &[w, b] : diff_config.mask)
+        fp << ":" << w << "," << b;
+    fp << " pnbs";
+    for (u16 p : pnb_config.pnbs)
+        fp << ":" << p;
+    fp << (opt.fixed_pnbs ? " fixed:" + std::to_string(opt.fixed_value) : " random");
+    // pooled runs resume at the next unused record, so the pool is part of the run
+    if (sample_pool)
+        fp << " pool:" << std::hex
+           << checkpoint::fnv1a64(string(reinterpret_cast<const char *>(&sample_pool->header()), sizeof(samplepool::Header)));
+    return fp.str();
+}
+
+static string checkpoint_path(const string &fingerprint, const string &folder)
+{
+    std::ostringstream name;
+    name << folder << "/setbias_" << std::hex << checkpoint::fnv1a64(fingerprint) << ".ckpt";
+    return name.str();
+}
+
+static SetCounts run_evaluation(const SetBiasOptions &opt, const string &ckpt_file, const string &fingerprint)
+{
+    SetCounts total;
+
+    checkpoint::Record rec;
+    if (!opt.fresh && checkpoint::load(ckpt_file, rec) && rec.fingerprint == fingerprint)
+    {
+        total.d_hits = rec.get("d_hits");
+        total.a_hits = rec.get("a_hits");
+        total.hits = rec.get("hits");
+        total.samples = rec.get("samples");
+        std::cout << "Resuming from " << ckpt_file << " at "
+                  << display::formatCountPow2Pow10(total.samples) << " samples\n";
+    }
+    rec.fingerprint = fingerprint;
+
+    u32 pnb_mask[KEYWORD_COUNT];
+    pnbkernel::buildKeyMask(pnb_config.pnbs, basic_config.key_size == 128, pnb_mask);
+
+    const u64 target = opt.target_samples;
+    const u64 spt = samples_config.samples_per_thread;
+    const u64 done_batches = total.samples / samples_config.samples_per_batch;
+
+    progress.store(done_batches, std::memory_order_relaxed);
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    SpinnerWithETA spinner("Evaluating PNB set ...", &progress, samples_config.num_batches);
+    spinner.start();
+    #endif
+
+    vector<std::future<SetCounts>> future_results;
+    future_results.reserve(samples_config.max_num_threads);
+
+    auto save = [&]()
+    {
+        rec.set("d_hits", total.d_hits);
+        rec.set("a_hits", total.a_hits);
+        rec.set("hits", total.hits);
+        rec.set("samples", total.samples);
+        if (!checkpoint::save(ckpt_file, rec))
+            std::cerr << "ERROR: Could not write checkpoint: " << ckpt_file << "\n";
+    };
+
+    auto last_save = std::chrono::steady_clock::now();
+
+    // ---------------- batch loop -----------------
+    while (total.samples < target)
+    {
+        const u64 remaining = target - total.samples;
+        const u64 per_thread = std::min<u64>(spt, (remaining + samples_config.max_num_threads - 1) / samples_config.max_num_threads);
+
+        future_results.clear();
+        for (u16 thread_number{0}; thread_number < samples_config.max_num_threads; ++thread_number)
+        {
+            // pooled: threads take consecutive slices of the records not used yet
+            const u64 first = total.samples + thread_number * per_thread;
+            const u64 count = sample_pool ? std::min(per_thread, target - std::min(target, first)) : per_thread;
+            future_results.emplace_back(async(launch::async, setcount, pnb_mask, opt.fixed_value, opt.fixed_pnbs, count, first));
+        }
+
+        try
+        {
+            for (auto &f : future_results)
+            {
+                SetCounts c = f.get();
+                total.d_hits += c.d_hits;
+                total.a_hits += c.a_hits;
+                total.hits += c.hits;
+                total.samples += c.samples;
+            }
+        }
+        catch (const exception &e)
+        {
+            cerr << "Thread error: " << e.what() << "\n";
+            break;
+        }
+
+        progress.fetch_add(1, std::memory_order_relaxed);
+
+        // a checkpoint per minute is plenty for runs that last days
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_save >= std::chrono::seconds(60))
+        {
+            save();
+            last_save = now;
+        }
+    }
+    save();
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    spinner.stop();
+    #endif
+
+    return total;
+}
+
+static void print_estimate(const string &label, const stats::BiasEstimate &e, std::ostream &out)
+{
+    int w = 0;
+    std::ostringstream s;
+    s << display::formatRealPow2(e.bias(), w) << "  ± " << std::scientific << std::setprecision(3) << e.halfWidth()
+      << "  [" << e.lower() << ", " << e.upper() << "]";
+    display::printField(out, label, s.str());
+}
+
+static void print_report(const SetCounts &c, std::ostream &out)
+{
+    const stats::BiasEstimate eps_d{c.d_hits, c.samples};
+    const stats::BiasEstimate eps_a{c.a_hits, c.samples};
+    const stats::BiasEstimate eps{c.hits, c.samples};
+
+    out << basic_config.dash_sep;
+    display::printField(out, "# of samples", display::formatCountPow2Pow10(c.samples));
+    display::printField(out, "# of PNBs", pnb_config.pnbs.size());
+    print_estimate("eps_d (forward parity)", eps_d, out);
+    print_estimate("eps_a (fwd == bwd parity)", eps_a, out);
+    print_estimate("eps (backward parity)", eps, out);
+    {
+        int w = 0;
+        display::printField(out, "eps_a * eps_d", display::formatRealPow2(eps_a.bias() * eps_d.bias(), w));
+    }
+    out << "Note: intervals are 95% normal-approximation CIs.\n";
+    out << basic_config.dash_sep;
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    SetBiasOptions opt;
+    parse_cli(argc, argv, opt);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "setbias";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    if (!init_config_and_banner(opt, dmsg))
+        return 1;
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    const string fingerprint = run_fingerprint(opt);
+    const string ckpt_file = checkpoint_path(fingerprint, folder);
+
+    SetCounts counts = run_evaluation(opt, ckpt_file, fingerprint);
+
+    stringstream report;
+    print_report(counts, report);
+    cout << "\n" << report.str();
+    dmsg << report.str();
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = makeLogFilename(basic_config, diff_config, &pnb_config, folder);
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: joint PNB-set counts for `samples` samples -----------------
+// pool_first: first pool record of this call (ignored without a pool)
+// SETBIAS_LANES samples are inverted together (pnbkernel::backwardParitySamples), each with its
+// own PNB values; a tail of fewer samples goes through the scalar backwardParity()
+SetCounts setcount(const u32 *pnb_mask, u32 fixed_value, bool fixed_pnbs, u64 samples, u64 pool_first)
+{
+    constexpr size_t L = SETBIAS_LANES;
+    SetCounts c;
+
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+
+    pnbkernel::ForwardSample sample;
+    pnbkernel::ForwardSample batch[L];
+    u32 guesses[L][KEYWORD_COUNT], values[KEYWORD_COUNT];
+    size_t filled = 0;
+
+    ops::setState(values, 0, KEYWORD_COUNT, fixed_value);
+
+    auto backward = [&](const pnbkernel::ForwardSample &s)
+    {
+        // ---------------- replace every PNB at once -----------------
+        if (!fixed_pnbs)
+        {
+            for (size_t w{0}; w < KEYWORD_COUNT; ++w)
+                values[w] = pnb_mask[w] ? RandomNumber<u32>() : 0;
+        }
+        pnbkernel::replaceKeyBits(guesses[filled], s.key, pnb_mask, values, plan.key_128);
+        batch[filled++] = s;
+        if (filled < L)
+            return;
+        filled = 0;
+
+        // ---------------- backward half of L samples -----------------
+        u64 fwd = 0;
+        for (size_t l{0}; l < L; ++l)
+            fwd |= static_cast<u64>(batch[l].fwd_parity) << l;
+        const u64 bwd = pnbkernel::backwardParitySamples<L>(plan, batch, guesses);
+        const u64 lane_mask = (L == 64) ? ~0ULL : ((1ULL << L) - 1);
+
+        c.d_hits += std::popcount(~fwd & lane_mask);
+        c.a_hits += std::popcount(~(fwd ^ bwd) & lane_mask);
+        c.hits += std::popcount(~bwd & lane_mask);
+    };
+
+    if (sample_pool)
+        sample_pool->forEach(pool_first, samples, backward);
+    else
+    {
+        for (u64 loop{0}; loop < samples; ++loop)
+        {
+            // ---------------- forward half -----------------
+            pnbkernel::generateSample(plan, sample);
+            backward(sample);
+        }
+    }
+
+    // ---------------- tail of an incomplete batch -----------------
+    for (size_t l{0}; l < filled; ++l)
+    {
+        const u8 bwd_parity = pnbkernel::backwardParity(plan, batch[l], guesses[l]);
+        c.d_hits += (batch[l].fwd_parity == 0);
+        c.a_hits += (batch[l].fwd_parity == bwd_parity);
+        c.hits += (bwd_parity == 0);
+    }
+    c.samples = samples;
+
+    return c;
+}
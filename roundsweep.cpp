@@ -0,0 +1,507 @@
+/*
+ * REFERENCE IMPLEMENTATION OF a round-sweep PNB search
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * Runs the single-bit PNB search (as in altaumstylepnb.cpp) for several distinguishing rounds
+ * and several total rounds at once. Every sample is pushed through the rounds one time:
+ * the forward parity is recorded at every requested distinguishing round and Z = X + X^R is
+ * taken (on a copy, with the modified last round) at every requested total round. For each
+ * total round and each key bit a single backward pass then goes down to the smallest
+ * distinguishing round, reading the parity at every distinguishing round on the way.
+ *
+ * One bias table is produced per (dist_round, total_round) pair. All tables are built from
+ * the same samples (common random numbers), so round-to-round differences are not the noise
+ * of independent runs.
+ *
+ * Round counts are in half-rounds (the granularity of pnbkernel); quarter rounds are rejected.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native roundsweep.cpp -o roundsweep
+ *   ./roundsweep [neutrality] [log2_samples] [dist=<r,r,...>] [total=<r,r,...>] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + forward/backward sample kernel
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+pnbinfo::PNBdetails pnb_config;
+
+constexpr size_t LANES = 16; // key bits per backward batch
+
+static atomic<u64> progress{0};
+
+struct SweepOptions
+{
+    int log2_samples = 18;
+    vector<double> dist_rounds{5};
+    vector<double> total_rounds{7, 7.5, 8};
+};
+
+// the sweep in half-rounds, both lists ascending
+struct SweepPlan
+{
+    pnbkernel::RoundPlan base; // ID, mask, key size
+    vector<int> dist_halves;
+    vector<int> total_halves;
+    u16 key_bits = 256;
+
+    size_t index(size_t t, size_t d, u16 bit) const
+    {
+        return (t * dist_halves.size() + d) * key_bits + bit;
+    }
+};
+
+struct SweepCounts
+{
+    vector<u64> matches; // [total][dist][bit], fwd_parity == bwd_parity
+    vector<u64> d_hits;  // [dist], fwd_parity == 0
+};
+
+template <class C>
+SweepCounts sweepcount(const SweepPlan *sweep, u64 samples);
+
+// "4.5,5" -> {4.5, 5}; values that are not whole half-rounds are dropped
+static vector<double> parse_round_list(const string &list, const char *what)
+{
+    vector<double> rounds;
+    std::stringstream ss(list);
+    string item;
+    while (std::getline(ss, item, ','))
+    {
+        try
+        {
+            const double r = std::stod(item);
+            if (r <= 0.0 || !config::is_valid_round(r, config::RoundGranularity::Half))
+            {
+                std::cerr << what << " " << item << " is not a positive multiple of 0.5, ignored.\n";
+                continue;
+            }
+            rounds.push_back(r);
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid " << what << " " << item << ", ignored.\n";
+        }
+    }
+    std::sort(rounds.begin(), rounds.end());
+    rounds.erase(std::unique(rounds.begin(), rounds.end()), rounds.end());
+    return rounds;
+}
+
+static void parse_cli(int argc, char *argv[], SweepOptions &opt)
+{
+    if (argc >= 2)
+    {
+        try
+        {
+            pnb_config.neutrality_measure = std::stod(argv[1]);
+            if (pnb_config.neutrality_measure < 0.0 || pnb_config.neutrality_measure > 1.0)
+            {
+                std::cerr << "Neutrality must be in [0,1]. Using default 0.35.\n";
+                pnb_config.neutrality_measure = 0.35;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid neutrality input. Using default 0.35.\n";
+            pnb_config.neutrality_measure = 0.35;
+        }
+    }
+
+    if (argc >= 3)
+    {
+        try
+        {
+            opt.log2_samples = std::stoi(argv[2]);
+            if (opt.log2_samples < 8 || opt.log2_samples > 34)
+            {
+                std::cerr << "log2_samples must be in [8,34]. Using default 18.\n";
+                opt.log2_samples = 18;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_samples input. Using default 18.\n";
+            opt.log2_samples = 18;
+        }
+    }
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        if (flag == "log" || flag == "1")
+            basic_config.logfile_flag = true;
+        else if (flag.rfind("dist=", 0) == 0)
+            opt.dist_rounds = parse_round_list(flag.substr(5), "dist round");
+        else if (flag.rfind("total=", 0) == 0)
+            opt.total_rounds = parse_round_list(flag.substr(6), "total round");
+    }
+}
+
+static bool init_config_and_banner(const SweepOptions &opt, SweepPlan &sweep, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "RoundSweep"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.comment = "last round modified";
+
+    diff_config.id = {{7, 31}};
+    diff_config.mask = {{4, 7}};
+
+    if (opt.dist_rounds.empty() || opt.total_rounds.empty() ||
+        opt.dist_rounds.front() > opt.total_rounds.back())
+    {
+        std::cerr << "ERROR: need at least one distinguishing round <= some total round.\n";
+        return false;
+    }
+
+    // the largest pair drives showInfo / the log file name
+    basic_config.total_rounds = opt.total_rounds.back();
+    diff_config.distinguishing_round = opt.dist_rounds.front();
+
+    sweep.base = pnbkernel::makeRoundPlan(basic_config, diff_config);
+    sweep.key_bits = static_cast<u16>(basic_config.key_size);
+    for (double r : opt.dist_rounds)
+        sweep.dist_halves.push_back(static_cast<int>(std::lround(r * 2.0)));
+    for (double r : opt.total_rounds)
+        sweep.total_halves.push_back(static_cast<int>(std::lround(r * 2.0)));
+
+    samples_config.samples_per_batch = 1ULL << opt.log2_samples;
+    samples_config.samples_per_thread =
+        (samples_config.samples_per_batch + samples_config.max_num_threads - 1) / samples_config.max_num_threads;
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    pnbinfo::showPNBConfig(pnb_config, dmsg);
+
+    auto join = [](const vector<double> &v)
+    {
+        std::ostringstream s;
+        for (size_t i{0}; i < v.size(); ++i)
+            s << (i ? ", " : "") << v[i];
+        return s.str();
+    };
+    display::printField(dmsg, "Swept distinguishing rounds", join(opt.dist_rounds));
+    display::printField(dmsg, "Swept total rounds", join(opt.total_rounds));
+    dmsg << basic_config.star_sep;
+
+    return true;
+}
+
+static SweepCounts run_sweep(const SweepPlan &sweep)
+{
+    SweepCounts total;
+    total.matches.assign(sweep.total_halves.size() * sweep.dist_halves.size() * sweep.key_bits, 0);
+    total.d_hits.assign(sweep.dist_halves.size(), 0);
+
+    progress.store(0, std::memory_order_relaxed);
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    SpinnerWithETA spinner("Sweeping rounds ...", &progress,
+                           samples_config.samples_per_thread * samples_config.max_num_threads);
+    spinner.start();
+    #endif
+
+    vector<std::future<SweepCounts>> future_results;
+    future_results.reserve(samples_config.max_num_threads);
+
+    for (u16 thread_number{0}; thread_number < samples_config.max_num_threads; ++thread_number)
+        future_results.emplace_back(arx::dispatch(sweep.base.cipher, [&](auto c)
+                                                  { return async(launch::async, sweepcount<decltype(c)>, &sweep,
+                                                                 static_cast<u64>(samples_config.samples_per_thread)); }));
+
+    try
+    {
+        for (auto &f : future_results)
+        {
+            SweepCounts c = f.get();
+            for (size_t i{0}; i < total.matches.size(); ++i)
+                total.matches[i] += c.matches[i];
+            for (size_t i{0}; i < total.d_hits.size(); ++i)
+                total.d_hits[i] += c.d_hits[i];
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "Thread error: " << e.what() << "\n";
+    }
+
+    #ifdef SPINNER_WITH_ETA_AVAILABLE
+    spinner.stop();
+    #endif
+
+    return total;
+}
+
+static string pair_label(const SweepPlan &sweep, size_t t, size_t d)
+{
+    std::ostringstream s;
+    s << "d" << sweep.dist_halves[d] / 2.0 << "_t" << sweep.total_halves[t] / 2.0;
+    return s.str();
+}
+
+// one summary line per (dist, total) pair on the console, the full bias table per pair in the log
+static void print_tables(const SweepPlan &sweep, const SweepCounts &c, u64 samples,
+                         std::ostream &summary, std::ostream &tables)
+{
+    summary << basic_config.dash_sep;
+    summary << "Format: dist  total  eps_d  #PNBs (|bias| >= " << pnb_config.neutrality_measure << ")\n";
+    summary << basic_config.dash_sep;
+
+    for (size_t t{0}; t < sweep.total_halves.size(); ++t)
+    {
+        for (size_t d{0}; d < sweep.dist_halves.size(); ++d)
+        {
+            if (sweep.dist_halves[d] > sweep.total_halves[t])
+                continue;
+
+            vector<double> bias_per_bit(sweep.key_bits, 0.0);
+            vector<u16> pnbs;
+            for (u16 b{0}; b < sweep.key_bits; ++b)
+            {
+                bias_per_bit[b] = stats::biasFromCount(c.matches[sweep.index(t, d, b)], samples);
+                if (std::fabs(bias_per_bit[b]) >= pnb_config.neutrality_measure && std::fabs(bias_per_bit[b]) > 0.0)
+                    pnbs.push_back(b);
+            }
+
+            summary << std::right << std::fixed << std::setprecision(1)
+                    << std::setw(5) << sweep.dist_halves[d] / 2.0 << "  "
+                    << std::setw(5) << sweep.total_halves[t] / 2.0 << "  "
+                    << std::setprecision(5) << std::setw(9) << stats::biasFromCount(c.d_hits[d], samples) << "  "
+                    << std::setw(5) << pnbs.size() << "\n"
+                    << std::left;
+            pnbinfo::print_braced_list(pnbs, summary);
+
+            tables << basic_config.eq_dash_sep;
+            tables << "Distinguishing round " << sweep.dist_halves[d] / 2.0
+                   << ", total rounds " << sweep.total_halves[t] / 2.0 << ": "
+                   << pnbs.size() << " PNBs\n";
+            pnbinfo::print_bias_list_by_word(bias_per_bit, pnbs, &basic_config, tables);
+        }
+    }
+    summary << basic_config.dash_sep;
+}
+
+// bit, then one bias column per (dist, total) pair
+static bool write_csv(const string &path, const SweepPlan &sweep, const SweepCounts &c, u64 samples)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    out << "bit";
+    for (size_t t{0}; t < sweep.total_halves.size(); ++t)
+        for (size_t d{0}; d < sweep.dist_halves.size(); ++d)
+            if (sweep.dist_halves[d] <= sweep.total_halves[t])
+                out << "," << pair_label(sweep, t, d);
+    out << "\n";
+
+    out << std::setprecision(6);
+    for (u16 b{0}; b < sweep.key_bits; ++b)
+    {
+        out << b;
+        for (size_t t{0}; t < sweep.total_halves.size(); ++t)
+            for (size_t d{0}; d < sweep.dist_halves.size(); ++d)
+                if (sweep.dist_halves[d] <= sweep.total_halves[t])
+                    out << "," << stats::biasFromCount(c.matches[sweep.index(t, d, b)], samples);
+        out << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    SweepOptions opt;
+    parse_cli(argc, argv, opt);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "sweep";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    SweepPlan sweep;
+    if (!init_config_and_banner(opt, sweep, dmsg))
+        return 1;
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    SweepCounts counts = run_sweep(sweep);
+    const u64 samples = samples_config.samples_per_thread * samples_config.max_num_threads;
+
+    stringstream report, tables;
+    print_tables(sweep, counts, samples, report, tables);
+
+    // ---------------- save bias table -----------------
+    string base = pnbinfo::makeLogFilename(basic_config, diff_config, &pnb_config, folder);
+    base = base.substr(0, base.size() - 4); // drop ".txt"
+
+    const string csv = base + "_bias.csv";
+    if (write_csv(csv, sweep, counts, samples))
+        report << "Per-pair bias table saved to: " << csv << "\n";
+    else
+        std::cerr << "ERROR: Could not write " << csv << "\n";
+
+    cout << "\n" << report.str();
+    dmsg << report.str();
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << tables.str();
+        dmsg << timer.end_message();
+
+        std::string filename = base + ".txt";
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: all (dist, total) pairs on this thread's samples -----------------
+template <class C>
+SweepCounts sweepcount(const SweepPlan *sweep, u64 samples)
+{
+    const pnbkernel::RoundPlan &plan = sweep->base;
+    const size_t D = sweep->dist_halves.size();
+    const size_t T = sweep->total_halves.size();
+    const int last_half = sweep->total_halves.back();
+
+    SweepCounts c;
+    c.matches.assign(T * D * sweep->key_bits, 0);
+    c.d_hits.assign(D, 0);
+
+    salsa::InitKey init_key;
+    u32 x0[STATEWORD_COUNT], key[KEYWORD_COUNT], iv[arx::IV_WORD_COUNT];
+    u32 x[STATEWORD_COUNT], dx[STATEWORD_COUNT], tx[STATEWORD_COUNT], tdx[STATEWORD_COUNT];
+    vector<u8> fwd_parity(D);
+    vector<std::array<u32, STATEWORD_COUNT>> z(T), dz(T);
+
+    u32 guesses[LANES][KEYWORD_COUNT];
+    pnbkernel::LaneState<LANES> lx, ldx;
+
+    for (u64 loop{0}; loop < samples; ++loop)
+    {
+        // ---------------- cipher setup (iv, then key, as generateSample) -----------------
+        for (size_t i{0}; i < arx::IV_WORD_COUNT; ++i)
+            iv[i] = RandomNumber<u32>();
+        if (plan.key_128)
+            init_key.key_128bit(key);
+        else
+            init_key.key_256bit(key);
+        pnbkernel::initialState<C>(x0, iv, key);
+
+        ops::copyState(x, x0);
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            dx[i] = x0[i] ^ plan.id_words[i];
+
+        // ---------------- one forward pass, snapshots at every requested round -----------------
+        size_t next_d{0}, next_t{0};
+        for (int h{1}; h <= last_half; ++h)
+        {
+            pnbkernel::forwardHalf<C>(x, h);
+            pnbkernel::forwardHalf<C>(dx, h);
+
+            if (next_d < D && sweep->dist_halves[next_d] == h)
+            {
+                fwd_parity[next_d] = pnbkernel::maskParity(x, dx, plan.mask_words);
+                c.d_hits[next_d] += (fwd_parity[next_d] == 0);
+                ++next_d;
+            }
+
+            if (next_t < T && sweep->total_halves[next_t] == h)
+            {
+                ops::copyState(tx, x);
+                ops::copyState(tdx, dx);
+                pnbkernel::lastRoundTail<C>(tx);
+                pnbkernel::lastRoundTail<C>(tdx);
+
+                // Z = X + X^R
+                for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+                {
+                    z[next_t][i] = tx[i] + x0[i];
+                    dz[next_t][i] = tdx[i] + (x0[i] ^ plan.id_words[i]);
+                }
+                ++next_t;
+            }
+        }
+
+        // ---------------- backward: one pass per (total, key bit), parity at every dist -----------------
+        for (size_t t{0}; t < T; ++t)
+        {
+            for (u16 b0{0}; b0 < sweep->key_bits; b0 += LANES)
+            {
+                for (size_t l{0}; l < LANES; ++l)
+                {
+                    ops::copyState(guesses[l], key, 0, KEYWORD_COUNT);
+                    pnbkernel::toggleKeyBit(guesses[l], static_cast<u16>(b0 + l), plan.key_128);
+                }
+
+                pnbkernel::laneLoadBackward<LANES, C>(plan, iv, z[t].data(), dz[t].data(), guesses, lx, ldx);
+                pnbkernel::laneUndoLastRoundTail<LANES, C>(lx);
+                pnbkernel::laneUndoLastRoundTail<LANES, C>(ldx);
+
+                int h = sweep->total_halves[t];
+                for (size_t d{D}; d-- > 0;)
+                {
+                    if (sweep->dist_halves[d] > h)
+                        continue;
+                    for (; h > sweep->dist_halves[d]; --h)
+                    {
+                        pnbkernel::laneBackwardHalf<LANES, C>(lx, h);
+                        pnbkernel::laneBackwardHalf<LANES, C>(ldx, h);
+                    }
+
+                    const u64 parities = pnbkernel::laneMaskParity(lx, ldx, plan.mask_words);
+                    u64 *m = &c.matches[sweep->index(t, d, b0)];
+                    for (size_t l{0}; l < LANES; ++l)
+                        m[l] += (fwd_parity[d] == ((parities >> l) & 1));
+                }
+            }
+        }
+
+        progress.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return c;
+}
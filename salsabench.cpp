@@ -0,0 +1,457 @@
+/*
+ * REFERENCE IMPLEMENTATION OF a microbenchmark for the Salsa round primitives
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * Times every round primitive and state operation on a fixed working set of STATE_COUNT
+ * states (small enough to stay in L1) and reports reference cycles and items per second
+ * for each. An item is one state for the round functions and state ops, one quarter-round
+ * step on one column for QR_7 .. QR_18, one 32-bit word for RandomNumber<u32> and one
+ * 64-byte block for the keystream; the lane-batched kernels are normalised per state, so
+ * they compare directly with their scalar counterparts.
+ *
+ * Every benchmark starts from the same states (drawn from a fixed seed), runs `warmup`
+ * untimed trials, sizes its trials to about TRIAL_SECONDS, then runs `trials` timed trials.
+ * The median is the headline number; min, mean and the relative sd are reported next to
+ * it. Cycles are TSC reference cycles (cycles::fenced), so with turbo they differ from
+ * core cycles by the turbo ratio.
+ *
+ * The results are written as JSON to bench_output.txt (out=<file> to change): the machine
+ * description, the run settings and one object per benchmark.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native salsabench.cpp -o salsabench
+ *   ./salsabench [trials=<n>] [warmup=<n>] [seed=<n>] [only=<substring>] [out=<file>] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp, keystream.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + lane-batched state
+#include "header/keystream.hpp" // Salsa20 keystream blocks
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+
+constexpr size_t STATE_COUNT = 256; // working set: 256 x 64 bytes = 16 KiB per buffer
+constexpr size_t LANES = 16;        // lane width of the batched kernels
+constexpr size_t LANE_BATCHES = STATE_COUNT / LANES;
+constexpr double TRIAL_SECONDS = 2e-3;
+
+struct BenchOptions
+{
+    int trials = 15;
+    int warmup = 3;
+    u64 seed = 0x5a15a20;
+    string only;
+    string out_file = "bench_output.txt";
+};
+
+// ---------------- working set -----------------
+alignas(64) static u32 xs[STATE_COUNT][STATEWORD_COUNT];
+alignas(64) static u32 ys[STATE_COUNT][STATEWORD_COUNT];
+static pnbkernel::LaneState<LANES> lanes[LANE_BATCHES];
+alignas(64) static u8 blocks_out[STATE_COUNT * keystream::BLOCK_BYTES];
+
+struct BenchCase
+{
+    string name;
+    string unit;              // what one item is
+    u64 items;                // items per pass
+    std::function<void()> pass; // one pass over the working set
+};
+
+struct BenchResult
+{
+    string name;
+    string unit;
+    u64 items_per_trial = 0;
+    vector<double> cycles; // per item, one entry per trial
+    double median = 0, min = 0, mean = 0, rsd = 0;
+};
+
+BenchResult runcase(const BenchCase &bc, const BenchOptions &opt);
+
+static void parse_cli(int argc, char *argv[], BenchOptions &opt)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string flag = argv[i];
+        std::string lower = flag;
+        std::transform(lower.begin(), lower.end(), lower.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        try
+        {
+            if (lower == "log" || lower == "1")
+                basic_config.logfile_flag = true;
+            else if (lower.rfind("trials=", 0) == 0)
+                opt.trials = std::max(1, std::stoi(flag.substr(7)));
+            else if (lower.rfind("warmup=", 0) == 0)
+                opt.warmup = std::max(0, std::stoi(flag.substr(7)));
+            else if (lower.rfind("seed=", 0) == 0)
+                opt.seed = std::stoull(flag.substr(5), nullptr, 0);
+            else if (lower.rfind("only=", 0) == 0)
+                opt.only = flag.substr(5);
+            else if (lower.rfind("out=", 0) == 0)
+                opt.out_file = flag.substr(4);
+            else
+                std::cerr << "Ignoring unknown argument: " << flag << "\n";
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid value in " << flag << ". Using the default.\n";
+        }
+    }
+}
+
+static void init_config_and_banner(const BenchOptions &opt, size_t cases, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "Microbenchmark"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.total_rounds = 1;
+
+    display::showInfo(&basic_config, nullptr, nullptr, dmsg);
+    display::printField(dmsg, "Benchmarks", cases);
+    display::printField(dmsg, "Trials (+ warmup)", std::to_string(opt.trials) + " (+ " + std::to_string(opt.warmup) + ")");
+    display::printField(dmsg, "States in working set", STATE_COUNT);
+    display::printField(dmsg, "Seed", opt.seed);
+    {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(3) << cycles::ticksPerSecond() / 1e9 << " GHz";
+        display::printField(dmsg, "Reference cycle rate", s.str());
+    }
+    display::printField(dmsg, "JSON output", opt.out_file);
+    dmsg << basic_config.star_sep;
+}
+
+// every benchmark starts from the same states
+static void reset_working_set(u64 seed)
+{
+    thread_rng().seed(static_cast<std::mt19937::result_type>(seed));
+    for (size_t s{0}; s < STATE_COUNT; ++s)
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+        {
+            xs[s][i] = RandomNumber<u32>();
+            ys[s][i] = RandomNumber<u32>();
+        }
+    for (size_t b{0}; b < LANE_BATCHES; ++b)
+        for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+            for (size_t l{0}; l < LANES; ++l)
+                lanes[b].w[i][l] = xs[b * LANES + l][i];
+}
+
+static vector<BenchCase> make_cases()
+{
+    vector<BenchCase> cases;
+    auto per_state = [&](const string &name, auto fn)
+    {
+        cases.push_back({name, "state", STATE_COUNT, [fn]
+                         {
+                             for (size_t s{0}; s < STATE_COUNT; ++s)
+                                 fn(xs[s], ys[s]);
+                         }});
+    };
+
+    // ---------------- quarter-round steps (column 1) -----------------
+    auto per_call = [&](const string &name, auto fn)
+    {
+        cases.push_back({name, "call", STATE_COUNT, [fn]
+                         {
+                             for (size_t s{0}; s < STATE_COUNT; ++s)
+                                 fn(xs[s]);
+                         }});
+    };
+    per_call("QR_7", [](u32 *x) { QR_7(x[0], x[4], x[8], x[12], false); });
+    per_call("QR_9", [](u32 *x) { QR_9(x[0], x[4], x[8], x[12], false); });
+    per_call("QR_13", [](u32 *x) { QR_13(x[0], x[4], x[8], x[12], false); });
+    per_call("QR_18", [](u32 *x) { QR_18(x[0], x[4], x[8], x[12], false); });
+
+    // ---------------- one step on all four columns / rows -----------------
+    per_state("ODDARX_7", [](u32 *x, u32 *) { qr.ODDARX_7(x); });
+    per_state("ODDARX_9", [](u32 *x, u32 *) { qr.ODDARX_9(x); });
+    per_state("ODDARX_13", [](u32 *x, u32 *) { qr.ODDARX_13(x); });
+    per_state("ODDARX_18", [](u32 *x, u32 *) { qr.ODDARX_18(x); });
+    per_state("EVENARX_7", [](u32 *x, u32 *) { qr.EVENARX_7(x); });
+    per_state("EVENARX_9", [](u32 *x, u32 *) { qr.EVENARX_9(x); });
+    per_state("EVENARX_13", [](u32 *x, u32 *) { qr.EVENARX_13(x); });
+    per_state("EVENARX_18", [](u32 *x, u32 *) { qr.EVENARX_18(x); });
+
+    // ---------------- full rounds (odd = column round, even = row round) -----------------
+    per_state("FORWARD::RoundFunction odd", [](u32 *x, u32 *) { frward.RoundFunction(x, 1); });
+    per_state("FORWARD::RoundFunction even", [](u32 *x, u32 *) { frward.RoundFunction(x, 2); });
+    per_state("BACKWARD::RoundFunction odd", [](u32 *x, u32 *) { bckward.RoundFunction(x, 1); });
+    per_state("BACKWARD::RoundFunction even", [](u32 *x, u32 *) { bckward.RoundFunction(x, 2); });
+    per_state("FORWARD::XRoundFunction odd", [](u32 *x, u32 *) { frward.XRoundFunction(x, 1); });
+    per_state("BACKWARD::XRoundFunction odd", [](u32 *x, u32 *) { bckward.XRoundFunction(x, 1); });
+
+    // ---------------- generated kernels, scalar (one half-round) -----------------
+    per_state("arx::forwardHalf<Salsa>", [](u32 *x, u32 *) { arx::forwardHalf<arx::Salsa>(x, 1); });
+    per_state("arx::backwardHalf<Salsa>", [](u32 *x, u32 *) { arx::backwardHalf<arx::Salsa>(x, 1); });
+    per_state("arx::forwardHalf<ChaCha>", [](u32 *x, u32 *) { arx::forwardHalf<arx::ChaCha>(x, 1); });
+
+    // ---------------- state ops -----------------
+    per_state("ops::xorState", [](u32 *x, u32 *y) { ops::xorState(x, y, x); });
+    per_state("ops::addState", [](u32 *x, u32 *y) { ops::addState(x, y, x); });
+    per_state("ops::subtractState", [](u32 *x, u32 *y) { ops::subtractState(x, y, x); });
+    per_state("ops::copyState", [](u32 *x, u32 *y) { ops::copyState(y, x); });
+
+    cases.push_back({"RandomNumber<u32>", "word", STATE_COUNT * STATEWORD_COUNT, []
+                     {
+                         for (size_t s{0}; s < STATE_COUNT; ++s)
+                             for (size_t i{0}; i < STATEWORD_COUNT; ++i)
+                                 xs[s][i] = RandomNumber<u32>();
+                     }});
+
+    // ---------------- lane-batched kernels (per state = per lane) -----------------
+    auto per_lane = [&](const string &name, auto fn)
+    {
+        cases.push_back({name, "state", STATE_COUNT, [fn]
+                         {
+                             for (size_t b{0}; b < LANE_BATCHES; ++b)
+                                 fn(lanes[b]);
+                         }});
+    };
+    per_lane("laneForwardHalf<16,Salsa> odd", [](pnbkernel::LaneState<LANES> &s)
+             { pnbkernel::laneForwardHalf<LANES, arx::Salsa>(s, 1); });
+    per_lane("laneForwardHalf<16,Salsa> even", [](pnbkernel::LaneState<LANES> &s)
+             { pnbkernel::laneForwardHalf<LANES, arx::Salsa>(s, 2); });
+    per_lane("laneBackwardHalf<16,Salsa> odd", [](pnbkernel::LaneState<LANES> &s)
+             { pnbkernel::laneBackwardHalf<LANES, arx::Salsa>(s, 1); });
+    per_lane("laneForwardHalf<16,ChaCha> odd", [](pnbkernel::LaneState<LANES> &s)
+             { pnbkernel::laneForwardHalf<LANES, arx::ChaCha>(s, 1); });
+    per_lane("laneUndoLastRoundTail<16,Salsa>", [](pnbkernel::LaneState<LANES> &s)
+             { pnbkernel::laneUndoLastRoundTail<LANES, arx::Salsa>(s); });
+
+    // ---------------- Salsa20/20 keystream blocks -----------------
+    cases.push_back({"keystream::salsaBlocks<16> (20 rounds)", "block", STATE_COUNT, []
+                     {
+                         for (size_t b{0}; b < LANE_BATCHES; ++b)
+                             keystream::salsaBlocks<LANES>(xs[0], b * LANES, 20,
+                                                           blocks_out + b * LANES * keystream::BLOCK_BYTES);
+                     }});
+    cases.push_back({"keystream::salsaBlocks<1> (20 rounds)", "block", STATE_COUNT, []
+                     {
+                         for (size_t b{0}; b < STATE_COUNT; ++b)
+                             keystream::salsaBlocks<1>(xs[0], b, 20, blocks_out + b * keystream::BLOCK_BYTES);
+                     }});
+
+    return cases;
+}
+
+static string json_escape(const string &s)
+{
+    string r;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            r += '\\';
+        r += c;
+    }
+    return r;
+}
+
+static void write_json(const string &filename, const BenchOptions &opt, const vector<BenchResult> &results)
+{
+    std::ofstream f(filename);
+    if (!f)
+        throw std::runtime_error("could not write " + filename);
+
+    const double rate = cycles::ticksPerSecond();
+    std::time_t t = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+
+    f << std::setprecision(6);
+    f << "{\n";
+    f << "  \"program\": \"salsabench\",\n";
+    f << "  \"date\": \"" << std::put_time(&tm, "%Y-%m-%dT%H:%M:%S") << "\",\n";
+    f << "  \"compiler\": \"" << json_escape(__VERSION__) << "\",\n";
+    f << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    f << "  \"ref_cycles_per_second\": " << rate << ",\n";
+    f << "  \"trials\": " << opt.trials << ",\n";
+    f << "  \"warmup\": " << opt.warmup << ",\n";
+    f << "  \"seed\": " << opt.seed << ",\n";
+    f << "  \"states_in_working_set\": " << STATE_COUNT << ",\n";
+    f << "  \"benchmarks\": [\n";
+    for (size_t i{0}; i < results.size(); ++i)
+    {
+        const BenchResult &r = results[i];
+        f << "    {\"name\": \"" << json_escape(r.name) << "\", \"unit\": \"" << r.unit << "\""
+          << ", \"items_per_trial\": " << r.items_per_trial
+          << ", \"cycles_per_item\": {\"median\": " << r.median << ", \"min\": " << r.min
+          << ", \"mean\": " << r.mean << ", \"rsd\": " << r.rsd << "}"
+          << ", \"items_per_second\": " << rate / r.median << ", \"trials\": [";
+        for (size_t j{0}; j < r.cycles.size(); ++j)
+            f << (j ? ", " : "") << r.cycles[j];
+        f << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    f << "  ]\n}\n";
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    BenchOptions opt;
+    parse_cli(argc, argv, opt);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "salsabench";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    vector<BenchCase> cases;
+    for (BenchCase &bc : make_cases())
+        if (opt.only.empty() || bc.name.find(opt.only) != string::npos)
+            cases.push_back(std::move(bc));
+
+    if (cases.empty())
+    {
+        cerr << "ERROR: no benchmark matches only=" << opt.only << "\n";
+        return 1;
+    }
+
+    init_config_and_banner(opt, cases.size(), dmsg);
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    vector<BenchResult> results;
+    results.reserve(cases.size());
+
+    stringstream report;
+    report << basic_config.dash_sep;
+    report << std::left << std::setw(42) << "Benchmark" << std::right << std::setw(8) << "unit"
+           << std::setw(14) << "cycles/item" << std::setw(12) << "min" << std::setw(9) << "rsd %"
+           << std::setw(16) << "items/s" << "\n";
+    report << basic_config.dash_sep;
+
+    for (const BenchCase &bc : cases)
+    {
+        results.push_back(runcase(bc, opt));
+        const BenchResult &r = results.back();
+
+        std::ostringstream line;
+        line << std::left << std::setw(42) << r.name << std::right << std::setw(8) << r.unit << std::fixed
+             << std::setprecision(3) << std::setw(14) << r.median << std::setw(12) << r.min
+             << std::setprecision(2) << std::setw(9) << 100.0 * r.rsd << std::scientific << std::setprecision(3)
+             << std::setw(16) << cycles::ticksPerSecond() / r.median << "\n";
+        report << line.str();
+        cout << line.str() << std::flush;
+    }
+    report << basic_config.dash_sep;
+    cout << basic_config.dash_sep;
+    dmsg << report.str();
+
+    try
+    {
+        write_json(opt.out_file, opt, results);
+        cout << "JSON written to: " << opt.out_file << "\n";
+    }
+    catch (const exception &e)
+    {
+        cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = pnbinfo::makeLogFilename(basic_config, diff_config, nullptr, folder);
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- runner: warmup, trial sizing, timed trials -----------------
+BenchResult runcase(const BenchCase &bc, const BenchOptions &opt)
+{
+    reset_working_set(opt.seed);
+
+    auto timed = [&](u64 passes)
+    {
+        const u64 t0 = cycles::fenced();
+        for (u64 p{0}; p < passes; ++p)
+        {
+            bc.pass();
+            cycles::keep(xs);
+            cycles::keep(lanes);
+            cycles::keep(blocks_out);
+        }
+        return cycles::fenced() - t0;
+    };
+
+    // grow the pass count until one trial takes about TRIAL_SECONDS
+    const double target = TRIAL_SECONDS * cycles::ticksPerSecond();
+    u64 passes = 1;
+    while (passes < (1ULL << 30))
+    {
+        const u64 ticks = timed(passes);
+        if (static_cast<double>(ticks) >= target)
+            break;
+        passes = (ticks == 0) ? passes * 16
+                              : std::max<u64>(passes * 2, static_cast<u64>(passes * target / ticks * 1.1));
+    }
+
+    for (int w{0}; w < opt.warmup; ++w)
+        timed(passes);
+
+    BenchResult r;
+    r.name = bc.name;
+    r.unit = bc.unit;
+    r.items_per_trial = passes * bc.items;
+    for (int t{0}; t < opt.trials; ++t)
+        r.cycles.push_back(static_cast<double>(timed(passes)) / static_cast<double>(r.items_per_trial));
+
+    vector<double> sorted = r.cycles;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t n = sorted.size();
+    r.median = (n & 1) ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+    r.min = sorted.front();
+    for (double c : sorted)
+        r.mean += c;
+    r.mean /= n;
+    double var = 0;
+    for (double c : sorted)
+        var += (c - r.mean) * (c - r.mean);
+    r.rsd = (n > 1 && r.mean > 0) ? std::sqrt(var / (n - 1)) / r.mean : 0.0;
+
+    return r;
+}
@@ -0,0 +1,478 @@
+/*
+ * REFERENCE IMPLEMENTATION OF the Salsa20 file encryption / keystream tool
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * Encrypts or decrypts a file with Salsa20/R or XSalsa20/R, or writes raw keystream of a
+ * given length (reduced-round corpora for statistical testing). The input is memory-mapped
+ * read-only and the output is a memory-mapped file of the same size. When the output names
+ * the input file (same path, another path or a link) the file is encrypted in place. The
+ * stream is cut into 64 MiB block-counter ranges that the worker threads take in turn.
+ * Each range is XORed (or, for `stream`, written) straight into the output mapping by
+ * keystream::Salsa20::apply / keystream(), with no per-range allocation and no staging
+ * copy of the data.
+ *
+ * key=<hex> is 16 or 32 bytes and nonce=<hex> is 8 bytes (Salsa20) or 24 bytes (XSalsa20).
+ * enc/dec need a key. stream draws key and nonce when they are not given and prints them.
+ * offset=<bytes> starts at that byte of the stream, so a file can be continued or
+ * split over several runs.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native -mprefer-vector-width=512 salsacrypt.cpp -o salsacrypt
+ *   ./salsacrypt enc|dec <in_file> <out_file> key=<hex> [nonce=<hex>] [rounds=<R>] [offset=<bytes>] [log]
+ *   ./salsacrypt stream <bytes>[K|M|G|T] <out_file> [key=<hex>] [nonce=<hex>] [rounds=<R>] [offset=<bytes>] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, arx.hpp, keystream.hpp
+ */
+
+#include "header/keystream.hpp" // Salsa20 / XSalsa20 keystream
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+
+constexpr u64 RANGE_BYTES = 64ULL << 20; // bytes per work item, a multiple of the block size
+
+static atomic<u64> progress{0};   // bytes done
+static atomic<u64> next_range{0}; // next work item
+
+struct CryptOptions
+{
+    string mode; // enc, dec or stream
+    string in_file;
+    string out_file;
+    u64 stream_bytes = 0;
+    string key_hex;
+    string nonce_hex;
+    int rounds = 20;
+    u64 offset = 0;
+};
+
+u64 cryptranges(const keystream::Salsa20 *cipher, const u8 *in, u8 *out, u64 bytes, u64 offset);
+
+static string errnoText(const string &what, const string &path)
+{
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+/**
+ * A file mapped shared, read-only or read-write. A writable mapping of a new file creates it
+ * with the requested size. Throws std::runtime_error on I/O errors.
+ */
+class MappedFile
+{
+public:
+    MappedFile(const string &path, bool writable, bool create = false, u64 bytes = 0) : path_(path)
+    {
+        const int flags = writable ? (create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR) : O_RDONLY;
+        fd_ = ::open(path.c_str(), flags, 0644);
+        if (fd_ < 0)
+            throw std::runtime_error(errnoText("salsacrypt: cannot open", path));
+
+        if (create)
+        {
+            if (::ftruncate(fd_, static_cast<off_t>(bytes)) != 0)
+            {
+                ::close(fd_);
+                throw std::runtime_error(errnoText("salsacrypt: cannot size", path));
+            }
+            bytes_ = bytes;
+        }
+        else
+        {
+            struct stat st{};
+            if (::fstat(fd_, &st) != 0)
+            {
+                ::close(fd_);
+                throw std::runtime_error(errnoText("salsacrypt: cannot stat", path));
+            }
+            bytes_ = static_cast<u64>(st.st_size);
+        }
+
+        if (bytes_ == 0)
+            return; // nothing to map
+
+        void *p = ::mmap(nullptr, bytes_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED)
+        {
+            ::close(fd_);
+            throw std::runtime_error(errnoText("salsacrypt: cannot map", path));
+        }
+        base_ = static_cast<u8 *>(p);
+        ::madvise(p, bytes_, MADV_SEQUENTIAL);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { release(); }
+
+    u8 *data() { return base_; }
+    u64 bytes() const { return bytes_; }
+
+    void flush()
+    {
+        if (base_ && ::msync(base_, bytes_, MS_SYNC) != 0)
+            throw std::runtime_error(errnoText("salsacrypt: cannot flush", path_));
+    }
+
+private:
+    void release()
+    {
+        if (base_)
+            ::munmap(base_, bytes_);
+        if (fd_ >= 0)
+            ::close(fd_);
+        base_ = nullptr;
+        fd_ = -1;
+    }
+
+    string path_;
+    int fd_ = -1;
+    u64 bytes_ = 0;
+    u8 *base_ = nullptr;
+};
+
+static string toHex(const u8 *p, size_t n)
+{
+    std::ostringstream s;
+    for (size_t i{0}; i < n; ++i)
+        s << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(p[i]);
+    return s.str();
+}
+
+// hex string -> bytes; throws on odd length or a non-hex digit
+static vector<u8> fromHex(string hex)
+{
+    if (hex.rfind("0x", 0) == 0 || hex.rfind("0X", 0) == 0)
+        hex = hex.substr(2);
+    if (hex.size() % 2 != 0)
+        throw std::invalid_argument("hex string of odd length: " + hex);
+    vector<u8> out(hex.size() / 2);
+    for (size_t i{0}; i < out.size(); ++i)
+    {
+        if (!std::isxdigit(static_cast<unsigned char>(hex[2 * i])) || !std::isxdigit(static_cast<unsigned char>(hex[2 * i + 1])))
+            throw std::invalid_argument("not a hex string: " + hex);
+        out[i] = static_cast<u8>(std::stoul(hex.substr(2 * i, 2), nullptr, 16));
+    }
+    return out;
+}
+
+// 123, 64K, 3G, 1T (binary multiples)
+static u64 parseBytes(const string &s)
+{
+    size_t pos = 0;
+    const u64 v = std::stoull(s, &pos);
+    if (pos == s.size())
+        return v;
+    if (pos + 1 != s.size())
+        throw std::invalid_argument("bad size: " + s);
+    switch (std::toupper(static_cast<unsigned char>(s[pos])))
+    {
+    case 'K':
+        return v << 10;
+    case 'M':
+        return v << 20;
+    case 'G':
+        return v << 30;
+    case 'T':
+        return v << 40;
+    }
+    throw std::invalid_argument("bad size suffix: " + s);
+}
+
+static bool parse_cli(int argc, char *argv[], CryptOptions &opt)
+{
+    auto usage = [&]()
+    {
+        std::cerr << "Usage: " << argv[0] << " enc|dec <in_file> <out_file> key=<hex> [nonce=<hex>] [rounds=<R>] [offset=<bytes>] [log]\n"
+                  << "       " << argv[0] << " stream <bytes>[K|M|G|T] <out_file> [key=<hex>] [nonce=<hex>] [rounds=<R>] [offset=<bytes>] [log]\n";
+        return false;
+    };
+
+    if (argc < 4)
+        return usage();
+
+    opt.mode = argv[1];
+    if (opt.mode != "enc" && opt.mode != "dec" && opt.mode != "stream")
+        return usage();
+
+    try
+    {
+        if (opt.mode == "stream")
+            opt.stream_bytes = parseBytes(argv[2]);
+        else
+            opt.in_file = argv[2];
+        opt.out_file = argv[3];
+
+        for (int i = 4; i < argc; ++i)
+        {
+            std::string flag = argv[i];
+            std::string lower = flag;
+            std::transform(lower.begin(), lower.end(), lower.begin(),
+                           [](unsigned char c)
+                           { return static_cast<char>(std::tolower(c)); });
+
+            if (lower == "log" || lower == "1")
+                basic_config.logfile_flag = true;
+            else if (lower.rfind("key=", 0) == 0)
+                opt.key_hex = flag.substr(4);
+            else if (lower.rfind("nonce=", 0) == 0)
+                opt.nonce_hex = flag.substr(6);
+            else if (lower.rfind("rounds=", 0) == 0)
+                opt.rounds = std::stoi(flag.substr(7));
+            else if (lower.rfind("offset=", 0) == 0)
+                opt.offset = parseBytes(flag.substr(7));
+            else
+            {
+                std::cerr << "Unknown argument: " << flag << "\n";
+                return usage();
+            }
+        }
+    }
+    catch (const exception &e)
+    {
+        std::cerr << "Invalid argument: " << e.what() << "\n";
+        return false;
+    }
+
+    if (opt.mode != "stream" && opt.key_hex.empty())
+    {
+        std::cerr << "enc/dec need key=<hex>.\n";
+        return false;
+    }
+    return true;
+}
+
+// key / nonce from the options, drawn at random when not given (stream only)
+static void make_key_nonce(const CryptOptions &opt, vector<u8> &key, vector<u8> &nonce)
+{
+    auto random_bytes = [](size_t n)
+    {
+        vector<u8> v(n);
+        for (auto &b : v)
+            b = static_cast<u8>(RandomNumber<u32>() & 0xff);
+        return v;
+    };
+
+    key = opt.key_hex.empty() ? random_bytes(keystream::KEY_BYTES) : fromHex(opt.key_hex);
+    nonce = opt.nonce_hex.empty() ? vector<u8>(keystream::NONCE_BYTES, 0) : fromHex(opt.nonce_hex);
+    if (opt.key_hex.empty() && opt.nonce_hex.empty())
+        nonce = random_bytes(keystream::NONCE_BYTES);
+
+    if (key.size() != 16 && key.size() != keystream::KEY_BYTES)
+        throw std::invalid_argument("key must be 16 or 32 bytes");
+    if (nonce.size() != keystream::NONCE_BYTES && nonce.size() != keystream::XNONCE_BYTES)
+        throw std::invalid_argument("nonce must be 8 (Salsa20) or 24 (XSalsa20) bytes");
+    if (nonce.size() == keystream::XNONCE_BYTES && key.size() != keystream::KEY_BYTES)
+        throw std::invalid_argument("XSalsa20 needs a 32-byte key");
+}
+
+static void init_config_and_banner(const CryptOptions &opt, const vector<u8> &key, const vector<u8> &nonce,
+                                   u64 bytes, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = (nonce.size() == keystream::XNONCE_BYTES) ? "xsalsa" : "salsa";
+    basic_config.mode = "Keystream"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = static_cast<int>(key.size() * 8);
+    basic_config.total_rounds = opt.rounds;
+
+    samples_config.samples_per_batch = (bytes + keystream::BLOCK_BYTES - 1) / keystream::BLOCK_BYTES;
+    samples_config.samples_per_thread = RANGE_BYTES / keystream::BLOCK_BYTES;
+
+    display::showInfo(&basic_config, nullptr, nullptr, dmsg);
+    display::printField(dmsg, "Operation", opt.mode);
+    if (opt.mode != "stream")
+        display::printField(dmsg, "Input file", opt.in_file);
+    display::printField(dmsg, "Output file", opt.out_file + (opt.out_file == opt.in_file ? " (in place)" : ""));
+    display::printField(dmsg, "Key", toHex(key.data(), key.size()));
+    display::printField(dmsg, "Nonce", toHex(nonce.data(), nonce.size()));
+    display::printField(dmsg, "Stream offset (bytes)", opt.offset);
+    display::printField(dmsg, "Bytes", bytes);
+    display::printField(dmsg, "Blocks", display::formatCountPow2Pow10(samples_config.samples_per_batch));
+    display::printField(dmsg, "Threads", samples_config.max_num_threads);
+    display::printField(dmsg, "Lanes per pass", keystream::NATIVE_LANES);
+    dmsg << basic_config.star_sep;
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    CryptOptions opt;
+    if (!parse_cli(argc, argv, opt))
+        return 1;
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "salsacrypt";
+
+    dmsg << timer.start_message();
+
+    try
+    {
+        keystream::selfTest();
+
+        // ---------------- config -----------------
+        vector<u8> key, nonce;
+        make_key_nonce(opt, key, nonce);
+
+        // same file under another name (./a.bin, a hard link, a symlink) is in place too: mapping
+        // it as input and truncating it as output would read zeros
+        std::error_code same_ec;
+        const bool in_place = (opt.mode != "stream" &&
+                               (opt.out_file == opt.in_file || std::filesystem::equivalent(opt.in_file, opt.out_file, same_ec)));
+        std::unique_ptr<MappedFile> in, out;
+        if (opt.mode == "stream")
+            out = std::make_unique<MappedFile>(opt.out_file, true, true, opt.stream_bytes);
+        else if (in_place)
+            out = std::make_unique<MappedFile>(opt.out_file, true);
+        else
+        {
+            in = std::make_unique<MappedFile>(opt.in_file, false);
+            out = std::make_unique<MappedFile>(opt.out_file, true, true, in->bytes());
+        }
+        const u64 bytes = out->bytes();
+        const u8 *src = in ? in->data() : (in_place ? out->data() : nullptr);
+
+        init_config_and_banner(opt, key, nonce, bytes, dmsg);
+
+        cout << dmsg.str() << std::flush;
+        // ---------------- config end -----------------
+
+        const keystream::Salsa20 cipher =
+            (nonce.size() == keystream::XNONCE_BYTES)
+                ? keystream::xsalsa20(key.data(), nonce.data(), opt.rounds)
+                : keystream::Salsa20(key.data(), key.size(), nonce.data(), opt.rounds);
+
+        progress.store(0, std::memory_order_relaxed);
+        next_range.store(0, std::memory_order_relaxed);
+
+        #ifdef SPINNER_WITH_ETA_AVAILABLE
+        SpinnerWithETA spinner(opt.mode == "stream" ? "Writing keystream ..." : "XORing keystream ...", &progress, bytes);
+        spinner.start();
+        #endif
+
+        const auto t0 = std::chrono::steady_clock::now();
+
+        vector<std::future<u64>> future_results;
+        future_results.reserve(samples_config.max_num_threads);
+        for (u16 thread_number{0}; thread_number < samples_config.max_num_threads; ++thread_number)
+            future_results.emplace_back(async(launch::async, cryptranges, &cipher, src, out->data(), bytes, opt.offset));
+
+        u64 done = 0;
+        for (auto &f : future_results)
+            done += f.get();
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        #ifdef SPINNER_WITH_ETA_AVAILABLE
+        spinner.stop();
+        #endif
+
+        const auto t1 = std::chrono::steady_clock::now();
+        out->flush();
+        const double flush_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+
+        stringstream report;
+        report << basic_config.dash_sep;
+        display::printField(report, "Bytes processed", done);
+        {
+            std::ostringstream s;
+            s << std::fixed << std::setprecision(2) << (seconds > 0 ? done / seconds / 1e9 : 0.0) << " GB/s ("
+              << std::setprecision(3) << seconds << " s)";
+            display::printField(report, "Keystream throughput", s.str());
+        }
+        {
+            std::ostringstream s;
+            s << std::fixed << std::setprecision(2) << (seconds + flush_seconds > 0 ? done / (seconds + flush_seconds) / 1e9 : 0.0)
+              << " GB/s (" << std::setprecision(3) << flush_seconds << " s flush)";
+            display::printField(report, "Including write-back", s.str());
+        }
+        display::printField(report, "Output saved to", opt.out_file);
+        report << basic_config.dash_sep;
+
+        cout << "\n" << report.str();
+        dmsg << report.str();
+    }
+    catch (const exception &e)
+    {
+        cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = pnbinfo::makeLogFilename(basic_config, diff_config, nullptr, folder);
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: takes RANGE_BYTES ranges until the stream is covered -----------------
+// in == nullptr writes plain keystream; in == out encrypts in place
+u64 cryptranges(const keystream::Salsa20 *cipher, const u8 *in, u8 *out, u64 bytes, u64 offset)
+{
+    u64 done = 0;
+    for (;;)
+    {
+        const u64 first = next_range.fetch_add(1, std::memory_order_relaxed) * RANGE_BYTES;
+        if (first >= bytes)
+            break;
+        const u64 n = std::min(RANGE_BYTES, bytes - first);
+#ifdef MADV_POPULATE_WRITE
+        ::madvise(out + first, n, MADV_POPULATE_WRITE);
+#endif
+#ifdef MADV_POPULATE_READ
+        if (in && in != out)
+            ::madvise(const_cast<u8 *>(in) + first, n, MADV_POPULATE_READ);
+#endif
+
+        if (in)
+            cipher->apply(offset + first, in + first, out + first, n);
+        else
+            cipher->keystream(offset + first, out + first, n);
+
+        done += n;
+        progress.fetch_add(n, std::memory_order_relaxed);
+    }
+    return done;
+}
@@ -0,0 +1,231 @@
+/*
+ * REFERENCE IMPLEMENTATION OF the sample pool generator
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * Precomputes 2^log2_records forward halves (key, IV, Z, Z', fwd_parity) for the configuration
+ * in init_config_and_banner() and writes them to a memory-mapped pool file (see
+ * header/samplepool.hpp). altaumstylepnb.cpp and pnbsetbias.cpp stream such a pool with
+ * `pool=<file>` instead of recomputing the forward half.
+ *
+ * Every record takes sizeof(pnbkernel::ForwardSample) = 180 bytes, so 2^28 records are ~45 GiB.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 samplepool.cpp -o samplepool && ./samplepool <pool_file> [log2_records] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp, samplepool.hpp
+ */
+
+#include "header/samplepool.hpp" // mapped pool of pnbkernel forward halves
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+salsa::IVConditions iv_conditions; // used when diff_config.chosen_iv_flag is set
+
+static atomic<u64> progress{0};
+
+struct PoolOptions
+{
+    string pool_file;
+    int log2_records = 24;
+};
+
+u64 fillrange(pnbkernel::ForwardSample *records, u64 count);
+
+static bool parse_cli(int argc, char *argv[], PoolOptions &opt)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <pool_file> [log2_records] [log]\n";
+        return false;
+    }
+    opt.pool_file = argv[1];
+
+    if (argc >= 3)
+    {
+        try
+        {
+            opt.log2_records = std::stoi(argv[2]);
+            if (opt.log2_records < 8 || opt.log2_records > 36)
+            {
+                std::cerr << "log2_records must be in [8,36]. Using default 24.\n";
+                opt.log2_records = 24;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_records input. Using default 24.\n";
+            opt.log2_records = 24;
+        }
+    }
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        if (flag == "log" || flag == "1")
+            basic_config.logfile_flag = true;
+    }
+    return true;
+}
+
+static void init_config_and_banner(const PoolOptions &opt, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "SamplePool"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.comment = "last round modified";
+    basic_config.total_rounds = 7.5;
+
+    diff_config.distinguishing_round = 5;
+    diff_config.id = {{7, 31}};
+    diff_config.mask = {{4, 7}};
+
+    // chosen IV: conditions on the state after the first half-round (see salsa::IVConditions)
+    // diff_config.chosen_iv_flag = true;
+    // iv_conditions.fix(9, 31, 0);      // x9'[31] = 0
+    // iv_conditions.equal(13, 0, 4, 7); // x13'[0] = x4'[7]
+
+    samples_config.samples_per_batch = 1ULL << opt.log2_records;
+    samples_config.samples_per_thread =
+        (samples_config.samples_per_batch + samples_config.max_num_threads - 1) / samples_config.max_num_threads;
+
+    const u64 bytes = samplepool::HEADER_BYTES + samples_config.samples_per_batch * sizeof(pnbkernel::ForwardSample);
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    if (diff_config.chosen_iv_flag)
+        display::printField(dmsg, "IV conditions", iv_conditions.fingerprint());
+    display::printField(dmsg, "Pool file", opt.pool_file);
+    display::printField(dmsg, "Record size (bytes)", sizeof(pnbkernel::ForwardSample));
+    {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(2) << static_cast<double>(bytes) / (1ULL << 30) << " GiB";
+        display::printField(dmsg, "Pool size", s.str());
+    }
+    dmsg << basic_config.star_sep;
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    PoolOptions opt;
+    if (!parse_cli(argc, argv, opt))
+        return 1;
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "samplepool";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    init_config_and_banner(opt, dmsg);
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config, &iv_conditions);
+    const u64 count = samples_config.samples_per_batch;
+
+    try
+    {
+        samplepool::PoolWriter writer(opt.pool_file, plan, count);
+
+        progress.store(0, std::memory_order_relaxed);
+
+        #ifdef SPINNER_WITH_ETA_AVAILABLE
+        SpinnerWithETA spinner("Generating sample pool ...", &progress, count);
+        spinner.start();
+        #endif
+
+        // ---------------- disjoint record ranges per thread -----------------
+        vector<std::future<u64>> future_results;
+        const u64 spt = samples_config.samples_per_thread;
+        for (u64 first{0}; first < count; first += spt)
+            future_results.emplace_back(async(launch::async, fillrange, writer.records() + first, std::min(spt, count - first)));
+
+        u64 written = 0;
+        for (auto &f : future_results)
+            written += f.get();
+
+        #ifdef SPINNER_WITH_ETA_AVAILABLE
+        spinner.stop();
+        #endif
+
+        writer.finish();
+
+        stringstream report;
+        report << basic_config.dash_sep;
+        display::printField(report, "Records written", display::formatCountPow2Pow10(written));
+        display::printField(report, "Pool saved to", opt.pool_file);
+        report << basic_config.dash_sep;
+        cout << "\n" << report.str();
+        dmsg << report.str();
+    }
+    catch (const exception &e)
+    {
+        cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = pnbinfo::makeLogFilename(basic_config, diff_config, nullptr, folder);
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return 0;
+}
+
+// ---------------- worker: forward halves of `count` fresh samples -----------------
+u64 fillrange(pnbkernel::ForwardSample *records, u64 count)
+{
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config, &iv_conditions);
+
+    for (u64 i{0}; i < count; ++i)
+    {
+        pnbkernel::generateSample(plan, records[i]);
+        if ((i & 0xfff) == 0xfff)
+            progress.fetch_add(0x1000, std::memory_order_relaxed);
+    }
+    progress.fetch_add(count & 0xfff, std::memory_order_relaxed);
+
+    return count;
+}
@@ -0,0 +1,597 @@
+/*
+ * REFERENCE IMPLEMENTATION OF an end-to-end throughput and scaling benchmark
+ *
+ *
+ * created: 18/10/26
+ * updated: 18/10/26
+ *
+ * by Hiren
+ * Researcher
+ *
+ * Synopsis:
+ * Runs a short single-bit PNB search (the matchcount loop of altaumstylepnb.cpp: fresh
+ * sample, flip one key bit, backward parity) for every configuration of total rounds x key
+ * size, on 1, 2, 4, ... up to `threads` worker threads, and records the throughput.
+ *
+ * Strong scaling keeps the work fixed (2^log2_samples samples per key bit); speedup is
+ * T(1) / T(n) and efficiency speedup / n. Weak scaling gives every thread that much work
+ * (n x 2^log2_samples per bit); efficiency is rate(n) / (n x rate(1)). Each point is the best
+ * of `reps` runs.
+ *
+ * The work is cut into CHUNK-sample chunks, each with its own RNG seed derived from
+ * (seed, configuration, key bit, chunk), and the threads take chunks from a shared counter.
+ * The per-bit match counts, and so the checksum over them, therefore depend only on the seed
+ * and the configuration, not on the thread count or the scheduling: equal checksums across
+ * thread counts and against the baseline show that the kernel still computes the same
+ * thing.
+ *
+ * save=<file> writes the results as a baseline (checkpoint::Record); baseline=<file>
+ * compares against one recorded with the same settings and exits with status 2 when a
+ * throughput fell by more than tol percent or a checksum differs. throughput/ gets the
+ * scaling curves as CSV.
+ *
+ * CLI:
+ *   g++ -std=c++20 -O3 -march=native throughputbench.cpp -o throughput
+ *   ./throughput [log2_samples] [threads=<n>] [reps=<n>] [seed=<n>] [rounds=7,7.5,8] [keys=128,256]
+ *                [baseline=<file>] [save=<file>] [tol=<percent>] [log]
+ *
+ * Needs: commonutility.hpp, salsa.hpp, pnbutility.hpp, pnbkernel.hpp
+ */
+
+#include "header/pnbkernel.hpp" // salsa round functions + forward/backward sample kernel
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <thread>
+
+using namespace std;
+
+config::CipherInfo basic_config;
+config::DLInfo diff_config;
+config::SamplesInfo samples_config;
+
+constexpr u64 CHUNK = 1ULL << 12;  // samples per seeded chunk
+constexpr u16 BIT_STRIDE = 8;      // every 8th key bit is searched
+constexpr int EXIT_REGRESSION = 2; // exit status on a regression against the baseline
+
+struct BenchOptions
+{
+    int log2_samples = 13;
+    u16 max_threads = 0; // 0: samples_config.max_num_threads
+    int reps = 3;
+    u64 seed = 0x5a15a20;
+    vector<double> rounds{7, 7.5, 8};
+    vector<int> key_sizes{128, 256};
+    string baseline_file;
+    string save_file;
+    double tolerance = 10.0; // percent
+};
+
+// one (rounds, key size) pair
+struct BenchConfig
+{
+    string name; // e.g. R7.5_k256
+    double rounds = 0;
+    int key_size = 0;
+    vector<u16> bits;
+};
+
+struct RunPoint
+{
+    string config;
+    string mode; // strong / weak
+    u16 threads = 0;
+    u64 samples = 0;
+    double seconds = 0;
+    double rate = 0; // samples per second
+    double speedup = 0;
+    double efficiency = 0;
+    u64 checksum = 0;
+};
+
+static std::atomic<u64> next_chunk{0};
+
+vector<u64> searchchunks(const pnbkernel::RoundPlan *plan, const vector<u16> *bits, u64 chunks_per_bit,
+                         u64 config_seed);
+
+static vector<double> parse_round_list(const string &list)
+{
+    vector<double> rounds;
+    std::stringstream ss(list);
+    string item;
+    while (std::getline(ss, item, ','))
+    {
+        try
+        {
+            const double r = std::stod(item);
+            if (r <= 0.0 || !config::is_valid_round(r, config::RoundGranularity::Half))
+            {
+                std::cerr << "round " << item << " is not a positive multiple of 0.5, ignored.\n";
+                continue;
+            }
+            rounds.push_back(r);
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid round " << item << ", ignored.\n";
+        }
+    }
+    return rounds;
+}
+
+static vector<int> parse_key_list(const string &list)
+{
+    vector<int> keys;
+    std::stringstream ss(list);
+    string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (item == "128" || item == "256")
+            keys.push_back(std::stoi(item));
+        else
+            std::cerr << "key size " << item << " is not 128 or 256, ignored.\n";
+    }
+    return keys;
+}
+
+static void parse_cli(int argc, char *argv[], BenchOptions &opt)
+{
+    int first_flag = 1;
+    if (argc >= 2 && std::isdigit(static_cast<unsigned char>(argv[1][0])))
+    {
+        first_flag = 2;
+        try
+        {
+            opt.log2_samples = std::stoi(argv[1]);
+            if (opt.log2_samples < 12 || opt.log2_samples > 30)
+            {
+                std::cerr << "log2_samples must be in [12,30]. Using default 13.\n";
+                opt.log2_samples = 13;
+            }
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid log2_samples input. Using default 13.\n";
+            opt.log2_samples = 13;
+        }
+    }
+
+    for (int i = first_flag; i < argc; ++i)
+    {
+        const std::string raw = argv[i];
+        std::string flag = raw;
+        std::transform(flag.begin(), flag.end(), flag.begin(),
+                       [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+
+        try
+        {
+            if (flag == "log" || flag == "1")
+                basic_config.logfile_flag = true;
+            else if (flag.rfind("threads=", 0) == 0)
+                opt.max_threads = static_cast<u16>(std::max(1, std::stoi(flag.substr(8))));
+            else if (flag.rfind("reps=", 0) == 0)
+                opt.reps = std::max(1, std::stoi(flag.substr(5)));
+            else if (flag.rfind("seed=", 0) == 0)
+                opt.seed = std::stoull(flag.substr(5), nullptr, 0);
+            else if (flag.rfind("rounds=", 0) == 0)
+                opt.rounds = parse_round_list(flag.substr(7));
+            else if (flag.rfind("keys=", 0) == 0)
+                opt.key_sizes = parse_key_list(flag.substr(5));
+            else if (flag.rfind("baseline=", 0) == 0)
+                opt.baseline_file = raw.substr(9);
+            else if (flag.rfind("save=", 0) == 0)
+                opt.save_file = raw.substr(5);
+            else if (flag.rfind("tol=", 0) == 0)
+                opt.tolerance = std::max(0.0, std::stod(flag.substr(4)));
+            else
+                std::cerr << "Ignoring unknown argument: " << raw << "\n";
+        }
+        catch (...)
+        {
+            std::cerr << "Invalid value in " << raw << ". Using the default.\n";
+        }
+    }
+}
+
+static vector<u16> thread_counts(u16 max_threads)
+{
+    vector<u16> counts;
+    for (u16 n{1}; n < max_threads; n *= 2)
+        counts.push_back(n);
+    counts.push_back(max_threads);
+    return counts;
+}
+
+static vector<BenchConfig> init_config_and_banner(BenchOptions &opt, std::stringstream &dmsg)
+{
+    basic_config.cipher_name = "salsa";
+    basic_config.mode = "Throughput"; // input something useful without gap
+    basic_config.word_size_bits = 32;
+    basic_config.key_size = 256;
+    basic_config.comment = "last round modified";
+    basic_config.total_rounds = 7.5;
+
+    diff_config.distinguishing_round = 5;
+    diff_config.id = {{7, 31}};
+    diff_config.mask = {{4, 7}};
+
+    if (opt.max_threads == 0)
+        opt.max_threads = static_cast<u16>(samples_config.max_num_threads);
+
+    vector<BenchConfig> configs;
+    for (double r : opt.rounds)
+    {
+        if (r < diff_config.distinguishing_round)
+        {
+            std::cerr << "rounds " << r << " is below the distinguishing round, ignored.\n";
+            continue;
+        }
+        for (int k : opt.key_sizes)
+        {
+            BenchConfig c;
+            std::ostringstream name;
+            name << "R" << r << "_k" << k;
+            c.name = name.str();
+            c.rounds = r;
+            c.key_size = k;
+            const u16 key_bits = static_cast<u16>((k == 128 ? KEYWORD_COUNT / 2 : KEYWORD_COUNT) * WORD_SIZE);
+            for (u16 b{0}; b < key_bits; b += BIT_STRIDE)
+                c.bits.push_back(b);
+            configs.push_back(c);
+        }
+    }
+    if (configs.empty())
+        throw std::invalid_argument("no configuration left to run");
+
+    samples_config.samples_per_thread = 1ULL << opt.log2_samples;
+    samples_config.samples_per_batch = 1ULL << opt.log2_samples;
+    samples_config.max_num_threads = opt.max_threads;
+
+    display::showInfo(&basic_config, &diff_config, &samples_config, dmsg);
+    {
+        string list;
+        for (const BenchConfig &c : configs)
+            list += (list.empty() ? "" : ", ") + c.name;
+        display::printField(dmsg, "Configurations", list);
+    }
+    {
+        string list;
+        for (u16 n : thread_counts(opt.max_threads))
+            list += (list.empty() ? "" : ", ") + std::to_string(n);
+        display::printField(dmsg, "Thread counts", list);
+    }
+    display::printField(dmsg, "Key bits per configuration", "every " + std::to_string(BIT_STRIDE) + "th");
+    display::printField(dmsg, "Samples per key bit (strong)", display::formatCountPow2Pow10(1ULL << opt.log2_samples));
+    display::printField(dmsg, "Repetitions (best kept)", opt.reps);
+    display::printField(dmsg, "Seed", opt.seed);
+    if (!opt.baseline_file.empty())
+        display::printField(dmsg, "Baseline", opt.baseline_file + " (tolerance " + std::to_string(opt.tolerance) + " %)");
+    dmsg << basic_config.star_sep;
+
+    return configs;
+}
+
+// everything that changes the work or the checksums; a baseline is only compared on a match
+static string bench_fingerprint(const BenchOptions &opt, const vector<BenchConfig> &configs)
+{
+    std::ostringstream fp;
+    fp << "kernel" << pnbkernel::KERNEL_VERSION << " " << basic_config.cipher_name << " D"
+       << diff_config.distinguishing_round << " " << basic_config.comment << " id";
+    for (const auto &[w, b] : diff_config.id)
+        fp << ":" << w << "," << b;
+    fp << " mask";
+    for (const auto &[w, b] : diff_config.mask)
+        fp << ":" << w << "," << b;
+    fp << " samples2^" << opt.log2_samples << " chunk" << CHUNK << " stride" << BIT_STRIDE << " seed" << opt.seed
+       << " configs";
+    for (const BenchConfig &c : configs)
+        fp << ":" << c.name;
+    return fp.str();
+}
+
+// one timed search of `samples_per_bit` samples for every bit of `c` on `threads` threads
+static RunPoint run_once(const BenchConfig &c, u64 config_seed, u64 samples_per_bit, u16 threads)
+{
+    basic_config.total_rounds = c.rounds;
+    basic_config.key_size = c.key_size;
+    const pnbkernel::RoundPlan plan = pnbkernel::makeRoundPlan(basic_config, diff_config);
+    const u64 chunks_per_bit = samples_per_bit / CHUNK;
+
+    next_chunk.store(0, std::memory_order_relaxed);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    vector<std::future<vector<u64>>> futures;
+    futures.reserve(threads);
+    for (u16 t{0}; t < threads; ++t)
+        futures.emplace_back(async(launch::async, searchchunks, &plan, &c.bits, chunks_per_bit, config_seed));
+
+    vector<u64> matches(c.bits.size(), 0);
+    for (auto &f : futures)
+    {
+        const vector<u64> m = f.get();
+        for (size_t i{0}; i < m.size(); ++i)
+            matches[i] += m[i];
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    RunPoint p;
+    p.config = c.name;
+    p.threads = threads;
+    p.samples = samples_per_bit * c.bits.size();
+    p.seconds = seconds;
+    p.rate = p.samples / seconds;
+    p.checksum = checkpoint::fnv1a64(string(reinterpret_cast<const char *>(matches.data()), matches.size() * sizeof(u64)));
+    return p;
+}
+
+static RunPoint run_best(const BenchConfig &c, u64 config_seed, u64 samples_per_bit, u16 threads, int reps,
+                         std::ostream &err)
+{
+    RunPoint best;
+    for (int r{0}; r < reps; ++r)
+    {
+        const RunPoint p = run_once(c, config_seed, samples_per_bit, threads);
+        if (r > 0 && p.checksum != best.checksum)
+            err << "WARNING: " << c.name << " on " << threads << " threads gave a different checksum in repetition "
+                << r << "\n";
+        if (r == 0 || p.rate > best.rate)
+            best = p;
+    }
+    return best;
+}
+
+static string point_key(const RunPoint &p, const char *what)
+{
+    return p.config + "_" + p.mode + "_t" + std::to_string(p.threads) + "_" + what;
+}
+
+static void write_csv(const string &folder, const vector<RunPoint> &points)
+{
+    std::filesystem::create_directories(folder);
+    std::time_t t = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    std::ostringstream name;
+    name << folder << "/scaling_" << std::put_time(&tm, "%Y%m%d_%H%M%S") << ".csv";
+
+    std::ofstream f(name.str());
+    if (!f)
+    {
+        std::cerr << "ERROR: Could not write " << name.str() << "\n";
+        return;
+    }
+    f << "config,mode,threads,samples,seconds,samples_per_s,speedup,efficiency,checksum\n";
+    for (const RunPoint &p : points)
+        f << p.config << "," << p.mode << "," << p.threads << "," << p.samples << "," << p.seconds << ","
+          << p.rate << "," << p.speedup << "," << p.efficiency << "," << std::hex << p.checksum << std::dec << "\n";
+    std::cout << "Scaling curves written to: " << name.str() << "\n";
+}
+
+// ---------------- main function -----------------
+int main(int argc, char *argv[])
+{
+    BenchOptions opt;
+    parse_cli(argc, argv, opt);
+
+    Timer timer;
+
+    stringstream dmsg; //  log buffer
+    string folder = "throughput";
+
+    dmsg << timer.start_message();
+
+    // ---------------- config -----------------
+    vector<BenchConfig> configs;
+    checkpoint::Record baseline;
+    try
+    {
+        configs = init_config_and_banner(opt, dmsg);
+        if (!opt.baseline_file.empty())
+        {
+            if (!checkpoint::load(opt.baseline_file, baseline))
+                throw std::runtime_error("could not read baseline " + opt.baseline_file);
+            if (baseline.fingerprint != bench_fingerprint(opt, configs))
+                throw std::runtime_error("baseline " + opt.baseline_file + " was recorded with other settings:\n  " +
+                                         baseline.fingerprint);
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+
+    cout << dmsg.str() << std::flush;
+    // ---------------- config end -----------------
+
+    const vector<u16> counts = thread_counts(opt.max_threads);
+    const u64 base_samples = 1ULL << opt.log2_samples;
+    vector<RunPoint> points;
+
+    stringstream report;
+    for (size_t ci{0}; ci < configs.size(); ++ci)
+    {
+        const BenchConfig &c = configs[ci];
+        const u64 config_seed = checkpoint::fnv1a64(c.name, opt.seed);
+
+        stringstream table;
+        table << basic_config.dash_sep << c.name << " (" << c.bits.size() << " key bits)\n";
+        table << std::left << std::setw(8) << "mode" << std::right << std::setw(8) << "threads" << std::setw(14)
+              << "samples" << std::setw(10) << "seconds" << std::setw(14) << "samples/s" << std::setw(9) << "speedup"
+              << std::setw(11) << "efficiency" << std::setw(18) << "checksum" << "\n";
+        cout << table.str() << std::flush;
+        report << table.str();
+
+        for (const bool strong : {true, false})
+        {
+            double rate1 = 0; // samples/s on one thread
+            for (u16 n : counts)
+            {
+                RunPoint p = run_best(c, config_seed, strong ? base_samples : base_samples * n, n, opt.reps, cerr);
+                p.mode = strong ? "strong" : "weak";
+                if (n == 1)
+                    rate1 = p.rate;
+                // strong: T(1) / T(n) for the same work; weak: rate(n) / rate(1)
+                p.speedup = p.rate / rate1;
+                p.efficiency = p.speedup / n;
+                points.push_back(p);
+
+                std::ostringstream line;
+                line << std::left << std::setw(8) << p.mode << std::right << std::setw(8) << p.threads << std::setw(14)
+                     << p.samples << std::fixed << std::setprecision(3) << std::setw(10) << p.seconds
+                     << std::scientific << std::setprecision(3) << std::setw(14) << p.rate << std::fixed
+                     << std::setprecision(2) << std::setw(9) << p.speedup << std::setw(11) << p.efficiency
+                     << std::setw(18) << std::hex << p.checksum << std::dec << "\n";
+                cout << line.str() << std::flush;
+                report << line.str();
+            }
+        }
+    }
+    cout << basic_config.dash_sep;
+    report << basic_config.dash_sep;
+
+    stringstream verdict;
+
+    // ---------------- checksums must not depend on the thread count (strong scaling) -----------------
+    int status = 0;
+    for (const RunPoint &p : points)
+        for (const RunPoint &q : points)
+            if (p.config == q.config && p.mode == "strong" && q.mode == "strong" && p.checksum != q.checksum &&
+                p.threads < q.threads)
+            {
+                verdict << "ERROR: " << p.config << " checksum differs between " << p.threads << " and " << q.threads
+                       << " threads\n";
+                status = 1;
+            }
+
+    // ---------------- baseline comparison -----------------
+    if (!opt.baseline_file.empty())
+    {
+        u64 compared = 0, regressions = 0;
+        for (const RunPoint &p : points)
+        {
+            const u64 base_rate = baseline.get(point_key(p, "rate"));
+            if (base_rate == 0)
+                continue;
+            ++compared;
+            const double change = 100.0 * (p.rate / static_cast<double>(base_rate) - 1.0);
+            const u64 base_sum = baseline.get(point_key(p, "checksum"));
+            if (change < -opt.tolerance)
+            {
+                std::ostringstream s;
+                s << "REGRESSION: " << p.config << " " << p.mode << " " << p.threads << " threads: " << std::fixed
+                  << std::setprecision(1) << change << " % (" << std::scientific << std::setprecision(3) << p.rate
+                  << " vs " << static_cast<double>(base_rate) << " samples/s)\n";
+                verdict << s.str();
+                ++regressions;
+            }
+            if (base_sum != p.checksum)
+            {
+                verdict << "CHECKSUM MISMATCH: " << p.config << " " << p.mode << " " << p.threads << " threads: "
+                       << std::hex << p.checksum << " vs baseline " << base_sum << std::dec << "\n";
+                ++regressions;
+            }
+        }
+        verdict << "Baseline: " << compared << " points compared, " << regressions << " failed\n";
+        if (compared == 0)
+            verdict << "WARNING: the baseline has none of these points (other thread counts?)\n";
+        if (regressions && status == 0)
+            status = EXIT_REGRESSION;
+    }
+
+    cout << verdict.str();
+    dmsg << report.str() << verdict.str();
+
+    write_csv(folder, points);
+
+    if (!opt.save_file.empty())
+    {
+        checkpoint::Record rec;
+        rec.fingerprint = bench_fingerprint(opt, configs);
+        for (const RunPoint &p : points)
+        {
+            rec.set(point_key(p, "rate"), static_cast<u64>(std::llround(p.rate)));
+            rec.set(point_key(p, "checksum"), p.checksum);
+        }
+        if (checkpoint::save(opt.save_file, rec))
+            cout << "Baseline saved to: " << opt.save_file << "\n";
+        else
+        {
+            cerr << "ERROR: Could not write baseline: " << opt.save_file << "\n";
+            status = status ? status : 1;
+        }
+    }
+
+    basic_config.total_rounds = 7.5;
+    basic_config.key_size = 256;
+    if (basic_config.logfile_flag)
+    {
+        dmsg << timer.end_message();
+
+        std::string filename = pnbinfo::makeLogFilename(basic_config, diff_config, nullptr, folder);
+        std::ofstream fout(filename);
+        if (fout.is_open())
+        {
+            fout << dmsg.str();
+            fout.close();
+            std::cout << "Log saved to: " << filename << "\n";
+        }
+        else
+        {
+            std::cerr << "ERROR: Could not write log file: " << filename << "\n";
+        }
+    }
+
+    cout << timer.end_message();
+    return status;
+}
+
+// ---------------- worker: matchcount over shared seeded chunks -----------------
+// returns the match count per entry of `bits`
+vector<u64> searchchunks(const pnbkernel::RoundPlan *plan, const vector<u16> *bits, u64 chunks_per_bit,
+                        u64 config_seed)
+{
+    vector<u64> matches(bits->size(), 0);
+    const u64 total_chunks = chunks_per_bit * bits->size();
+
+    pnbkernel::ForwardSample sample;
+    u32 key[KEYWORD_COUNT];
+
+    for (;;)
+    {
+        const u64 chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= total_chunks)
+            break;
+
+        const size_t b = chunk / chunks_per_bit;
+        const u16 global_idx = (*bits)[b];
+
+        // the chunk's seed only depends on what it computes, not on the thread that takes it
+        std::ostringstream id;
+        id << global_idx << ":" << chunk % chunks_per_bit;
+        thread_rng().seed(static_cast<std::mt19937::result_type>(checkpoint::fnv1a64(id.str(), config_seed)));
+
+        u64 hits = 0;
+        for (u64 loop{0}; loop < CHUNK; ++loop)
+        {
+            pnbkernel::generateSample(*plan, sample);
+
+            ops::copyState(key, sample.key, 0, KEYWORD_COUNT);
+            pnbkernel::toggleKeyBit(key, global_idx, plan->key_128);
+
+            if (sample.fwd_parity == pnbkernel::backwardParity(*plan, sample, key))
+                hits++;
+        }
+        matches[b] += hits;
+    }
+
+    return matches;
+}